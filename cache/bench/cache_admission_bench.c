@@ -0,0 +1,172 @@
+/*
+ * cache_admission_bench.c
+ *
+ * Trace-driven hit ratio benchmark of bounded cache with and without
+ * admission filter.
+ *
+ * Usage: cache_admission_bench [capacity] [trace file]
+ * Trace file holds one non negative integer key per line. Without it a
+ * synthetic trace is used: Zipf distributed popular keys mixed with scans of
+ * keys which are never seen again.
+ */
+
+#include "../cache.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_DEFAULT_CAPACITY (1000)
+#define BENCH_SYNTHETIC_ACCESSES (1000000)
+#define BENCH_SYNTHETIC_KEYS (100000)
+#define BENCH_ZIPF_EXPONENT (0.9)
+/** Every this number of accesses a scan of one-time keys starts */
+#define BENCH_SCAN_PERIOD (1000)
+#define BENCH_SCAN_LENGTH (200)
+
+static CacheElement copyKey(CacheElement element) {
+	long *copy = malloc(sizeof(*copy));
+	if (copy != NULL) {
+		*copy = *(long*)element;
+	}
+	return copy;
+}
+
+static void freeKey(CacheElement element) {
+	free(element);
+}
+
+static int compareKeys(CacheElement element1, CacheElement element2) {
+	long key1 = *(long*)element1;
+	long key2 = *(long*)element2;
+	return (key1 > key2) - (key1 < key2);
+}
+
+static uint64_t hashKey(CacheElement element) {
+	return (uint64_t)*(long*)element;
+}
+
+/** deterministic pseudo random numbers (xorshift64) */
+static uint64_t benchRandom(uint64_t *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+/** generates synthetic trace, returns number of accesses or -1 */
+static long benchGenerateTrace(long **trace) {
+	double *cdf = malloc(BENCH_SYNTHETIC_KEYS * sizeof(*cdf));
+	*trace = malloc(BENCH_SYNTHETIC_ACCESSES * sizeof(**trace));
+	if (cdf == NULL || *trace == NULL) {
+		free(cdf);
+		free(*trace);
+		return -1;
+	}
+	double sum = 0;
+	for (int i = 0; i < BENCH_SYNTHETIC_KEYS; ++i) {
+		sum += 1.0 / pow(i + 1, BENCH_ZIPF_EXPONENT);
+		cdf[i] = sum;
+	}
+	uint64_t state = 0x9e3779b97f4a7c15ULL;
+	long oneTimeKey = BENCH_SYNTHETIC_KEYS;
+	for (long i = 0; i < BENCH_SYNTHETIC_ACCESSES; ++i) {
+		if (i % BENCH_SCAN_PERIOD < BENCH_SCAN_LENGTH) {
+			(*trace)[i] = oneTimeKey++;
+			continue;
+		}
+		double point = (double)(benchRandom(&state) >> 11) / (double)(1ULL << 53) * sum;
+		int low = 0, high = BENCH_SYNTHETIC_KEYS - 1;
+		while (low < high) {
+			int middle = (low + high) / 2;
+			if (cdf[middle] < point) {
+				low = middle + 1;
+			} else {
+				high = middle;
+			}
+		}
+		(*trace)[i] = low;
+	}
+	free(cdf);
+	return BENCH_SYNTHETIC_ACCESSES;
+}
+
+/** reads trace file, returns number of accesses or -1 */
+static long benchReadTrace(const char *path, long **trace) {
+	FILE *file = fopen(path, "r");
+	if (file == NULL) {
+		return -1;
+	}
+	long capacity = 1024, size = 0, key;
+	*trace = malloc(capacity * sizeof(**trace));
+	while (*trace != NULL && fscanf(file, "%ld", &key) == 1) {
+		if (size == capacity) {
+			capacity *= 2;
+			long *grown = realloc(*trace, capacity * sizeof(**trace));
+			if (grown == NULL) {
+				free(*trace);
+				*trace = NULL;
+				break;
+			}
+			*trace = grown;
+		}
+		(*trace)[size++] = key;
+	}
+	fclose(file);
+	return *trace == NULL ? -1 : size;
+}
+
+/**
+ * replays trace on a cache of given capacity: every access is a lookup and
+ * a push on miss
+ * @return hit ratio, negative on error
+ */
+static double benchReplay(const long *trace, long accesses, int capacity,
+		bool admission) {
+	Cache cache = cacheCreateResizable(capacity, freeKey, copyKey, compareKeys, hashKey);
+	if (cache == NULL || cacheSetCapacity(cache, capacity) != CACHE_SUCCESS ||
+			(admission && cacheEnableAdmissionFilter(cache, hashKey) != CACHE_SUCCESS)) {
+		cacheDestroy(cache);
+		return -1;
+	}
+	long hits = 0;
+	for (long i = 0; i < accesses; ++i) {
+		long key = trace[i];
+		if (cacheIsIn(cache, &key)) {
+			++hits;
+			continue;
+		}
+		CacheResult result = cachePush(cache, &key);
+		if (result != CACHE_SUCCESS && result != CACHE_ITEM_REJECTED) {
+			cacheDestroy(cache);
+			return -1;
+		}
+	}
+	cacheDestroy(cache);
+	return accesses > 0 ? (double)hits / accesses : 0;
+}
+
+int main(int argc, char *argv[]) {
+	int capacity = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_CAPACITY;
+	if (capacity <= 0) {
+		fprintf(stderr, "capacity must be positive\n");
+		return 1;
+	}
+	long *trace = NULL;
+	long accesses = argc > 2 ? benchReadTrace(argv[2], &trace) : benchGenerateTrace(&trace);
+	if (accesses < 0) {
+		fprintf(stderr, "cannot load trace\n");
+		return 1;
+	}
+	double plain = benchReplay(trace, accesses, capacity, false);
+	double tinyLfu = benchReplay(trace, accesses, capacity, true);
+	free(trace);
+	if (plain < 0 || tinyLfu < 0) {
+		fprintf(stderr, "replay failed\n");
+		return 1;
+	}
+	printf("accesses: %ld, capacity: %d\n", accesses, capacity);
+	printf("bounded cache hit ratio: %.4f\n", plain);
+	printf("with admission filter hit ratio: %.4f\n", tinyLfu);
+	return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * cache_concurrent_bench.c
+ *
+ * Read scaling benchmark of concurrent cache, compared with ordinary cache
+ * guarded by a reader-writer lock. Reader threads look up keys while one
+ * writer replaces elements, one write per BENCH_READS_PER_WRITE lookups.
+ *
+ * Usage: cache_concurrent_bench [max threads] [lookups per thread]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../cache.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_DEFAULT_THREADS (8)
+#define BENCH_DEFAULT_LOOKUPS (2000000)
+#define BENCH_CELLS (1024)
+#define BENCH_KEYS (16384)
+#define BENCH_READS_PER_WRITE (1000)
+
+static CacheElement copyKey(CacheElement element) {
+	long *copy = malloc(sizeof(*copy));
+	if (copy != NULL) {
+		*copy = *(long*)element;
+	}
+	return copy;
+}
+
+static void freeKey(CacheElement element) {
+	free(element);
+}
+
+static int compareKeys(CacheElement element1, CacheElement element2) {
+	long key1 = *(long*)element1;
+	long key2 = *(long*)element2;
+	return (key1 > key2) - (key1 < key2);
+}
+
+static int cellOfKey(CacheElement element) {
+	return (int)(*(long*)element % BENCH_CELLS);
+}
+
+typedef struct BenchRun_t {
+	Cache cache;
+	/** NULL for concurrent cache */
+	pthread_rwlock_t *lock;
+	long lookups;
+	long hits;
+} BenchRun;
+
+static double benchNow(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void *benchReader(void *argument) {
+	BenchRun *run = argument;
+	uint64_t state = (uint64_t)(uintptr_t)argument | 1;
+	long hits = 0;
+	for (long i = 0; i < run->lookups; ++i) {
+		// xorshift64
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		long key = (long)(state % BENCH_KEYS);
+		if (run->lock != NULL) {
+			pthread_rwlock_rdlock(run->lock);
+		}
+		hits += cacheIsIn(run->cache, &key);
+		if (run->lock != NULL) {
+			pthread_rwlock_unlock(run->lock);
+		}
+	}
+	run->hits = hits;
+	return NULL;
+}
+
+/** replaces odd keys: frees one and pushes it back */
+static void *benchWriter(void *argument) {
+	BenchRun *run = argument;
+	for (long i = 0; i < run->lookups; ++i) {
+		long key = (2 * i + 1) % BENCH_KEYS;
+		if (run->lock != NULL) {
+			pthread_rwlock_wrlock(run->lock);
+		}
+		cacheFreeElement(run->cache, &key);
+		cachePush(run->cache, &key);
+		if (run->lock != NULL) {
+			pthread_rwlock_unlock(run->lock);
+		}
+	}
+	return NULL;
+}
+
+/**
+ * runs readers and the writer on a filled cache
+ * @return lookups per second, negative on error
+ */
+static double benchRun(bool concurrent, int threads, long lookups) {
+	Cache cache = concurrent ?
+			cacheCreateConcurrent(BENCH_CELLS, freeKey, copyKey, compareKeys, cellOfKey) :
+			cacheCreate(BENCH_CELLS, freeKey, copyKey, compareKeys, cellOfKey);
+	if (cache == NULL) {
+		return -1;
+	}
+	for (long key = 0; key < BENCH_KEYS; ++key) {
+		if (cachePush(cache, &key) != CACHE_SUCCESS) {
+			cacheDestroy(cache);
+			return -1;
+		}
+	}
+	pthread_rwlock_t lock;
+	if (!concurrent && pthread_rwlock_init(&lock, NULL) != 0) {
+		cacheDestroy(cache);
+		return -1;
+	}
+	BenchRun runs[threads + 1];
+	pthread_t ids[threads + 1];
+	for (int i = 0; i <= threads; ++i) {
+		runs[i].cache = cache;
+		runs[i].lock = concurrent ? NULL : &lock;
+		runs[i].lookups = i < threads ? lookups : lookups * threads / BENCH_READS_PER_WRITE;
+		runs[i].hits = 0;
+	}
+	double start = benchNow();
+	int started = 0;
+	for (; started <= threads; ++started) {
+		if (pthread_create(ids + started, NULL, started < threads ? benchReader : benchWriter,
+				runs + started) != 0) {
+			break;
+		}
+	}
+	for (int i = 0; i < started; ++i) {
+		pthread_join(ids[i], NULL);
+	}
+	double elapsed = benchNow() - start;
+	if (!concurrent) {
+		pthread_rwlock_destroy(&lock);
+	}
+	cacheDestroy(cache);
+	if (started <= threads) {
+		return -1;
+	}
+	return lookups * threads / elapsed;
+}
+
+int main(int argc, char *argv[]) {
+	int maxThreads = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_THREADS;
+	long lookups = argc > 2 ? atol(argv[2]) : BENCH_DEFAULT_LOOKUPS;
+	if (maxThreads <= 0 || lookups <= 0) {
+		fprintf(stderr, "threads and lookups must be positive\n");
+		return 1;
+	}
+	printf("%8s %20s %20s\n", "readers", "rwlock lookups/s", "concurrent lookups/s");
+	for (int threads = 1; threads <= maxThreads; threads *= 2) {
+		double locked = benchRun(false, threads, lookups);
+		double concurrent = benchRun(true, threads, lookups);
+		if (locked < 0 || concurrent < 0) {
+			fprintf(stderr, "run failed\n");
+			return 1;
+		}
+		printf("%8d %20.0f %20.0f\n", threads, locked, concurrent);
+	}
+	return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * cache_probes_bench.c
+ *
+ * Lookup throughput of a cache much larger than the processor caches, looking
+ * elements up one by one with cacheIsIn and in groups with cacheIsInProbes.
+ *
+ * Usage: cache_probes_bench [cells] [lookups] [group size]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_DEFAULT_CELLS (1 << 22)
+#define BENCH_DEFAULT_LOOKUPS (4000000)
+#define BENCH_DEFAULT_GROUP (8)
+#define BENCH_MAX_GROUP (64)
+
+static int benchCells;
+
+static CacheElement copyKey(CacheElement element) {
+	long *copy = malloc(sizeof(*copy));
+	if (copy != NULL) {
+		*copy = *(long*)element;
+	}
+	return copy;
+}
+
+static void freeKey(CacheElement element) {
+	free(element);
+}
+
+static int compareKeys(CacheElement element1, CacheElement element2) {
+	long key1 = *(long*)element1;
+	long key2 = *(long*)element2;
+	return (key1 > key2) - (key1 < key2);
+}
+
+static int cellOfKey(CacheElement element) {
+	return (int)(*(long*)element % benchCells);
+}
+
+static double benchNow(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/** xorshift64, keys are twice the elements so that half the lookups miss */
+static long benchNextKey(uint64_t *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return (long)(*state % (2 * (uint64_t)benchCells));
+}
+
+int main(int argc, char *argv[]) {
+	benchCells = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_CELLS;
+	long lookups = argc > 2 ? atol(argv[2]) : BENCH_DEFAULT_LOOKUPS;
+	int group = argc > 3 ? atoi(argv[3]) : BENCH_DEFAULT_GROUP;
+	if (benchCells <= 0 || lookups <= 0 || group <= 0 || group > BENCH_MAX_GROUP) {
+		fprintf(stderr, "cells and lookups must be positive, group at most %d\n",
+				BENCH_MAX_GROUP);
+		return 1;
+	}
+	Cache cache = cacheCreate(benchCells, freeKey, copyKey, compareKeys, cellOfKey);
+	if (cache == NULL) {
+		fprintf(stderr, "cache creation failed\n");
+		return 1;
+	}
+	// one element per cell, pushed in scattered order
+	uint64_t state = 88172645463325252ULL;
+	for (long i = 0; i < benchCells; ++i) {
+		long key = (long)(((uint64_t)i * 2654435761ULL) % (uint64_t)benchCells);
+		if (cachePush(cache, &key) != CACHE_SUCCESS) {
+			fprintf(stderr, "push failed\n");
+			cacheDestroy(cache);
+			return 1;
+		}
+	}
+
+	long hits = 0;
+	double start = benchNow();
+	for (long i = 0; i < lookups; ++i) {
+		long key = benchNextKey(&state);
+		hits += cacheIsIn(cache, &key);
+	}
+	double single = lookups / (benchNow() - start);
+
+	long keys[BENCH_MAX_GROUP];
+	CacheElement probes[BENCH_MAX_GROUP];
+	bool found[BENCH_MAX_GROUP];
+	for (int j = 0; j < group; ++j) {
+		probes[j] = keys + j;
+	}
+	long groupHits = 0;
+	start = benchNow();
+	for (long i = 0; i < lookups; i += group) {
+		for (int j = 0; j < group; ++j) {
+			keys[j] = benchNextKey(&state);
+		}
+		cacheIsInProbes(cache, probes, group, found);
+		for (int j = 0; j < group; ++j) {
+			groupHits += found[j];
+		}
+	}
+	double grouped = lookups / (benchNow() - start);
+
+	printf("%12s %20s %20s\n", "cells", "cacheIsIn lookups/s", "probes lookups/s");
+	printf("%12d %20.0f %20.0f\n", benchCells, single, grouped);
+	printf("hit ratio %.3f / %.3f\n", (double)hits / lookups, (double)groupHits / lookups);
+	cacheDestroy(cache);
+	return 0;
+}
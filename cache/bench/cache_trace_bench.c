@@ -0,0 +1,417 @@
+/*
+ * cache_trace_bench.c
+ *
+ * Replays a trace of cache operations and reports throughput, latency
+ * percentiles, memory and how unevenly cells are used.
+ *
+ * Usage: cache_trace_bench [-r] <trace file | uniform | zipf | scan> [cells]
+ *        [operations] [output file]
+ * A trace file holds one operation per line: an operation letter and a non
+ * negative integer key, "P 42" pushes 42, "I 42" checks whether 42 is in the
+ * cache, "F 42" frees it and "E 3" extracts an element of cell 3. A generator
+ * name instead of a file makes a synthetic trace of the given number of
+ * operations, which is also written to the output file if one is given, so
+ * that it can be replayed later.
+ *
+ * With -r the trace is replayed over a resizable cache, which starts with
+ * BENCH_RESIZABLE_INITIAL_CELLS cells and grows while it fills, so that
+ * latencies include migration of cells. Cells then only bound the keys of
+ * synthetic traces.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../cache.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_DEFAULT_CELLS (4096)
+#define BENCH_DEFAULT_OPERATIONS (2000000)
+/** Synthetic keys are drawn from this many times the number of cells */
+#define BENCH_KEYS_PER_CELL (8)
+#define BENCH_ZIPF_EXPONENT (0.99)
+/** Percentage of each operation in synthetic traces */
+#define BENCH_IS_IN_PERCENT (60)
+#define BENCH_PUSH_PERCENT (25)
+#define BENCH_FREE_PERCENT (10)
+/** Percentage of operations of scan trace which continue a sequential scan */
+#define BENCH_SCAN_PERCENT (50)
+/** Memory usage is sampled every this number of operations */
+#define BENCH_MEMORY_PERIOD (1024)
+/** Initial number of cells of resizable cache */
+#define BENCH_RESIZABLE_INITIAL_CELLS (16)
+
+typedef enum {
+	BENCH_PUSH,
+	BENCH_IS_IN,
+	BENCH_FREE,
+	BENCH_EXTRACT,
+	BENCH_OPERATION_TYPES
+} BenchOperationType;
+
+static const char benchOperationLetters[BENCH_OPERATION_TYPES] = { 'P', 'I', 'F', 'E' };
+static const char *benchOperationNames[BENCH_OPERATION_TYPES] = {
+		"push", "isIn", "free", "extract"
+};
+
+typedef struct BenchOperation_t {
+	BenchOperationType type;
+	long key;
+} BenchOperation;
+
+typedef struct BenchTrace_t {
+	BenchOperation *operations;
+	long size;
+	long capacity;
+} BenchTrace;
+
+static int benchCells;
+static bool benchResizable;
+
+static CacheElement copyKey(CacheElement element) {
+	long *copy = malloc(sizeof(*copy));
+	if (copy != NULL) {
+		*copy = *(long*)element;
+	}
+	return copy;
+}
+
+static void freeKey(CacheElement element) {
+	free(element);
+}
+
+static int compareKeys(CacheElement element1, CacheElement element2) {
+	long key1 = *(long*)element1;
+	long key2 = *(long*)element2;
+	return (key1 > key2) - (key1 < key2);
+}
+
+static int cellOfKey(CacheElement element) {
+	return (int)(*(long*)element % benchCells);
+}
+
+static uint64_t hashKey(CacheElement element) {
+	uint64_t hash = (uint64_t)*(long*)element;
+	hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+	return hash ^ (hash >> 31);
+}
+
+static long sizeKey(CacheElement element) {
+	(void)element;
+	return sizeof(long);
+}
+
+/** deterministic pseudo random numbers (xorshift64) */
+static uint64_t benchRandom(uint64_t *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static double benchNow(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/** appends operation to trace, returns false on allocation failure */
+static bool benchTraceAppend(BenchTrace *trace, BenchOperationType type, long key) {
+	if (trace->size == trace->capacity) {
+		long capacity = trace->capacity == 0 ? 1024 : trace->capacity * 2;
+		BenchOperation *grown = realloc(trace->operations, capacity * sizeof(*grown));
+		if (grown == NULL) {
+			return false;
+		}
+		trace->operations = grown;
+		trace->capacity = capacity;
+	}
+	trace->operations[trace->size].type = type;
+	trace->operations[trace->size].key = key;
+	++trace->size;
+	return true;
+}
+
+/** reads trace file, returns false on error */
+static bool benchReadTrace(const char *path, BenchTrace *trace) {
+	FILE *file = fopen(path, "r");
+	if (file == NULL) {
+		return false;
+	}
+	char letter;
+	long key;
+	bool success = true;
+	while (success && fscanf(file, " %c %ld", &letter, &key) == 2) {
+		const char *found = memchr(benchOperationLetters, letter, BENCH_OPERATION_TYPES);
+		success = found != NULL && key >= 0 &&
+				benchTraceAppend(trace, (BenchOperationType)(found - benchOperationLetters), key);
+	}
+	success = success && !ferror(file);
+	fclose(file);
+	return success;
+}
+
+/** writes trace file, returns false on error */
+static bool benchWriteTrace(const char *path, const BenchTrace *trace) {
+	FILE *file = fopen(path, "w");
+	if (file == NULL) {
+		return false;
+	}
+	for (long i = 0; i < trace->size; ++i) {
+		fprintf(file, "%c %ld\n", benchOperationLetters[trace->operations[i].type],
+				trace->operations[i].key);
+	}
+	return fclose(file) == 0;
+}
+
+/** draws key of given distribution, cdf is NULL for uniform one */
+static long benchDrawKey(uint64_t *state, const double *cdf, long keys) {
+	if (cdf == NULL) {
+		return (long)(benchRandom(state) % (uint64_t)keys);
+	}
+	double point = (double)(benchRandom(state) >> 11) / (double)(1ULL << 53) * cdf[keys - 1];
+	long low = 0, high = keys - 1;
+	while (low < high) {
+		long middle = (low + high) / 2;
+		if (cdf[middle] < point) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+/**
+ * generates synthetic trace: keys uniform, Zipf distributed or Zipf mixed with
+ * sequential scans over all keys
+ * @return false on allocation failure or unknown generator
+ */
+static bool benchGenerateTrace(const char *generator, long operations, BenchTrace *trace) {
+	bool zipf = strcmp(generator, "zipf") == 0;
+	bool scan = strcmp(generator, "scan") == 0;
+	if (!zipf && !scan && strcmp(generator, "uniform") != 0) {
+		return false;
+	}
+	long keys = (long)benchCells * BENCH_KEYS_PER_CELL;
+	double *cdf = NULL;
+	if (zipf || scan) {
+		cdf = malloc(keys * sizeof(*cdf));
+		if (cdf == NULL) {
+			return false;
+		}
+		double sum = 0;
+		for (long i = 0; i < keys; ++i) {
+			sum += 1.0 / pow(i + 1, BENCH_ZIPF_EXPONENT);
+			cdf[i] = sum;
+		}
+	}
+	uint64_t state = 0x9e3779b97f4a7c15ULL;
+	long scanKey = 0;
+	bool success = true;
+	for (long i = 0; success && i < operations; ++i) {
+		long key;
+		if (scan && (long)(benchRandom(&state) % 100) < BENCH_SCAN_PERCENT) {
+			key = scanKey;
+			scanKey = (scanKey + 1) % keys;
+		} else {
+			key = benchDrawKey(&state, cdf, keys);
+		}
+		long percent = (long)(benchRandom(&state) % 100);
+		BenchOperationType type = BENCH_EXTRACT;
+		if (percent < BENCH_IS_IN_PERCENT) {
+			type = BENCH_IS_IN;
+		} else if (percent < BENCH_IS_IN_PERCENT + BENCH_PUSH_PERCENT) {
+			type = BENCH_PUSH;
+		} else if (percent < BENCH_IS_IN_PERCENT + BENCH_PUSH_PERCENT + BENCH_FREE_PERCENT) {
+			type = BENCH_FREE;
+		}
+		success = benchTraceAppend(trace, type, type == BENCH_EXTRACT ? key % benchCells : key);
+	}
+	free(cdf);
+	return success;
+}
+
+/** performs one operation, returns whether it hit (found or changed anything) */
+static bool benchApply(Cache cache, const BenchOperation *operation) {
+	long key = operation->key;
+	switch (operation->type) {
+	case BENCH_PUSH:
+		return cachePush(cache, &key) == CACHE_SUCCESS;
+	case BENCH_IS_IN:
+		return cacheIsIn(cache, &key);
+	case BENCH_FREE:
+		return cacheFreeElement(cache, &key) == CACHE_SUCCESS;
+	default: {
+		CacheElement element = cacheExtractElementByKey(cache, (int)(key % cacheGetSize(cache)));
+		bool hit = element != NULL;
+		freeKey(element);
+		return hit;
+	}
+	}
+}
+
+static Cache benchCreateCache(void) {
+	Cache cache = benchResizable ?
+			cacheCreateResizable(BENCH_RESIZABLE_INITIAL_CELLS, freeKey, copyKey, compareKeys,
+					hashKey) :
+			cacheCreate(benchCells, freeKey, copyKey, compareKeys, cellOfKey);
+	if (cache != NULL && cacheSetElementSize(cache, sizeKey) != CACHE_SUCCESS) {
+		cacheDestroy(cache);
+		return NULL;
+	}
+	return cache;
+}
+
+/** replays trace untimed per operation, returns operations per second */
+static double benchThroughput(const BenchTrace *trace) {
+	Cache cache = benchCreateCache();
+	if (cache == NULL) {
+		return -1;
+	}
+	double start = benchNow();
+	for (long i = 0; i < trace->size; ++i) {
+		benchApply(cache, trace->operations + i);
+	}
+	double elapsed = benchNow() - start;
+	cacheDestroy(cache);
+	return elapsed > 0 ? trace->size / elapsed : 0;
+}
+
+static int benchCompareLatencies(const void *latency1, const void *latency2) {
+	double first = *(const double*)latency1, second = *(const double*)latency2;
+	return (first > second) - (first < second);
+}
+
+static void benchPrintPercentiles(const char *name, double *latencies, long count,
+		long hits) {
+	if (count == 0) {
+		return;
+	}
+	qsort(latencies, count, sizeof(*latencies), benchCompareLatencies);
+	static const double percentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+	printf("%-8s %10ld %7.1f%%", name, count, 100.0 * hits / count);
+	for (int i = 0; i < (int)(sizeof(percentiles) / sizeof(*percentiles)); ++i) {
+		printf(" %9.0f", latencies[(long)(percentiles[i] * (count - 1))]);
+	}
+	printf(" %9.0f\n", latencies[count - 1]);
+}
+
+/**
+ * replays trace timing every operation, prints latency percentiles of each
+ * operation type, memory and skew of cells
+ * @return false on error
+ */
+static bool benchLatencies(const BenchTrace *trace) {
+	Cache cache = benchCreateCache();
+	double *latencies[BENCH_OPERATION_TYPES] = { NULL };
+	long counts[BENCH_OPERATION_TYPES] = { 0 }, hits[BENCH_OPERATION_TYPES] = { 0 };
+	long *accesses = calloc(benchCells, sizeof(*accesses));
+	bool success = cache != NULL && accesses != NULL;
+	for (int type = 0; success && type < BENCH_OPERATION_TYPES; ++type) {
+		latencies[type] = malloc((trace->size + 1) * sizeof(**latencies));
+		success = latencies[type] != NULL;
+	}
+	long peakMemory = 0;
+	for (long i = 0; success && i < trace->size; ++i) {
+		const BenchOperation *operation = trace->operations + i;
+		double start = benchNow();
+		bool hit = benchApply(cache, operation);
+		double latency = (benchNow() - start) * 1e9;
+		latencies[operation->type][counts[operation->type]++] = latency;
+		hits[operation->type] += hit;
+		++accesses[operation->key % benchCells];
+		if (i % BENCH_MEMORY_PERIOD == 0 && cacheGetMemoryUsage(cache) > peakMemory) {
+			peakMemory = cacheGetMemoryUsage(cache);
+		}
+	}
+	if (success) {
+		printf("%-8s %10s %8s %9s %9s %9s %9s %9s\n", "op", "count", "hits",
+				"p50 ns", "p90 ns", "p99 ns", "p99.9 ns", "max ns");
+		for (int type = 0; type < BENCH_OPERATION_TYPES; ++type) {
+			benchPrintPercentiles(benchOperationNames[type], latencies[type],
+					counts[type], hits[type]);
+		}
+		long memory = cacheGetMemoryUsage(cache);
+		printf("memory: %ld bytes at end, %ld bytes at peak\n",
+				memory, memory > peakMemory ? memory : peakMemory);
+
+		// cells of resizable cache change during replay, so accesses of
+		// cells are only counted for fixed one
+		int cells = cacheGetSize(cache);
+		long totalBytes = 0, maxBytes = 0, maxAccesses = 0, emptyCells = 0;
+		for (int cell = 0; cell < cells; ++cell) {
+			long bytes = cacheGetCellMemoryUsage(cache, cell);
+			totalBytes += bytes;
+			maxBytes = bytes > maxBytes ? bytes : maxBytes;
+			emptyCells += bytes == 0;
+		}
+		for (int cell = 0; !benchResizable && cell < benchCells; ++cell) {
+			maxAccesses = accesses[cell] > maxAccesses ? accesses[cell] : maxAccesses;
+		}
+		double meanBytes = (double)totalBytes / cells;
+		printf("cells: %d, empty %ld, bytes max/mean %.2f", cells, emptyCells,
+				meanBytes > 0 ? maxBytes / meanBytes : 0);
+		if (!benchResizable) {
+			double meanAccesses = (double)trace->size / benchCells;
+			printf(", accesses max/mean %.2f",
+					meanAccesses > 0 ? maxAccesses / meanAccesses : 0);
+		}
+		printf("\n");
+	}
+	for (int type = 0; type < BENCH_OPERATION_TYPES; ++type) {
+		free(latencies[type]);
+	}
+	free(accesses);
+	cacheDestroy(cache);
+	return success;
+}
+
+int main(int argc, char *argv[]) {
+	benchResizable = argc > 1 && strcmp(argv[1], "-r") == 0;
+	if (benchResizable) {
+		--argc;
+		++argv;
+	}
+	if (argc < 2) {
+		fprintf(stderr, "usage: cache_trace_bench [-r] <trace file | uniform | zipf | scan> "
+				"[cells] [operations] [output file]\n");
+		return 1;
+	}
+	benchCells = argc > 2 ? atoi(argv[2]) : BENCH_DEFAULT_CELLS;
+	long operations = argc > 3 ? atol(argv[3]) : BENCH_DEFAULT_OPERATIONS;
+	if (benchCells <= 0 || operations <= 0) {
+		fprintf(stderr, "cells and operations must be positive\n");
+		return 1;
+	}
+	BenchTrace trace = { NULL, 0, 0 };
+	bool synthetic = strcmp(argv[1], "uniform") == 0 || strcmp(argv[1], "zipf") == 0 ||
+			strcmp(argv[1], "scan") == 0;
+	if (synthetic ? !benchGenerateTrace(argv[1], operations, &trace) :
+			!benchReadTrace(argv[1], &trace)) {
+		fprintf(stderr, "cannot load trace\n");
+		free(trace.operations);
+		return 1;
+	}
+	if (synthetic && argc > 4 && !benchWriteTrace(argv[4], &trace)) {
+		fprintf(stderr, "cannot write trace\n");
+		free(trace.operations);
+		return 1;
+	}
+	printf("trace: %s, operations: %ld, cells: %d%s\n", argv[1], trace.size, benchCells,
+			benchResizable ? ", resizable" : "");
+	double throughput = benchThroughput(&trace);
+	if (throughput < 0 || !benchLatencies(&trace)) {
+		fprintf(stderr, "replay failed\n");
+		free(trace.operations);
+		return 1;
+	}
+	printf("throughput: %.0f operations/s\n", throughput);
+	free(trace.operations);
+	return 0;
+}
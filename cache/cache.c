@@ -1,16 +1,286 @@
 #include "cache.h"
 
 #include <assert.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define CACHE_INVALID_ITERATOR_INDEX (-1)
+
+/** Average number of elements per cell which makes resizable cache grow */
+#define CACHE_RESIZE_GROW_LOAD (2)
+/** Resizable cache shrinks when it has this times more cells then elements */
+#define CACHE_RESIZE_SHRINK_RATIO (8)
+/** Number of non empty cells migrated on every operation */
+#define CACHE_RESIZE_STEP (2)
+/** Number of empty cells skipped on every operation */
+#define CACHE_RESIZE_EMPTY_STEP (16)
+
+/** Number of bloom filter counters per expected element */
+#define CACHE_BLOOM_COUNTERS_PER_ELEMENT (10)
+/** Number of counters each element sets in bloom filter */
+#define CACHE_BLOOM_HASHES (4)
+/** Value of bloom filter counter which is never decreased anymore */
+#define CACHE_BLOOM_COUNTER_MAX (UINT8_MAX)
+
+/** Number of rows (hash functions) of admission frequency sketch */
+#define CACHE_SKETCH_ROWS (4)
+/** Frequency sketch counters are 4-bit, as frequencies above it do not matter */
+#define CACHE_SKETCH_COUNTER_MAX (15)
+/** Sketch counters are halved after this times row width recorded accesses */
+#define CACHE_SKETCH_SAMPLE_RATIO (10)
+/** Minimal number of sketch counters per row, small caches collide less */
+#define CACHE_SKETCH_MIN_WIDTH (64)
+
+/** How many elements ahead batch operations prefetch cells */
+#define CACHE_BATCH_PREFETCH_DISTANCE (4)
+/** Number of lookups cacheIsInProbes keeps in flight */
+#define CACHE_PROBE_WINDOW (8)
+
+/** Number of cells a worker of parallel traversal takes at once */
+#define CACHE_PARALLEL_CHUNK (64)
+
+/** Snapshot file starts with magic and version, records follow */
+#define CACHE_SNAPSHOT_MAGIC "CSNP"
+#define CACHE_SNAPSHOT_MAGIC_SIZE (4)
+#define CACHE_SNAPSHOT_VERSION (1)
+/** Record length which marks the end of snapshot */
+#define CACHE_SNAPSHOT_END (0xffffffffUL)
+/** Initial size of element encoding buffer */
+#define CACHE_SNAPSHOT_BUFFER_SIZE (256)
+/** Number of decoded elements background restore keeps ready */
+#define CACHE_RESTORE_QUEUE_SIZE (1024)
+/** Number of restored elements added to cache on every operation */
+#define CACHE_RESTORE_STEP (16)
+
+/** Timer wheel has this number of levels of slots, each of them 2^BITS */
+#define CACHE_WHEEL_LEVELS (4)
+#define CACHE_WHEEL_BITS (8)
+#define CACHE_WHEEL_SLOTS (1 << CACHE_WHEEL_BITS)
+#define CACHE_WHEEL_MASK (CACHE_WHEEL_SLOTS - 1)
+/** Initial capacity of element to timer index, a power of two */
+#define CACHE_TIMER_INDEX_INITIAL_CAPACITY (16)
+
+/** Estimated bytes of an empty cell (set), and of a node of an element in it */
+#define CACHE_CELL_OVERHEAD ((long)(6 * sizeof(void*)))
+#define CACHE_NODE_OVERHEAD ((long)(2 * sizeof(void*)))
+
+/** Number of nodes in the first chunk of pool, each next chunk is twice larger */
+#define CACHE_POOL_FIRST_CHUNK (64)
+/** Number of chunks, so that any node index fits 32 bits */
+#define CACHE_POOL_CHUNKS (25)
+#define CACHE_POOL_MAX_NODES \
+	((uint32_t)CACHE_POOL_FIRST_CHUNK * ((1U << CACHE_POOL_CHUNKS) - 1))
+/** Stack head: index of top node + 1 (0 for empty stack) in the lower half */
+#define CACHE_POOL_INDEX_MASK (0xffffffffULL)
+/** ... and tag counting changes of the head in the upper half */
+#define CACHE_POOL_TAG_SHIFT (32)
+
+/** Number of readers of concurrent cache which can be inside a lookup at once */
+#define CACHE_READER_SLOTS (128)
+/** Reader slots are apart, so readers do not write to a shared cache line */
+#define CACHE_LINE_SIZE (64)
+/** Stack addresses of a thread differ in bits below this one only */
+#define CACHE_STACK_SHIFT (16)
+
+#ifdef __GNUC__
+#define CACHE_PREFETCH(address) __builtin_prefetch(address)
+// sequentially consistent, epochs of concurrent cache rely on single order
+#define CACHE_ATOMIC_LOAD(pointer) __atomic_load_n(pointer, __ATOMIC_SEQ_CST)
+#define CACHE_ATOMIC_STORE(pointer, value) \
+	__atomic_store_n(pointer, value, __ATOMIC_SEQ_CST)
+#define CACHE_ATOMIC_ADD(pointer, value) \
+	__atomic_fetch_add(pointer, value, __ATOMIC_SEQ_CST)
+#define CACHE_ATOMIC_CAS(pointer, expected, desired) \
+	__atomic_compare_exchange_n(pointer, expected, desired, true, \
+			__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+#else
+#define CACHE_PREFETCH(address) ((void)(address))
+// without atomic builtins pool and concurrent caches are not thread safe
+#define CACHE_ATOMIC_LOAD(pointer) (*(pointer))
+#define CACHE_ATOMIC_STORE(pointer, value) ((void)(*(pointer) = (value)))
+#define CACHE_ATOMIC_ADD(pointer, value) ((*(pointer) += (value)) - (value))
+#define CACHE_ATOMIC_CAS(pointer, expected, desired) \
+	(*(pointer) == *(expected) ? (*(pointer) = (desired), true) : \
+			(*(expected) = *(pointer), false))
+#endif
+
+/** Node of pool cell stack, nodes are never freed until cache is destroyed */
+typedef struct CachePoolNode_t {
+	CacheElement element;
+	/** index + 1 of the next node in stack, accessed atomically */
+	uint32_t next;
+} CachePoolNode;
+
+/**
+ * Pool mode storage: every cell is a Treiber stack of nodes, identified by
+ * 32-bit indices, so that a stack head and a tag against ABA fit into a word
+ * which can be compared and swapped. Popped nodes go to a free stack.
+ */
+typedef struct CachePool_t {
+	uint64_t *heads;
+	uint64_t freeHead;
+	/** number of node indices given out */
+	uint32_t nodesUsed;
+	CachePoolNode *chunks[CACHE_POOL_CHUNKS];
+	/** serializes allocation of chunks */
+	pthread_mutex_t chunksLock;
+} CachePool;
+
+/** Immutable sorted array of elements of a cell of concurrent cache */
+typedef struct CacheCellVersion_t {
+	int size;
+	CacheElement elements[];
+} CacheCellVersion;
+
+/**
+ * Cell version replaced by writer, with an element removed by the change or
+ * all elements of version, released once no reader can see them
+ */
+typedef struct CacheRetired_t {
+	uint64_t epoch;
+	CacheCellVersion *version;
+	CacheElement element;
+	bool releaseElements;
+	struct CacheRetired_t *next;
+} CacheRetired;
+
+/** Epoch a reader entered lookup at, 0 if the slot is free */
+typedef struct CacheReaderSlot_t {
+	uint64_t epoch;
+	char padding[CACHE_LINE_SIZE - sizeof(uint64_t)];
+} CacheReaderSlot;
+
+/**
+ * Concurrent mode storage: readers search cell versions without locking,
+ * writers serialized by lock publish new versions (copy on write). Retired
+ * versions are released by epochs: writer advances global epoch on every
+ * change, and releases what was retired before the oldest epoch a reader is
+ * still in. Readers finding all slots taken are only counted, and nothing is
+ * released while any of them is in.
+ */
+typedef struct CacheConcurrent_t {
+	CacheCellVersion **cells;
+	CacheReaderSlot readers[CACHE_READER_SLOTS];
+	/** readers without a slot */
+	uint64_t overflowReaders;
+	uint64_t epoch;
+	pthread_mutex_t writeLock;
+	/** retired versions, the latest first (writers only) */
+	CacheRetired *retired;
+} CacheConcurrent;
+
+/** Expiration time of an element pushed with ttl */
+typedef struct CacheTimer_t {
+	CacheElement element;
+	uint64_t expiry;
+	struct CacheTimer_t *next;
+	/** pointer to the pointer to this timer (slot head or next of previous) */
+	struct CacheTimer_t **previous;
+} CacheTimer;
+
+/**
+ * Hierarchical timer wheel: level i slot j holds timers expiring within
+ * 2^(BITS*i) ticks of slot start. Timers of higher levels are moved to lower
+ * ones (cascaded) when the wheel reaches their slot.
+ */
+typedef struct CacheTimerWheel_t {
+	CacheTimer *slots[CACHE_WHEEL_LEVELS][CACHE_WHEEL_SLOTS];
+	/** next tick to be processed */
+	uint64_t time;
+	int count;
+	/** open addressing table from element address to its timer */
+	CacheTimer **index;
+	int indexCapacity;
+} CacheTimerWheel;
+
+/**
+ * Background restore: a thread reads and decodes elements of snapshot into a
+ * bounded queue, and cache operations move them to the cache a few at a time,
+ * so the cache itself is only touched by its own thread.
+ */
+typedef struct CacheRestore_t {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	/** signalled when queue or state changes */
+	pthread_cond_t changed;
+	FILE *file;
+	DecodeCacheElement decode;
+	FreeCacheElement freeElement;
+	CacheElement queue[CACHE_RESTORE_QUEUE_SIZE];
+	int queueHead;
+	int queueCount;
+	bool done;
+	bool cancelled;
+	/** result of reading, valid once done */
+	CacheResult readResult;
+	/** first failure of adding restored elements to cache */
+	CacheResult pushResult;
+} CacheRestore;
+
+/** Budget shared between caches, used is changed atomically */
+struct cache_budget_t {
+	long limit;
+	long used;
+};
+
 typedef struct cache_t {
+	FreeCacheElement freeElement;
+	CopyCacheElement copyElement;
+	CompareCacheElements compareElements;
 	ComputeCacheKey computeKey;
+	HashCacheElement hashElement;
+	// hash of element is mixed before masking (hashed cache only)
+	bool mixHash;
 	Set *container;
 	int cache_size;
 	int iteratorIndex;
+	int elementsCount;
+	// incremental resizing (resizable cache only)
+	int minimal_size;
+	Set *oldContainer;
+	int old_size;
+	int migrateIndex;
+	// counting bloom filter in front of lookups (optional)
+	HashCacheElement bloomHash;
+	uint8_t *bloomCounters;
+	uint64_t bloomMask;
+	// bound on number of elements and admission policy (optional)
+	int capacity;
+	HashCacheElement sketchHash;
+	uint8_t *sketchCounters;
+	uint64_t sketchMask;
+	long sketchAdditions;
+	long sketchSampleSize;
+	CacheEvictionListener evictionListener;
+	void *evictionContext;
+	// memory accounting, per cell totals follow the containers (optional)
+	SizeCacheElement sizeElement;
+	long *cellBytes;
+	long *oldCellBytes;
+	long elementBytes;
+	CacheBudget budget;
+	CacheBudgetPolicy budgetPolicy;
+	// lock-free stacks instead of sets in cells (pool mode only)
+	CachePool *pool;
+	// copy on write cells with lock-free readers (concurrent mode only)
+	CacheConcurrent *concurrent;
+	// sorted copy of the cell being iterated (pool and concurrent modes)
+	Set iterationCell;
+	// expiration of elements pushed with ttl (optional)
+	CacheTimerWheel *timers;
+	CacheClock clock;
+	uint64_t now;
+	// restore from snapshot in background (optional)
+	CacheRestore *restore;
+	CacheResult restoreResult;
+#ifdef CACHE_STATS
+	CacheStats stats;
+	int probeLength;
+#endif
 } cache_t;
 
 #define CACHE_ALLOCATE(type, var, error) \
@@ -23,6 +293,70 @@ typedef struct cache_t {
 #define CACHE_CONTAINER_FOREACH(index, cache) \
 		for (int index = 0; index < cache->cache_size; ++index)
 
+/**
+ * cells keep pointers to elements owned by the cache, so that elements can be
+ * moved between cells without copying
+ */
+static SetElement cacheCellElementCopy(SetElement element) {
+	return element;
+}
+
+/** cells never release elements, cache does it */
+static void cacheCellElementFree(SetElement element) {
+}
+
+/** compares elements of cache, counting the calls in statistics build */
+static int cacheCompare(Cache cache, CacheElement element1, CacheElement element2) {
+#ifdef CACHE_STATS
+	++cache->probeLength;
+	++cache->stats.comparisons;
+#endif
+	return cache->compareElements(element1, element2);
+}
+
+#ifdef CACHE_STATS
+/**
+ * cache whose cell operation is in progress, comparator calls of cells are
+ * accounted to it. Every cell operation sets it and then restores the one
+ * before, as a cache may be called from inside another one (by an eviction
+ * listener, for example). Therefore statistics build is not thread safe.
+ */
+static Cache cacheStatsCurrent = NULL;
+
+/** comparator of cells, compares elements of the current cache */
+static int cacheStatsCompare(SetElement element1, SetElement element2) {
+	assert(cacheStatsCurrent != NULL);
+	return cacheCompare(cacheStatsCurrent, element1, element2);
+}
+
+/** accounts comparator calls of finished element lookup */
+static void cacheStatsLookupEnd(Cache cache) {
+	++cache->stats.lookups;
+	int bucket = cache->probeLength < CACHE_STATS_HISTOGRAM_SIZE ?
+			cache->probeLength : CACHE_STATS_HISTOGRAM_SIZE - 1;
+	++cache->stats.probeHistogram[bucket];
+}
+
+#define CACHE_CELL_COMPARE(cache) (cacheStatsCompare)
+#define CACHE_STATS_ENTER(cache) \
+	Cache cacheStatsOuter = cacheStatsCurrent; \
+	cacheStatsCurrent = (cache)
+#define CACHE_STATS_LEAVE() (cacheStatsCurrent = cacheStatsOuter)
+#define CACHE_STATS_COUNT(cache, counter) (++(cache)->stats.counter)
+#define CACHE_STATS_LOOKUP_BEGIN(cache) ((cache)->probeLength = 0)
+#define CACHE_STATS_LOOKUP_END(cache) cacheStatsLookupEnd(cache)
+#else
+#define CACHE_CELL_COMPARE(cache) ((cache)->compareElements)
+#define CACHE_STATS_ENTER(cache) ((void)0)
+#define CACHE_STATS_LEAVE() ((void)0)
+#define CACHE_STATS_COUNT(cache, counter) ((void)0)
+#define CACHE_STATS_LOOKUP_BEGIN(cache) ((void)0)
+#define CACHE_STATS_LOOKUP_END(cache) ((void)0)
+#endif
+
+/** Capacity of cache without bound on number of its elements */
+#define CACHE_UNBOUNDED (0)
+
 /**
  * checks if index of cell is in range
  */
@@ -30,160 +364,3135 @@ inline static bool cacheIsKeyCorrect(const Cache cache, const int key) {
 	assert(cache != NULL);
 	return 0 <= key && key < cache->cache_size;
 }
+
+/** checks whether cells of cache are chosen by bits of element hash */
+inline static bool cacheIsHashed(const Cache cache) {
+	assert(cache != NULL);
+	return cache->hashElement != NULL;
+}
+
+/** checks whether cache changes its size automatically */
+inline static bool cacheIsResizable(const Cache cache) {
+	assert(cache != NULL);
+	return cache->hashElement != NULL && !cache->mixHash;
+}
+
+/** checks whether cells of cache are lock-free stacks */
+inline static bool cacheIsPool(const Cache cache) {
+	assert(cache != NULL);
+	return cache->pool != NULL;
+}
+
+/** checks whether cells of cache are versions read without locking */
+inline static bool cacheIsConcurrent(const Cache cache) {
+	assert(cache != NULL);
+	return cache->concurrent != NULL;
+}
+
+/** checks whether cache may be used by several threads at once */
+inline static bool cacheIsShared(const Cache cache) {
+	return cacheIsPool(cache) || cacheIsConcurrent(cache);
+}
+
+/** checks whether resizable cache is moving its elements to new container */
+inline static bool cacheIsMigrating(const Cache cache) {
+	assert(cache != NULL);
+	return cache->oldContainer != NULL;
+}
+
 /**
- * creates cache with special size
+ * Mixes bits of 64-bit hash (finalizer of splitmix64), so that every bit of
+ * result depends on all bits of user hash
  */
-Cache cacheCreate(
-    int size,
-    FreeCacheElement free_element,
-    CopyCacheElement copy_element,
-    CompareCacheElements compare_elements,
-    ComputeCacheKey compute_key) {
-	if (size <= 0 || !free_element || !copy_element || !compare_elements || !compute_key) {
-		return NULL;
+static inline uint64_t cacheMixHash(uint64_t hash) {
+	hash ^= hash >> 30;
+	hash *= 0xbf58476d1ce4e5b9ULL;
+	hash ^= hash >> 27;
+	hash *= 0x94d049bb133111ebULL;
+	hash ^= hash >> 31;
+	return hash;
+}
+
+/**
+ * returns index of i-th counter of element in bloom filter (double hashing)
+ */
+static inline uint64_t cacheBloomIndex(const Cache cache, uint64_t hash, int i) {
+	uint64_t first = hash & 0xffffffffULL;
+	uint64_t second = (hash >> 32) | 1;
+	return (first + (uint64_t)i * second) & cache->bloomMask;
+}
+
+/**
+ * checks whether element might be in cache, false means it is certainly not
+ */
+static bool cacheBloomMayContain(const Cache cache, CacheElement element) {
+	if (cache->bloomCounters == NULL) {
+		return true;
 	}
-	//memory allocation
-	Cache cache;
-	CACHE_ALLOCATE(cache_t, cache, NULL);
+	uint64_t hash = cacheMixHash(cache->bloomHash(element));
+	for (int i = 0; i < CACHE_BLOOM_HASHES; ++i) {
+		if (cache->bloomCounters[cacheBloomIndex(cache, hash, i)] == 0) {
+			return false;
+		}
+	}
+	return true;
+}
 
-	//initialization
-	cache->computeKey = compute_key;
-	cache->cache_size = size;
-	cache->iteratorIndex = CACHE_INVALID_ITERATOR_INDEX;
-	cache->container = (Set*)malloc(sizeof(*cache->container) * size);
-	if (cache->container == NULL) {
-		cacheDestroy(cache);
-		return NULL;
+/**
+ * adds (delta = 1) or removes (delta = -1) element from bloom filter.
+ * Saturated counters are never decreased, since their real value is unknown.
+ */
+static void cacheBloomUpdate(Cache cache, CacheElement element, int delta) {
+	if (cache->bloomCounters == NULL) {
+		return;
 	}
-	CACHE_CONTAINER_FOREACH(i, cache) {
-		cache->container[i] = setCreate(copy_element, free_element, compare_elements);
-		if (cache->container[i] == NULL) {
-			cacheDestroy(cache);
-			return NULL;
+	uint64_t hash = cacheMixHash(cache->bloomHash(element));
+	for (int i = 0; i < CACHE_BLOOM_HASHES; ++i) {
+		uint8_t *counter = cache->bloomCounters + cacheBloomIndex(cache, hash, i);
+		if (*counter != CACHE_BLOOM_COUNTER_MAX) {
+			assert(delta > 0 || *counter > 0);
+			*counter += delta;
 		}
 	}
-	return cache;
 }
 
-CacheResult cachePush(Cache cache, CacheElement element) {
-	if (cache == NULL || element == NULL) {
-		return CACHE_NULL_ARGUMENT;
+/** returns index of counter of element hash in given row of sketch */
+static inline uint64_t cacheSketchIndex(const Cache cache, uint64_t hash, int row) {
+	uint64_t first = hash & 0xffffffffULL;
+	uint64_t second = (hash >> 32) | 1;
+	uint64_t width = cache->sketchMask + 1;
+	return (uint64_t)row * width + ((first + (uint64_t)row * second) & cache->sketchMask);
+}
+
+/** estimates how many times element was accessed recently */
+static int cacheSketchEstimate(const Cache cache, CacheElement element) {
+	if (cache->sketchCounters == NULL) {
+		return 0;
+	}
+	uint64_t hash = cacheMixHash(cache->sketchHash(element));
+	int estimate = CACHE_SKETCH_COUNTER_MAX;
+	for (int row = 0; row < CACHE_SKETCH_ROWS; ++row) {
+		int counter = cache->sketchCounters[cacheSketchIndex(cache, hash, row)];
+		if (counter < estimate) {
+			estimate = counter;
+		}
 	}
+	return estimate;
+}
 
-	int cellIndex = cache->computeKey(element);
-	if (!cacheIsKeyCorrect(cache, cellIndex)) {
-		return CACHE_OUT_OF_RANGE;
+/**
+ * records access to element. Only the smallest counters are increased
+ * (conservative update), and all counters are halved once in a sample
+ * period, so that old popularity fades.
+ */
+static void cacheSketchRecord(Cache cache, CacheElement element) {
+	if (cache->sketchCounters == NULL) {
+		return;
+	}
+	int estimate = cacheSketchEstimate(cache, element);
+	if (estimate < CACHE_SKETCH_COUNTER_MAX) {
+		uint64_t hash = cacheMixHash(cache->sketchHash(element));
+		for (int row = 0; row < CACHE_SKETCH_ROWS; ++row) {
+			uint8_t *counter = cache->sketchCounters + cacheSketchIndex(cache, hash, row);
+			if (*counter == estimate) {
+				++*counter;
+			}
+		}
+	}
+	if (++cache->sketchAdditions < cache->sketchSampleSize) {
+		return;
+	}
+	uint64_t counters = (cache->sketchMask + 1) * CACHE_SKETCH_ROWS;
+	for (uint64_t i = 0; i < counters; ++i) {
+		cache->sketchCounters[i] /= 2;
 	}
+	cache->sketchAdditions /= 2;
+}
 
-	if (cacheIsIn(cache, element)) {
-		return CACHE_ITEM_ALREADY_EXISTS;
+/** returns position of element's timer in index, or of empty place for it */
+static int cacheTimerIndexFind(const CacheTimerWheel *wheel, CacheElement element) {
+	int mask = wheel->indexCapacity - 1;
+	int position = (int)(cacheMixHash((uint64_t)(uintptr_t)element) & (uint64_t)mask);
+	while (wheel->index[position] != NULL && wheel->index[position]->element != element) {
+		position = (position + 1) & mask;
 	}
+	return position;
+}
 
-	SetResult setAddResult = setAdd(cache->container[cellIndex], element);
-	if (setAddResult == SET_OUT_OF_MEMORY) {
-		return CACHE_OUT_OF_MEMORY;
+/** grows index if needed, so that one more timer can be added */
+static bool cacheTimerIndexReserve(CacheTimerWheel *wheel) {
+	if ((wheel->count + 1) * 2 <= wheel->indexCapacity) {
+		return true;
 	}
-	assert(setAddResult == SET_SUCCESS);
+	CacheTimer **oldIndex = wheel->index;
+	int oldCapacity = wheel->indexCapacity;
+	CacheTimer **newIndex = (CacheTimer**)calloc(oldCapacity * 2, sizeof(*newIndex));
+	if (newIndex == NULL) {
+		return false;
+	}
+	wheel->index = newIndex;
+	wheel->indexCapacity = oldCapacity * 2;
+	for (int i = 0; i < oldCapacity; ++i) {
+		if (oldIndex[i] != NULL) {
+			wheel->index[cacheTimerIndexFind(wheel, oldIndex[i]->element)] = oldIndex[i];
+		}
+	}
+	free(oldIndex);
+	return true;
+}
 
-	return CACHE_SUCCESS;
+/** removes entry at position from index, keeping probe chains unbroken */
+static void cacheTimerIndexRemoveAt(CacheTimerWheel *wheel, int position) {
+	int mask = wheel->indexCapacity - 1;
+	wheel->index[position] = NULL;
+	for (int next = (position + 1) & mask; wheel->index[next] != NULL; next = (next + 1) & mask) {
+		int home = (int)(cacheMixHash((uint64_t)(uintptr_t)wheel->index[next]->element) &
+				(uint64_t)mask);
+		// entry may move to the hole if its home is not inside (hole, next]
+		bool movable = position <= next ?
+				(home <= position || home > next) : (home <= position && home > next);
+		if (movable) {
+			wheel->index[position] = wheel->index[next];
+			wheel->index[next] = NULL;
+			position = next;
+		}
+	}
 }
 
-CacheResult cacheFreeElement(Cache cache, CacheElement element) {
-	if (cache == NULL || element == NULL) {
-		return CACHE_NULL_ARGUMENT;
+/** links timer into the wheel slot matching its expiry */
+static void cacheTimerLink(CacheTimerWheel *wheel, CacheTimer *timer) {
+	assert(timer->expiry >= wheel->time);
+	uint64_t delta = timer->expiry - wheel->time;
+	int level = 0;
+	while (level < CACHE_WHEEL_LEVELS - 1 &&
+			delta >= ((uint64_t)1 << (CACHE_WHEEL_BITS * (level + 1)))) {
+		++level;
+	}
+	uint64_t expiry = timer->expiry;
+	uint64_t limit = wheel->time +
+			(((uint64_t)1 << (CACHE_WHEEL_BITS * CACHE_WHEEL_LEVELS)) - 1);
+	if (level == CACHE_WHEEL_LEVELS - 1 && expiry > limit) {
+		// too far away, wait in the farthest slot and be linked again later
+		expiry = limit;
 	}
+	CacheTimer **head = &wheel->slots[level]
+			[(expiry >> (CACHE_WHEEL_BITS * level)) & CACHE_WHEEL_MASK];
+	timer->next = *head;
+	if (*head != NULL) {
+		(*head)->previous = &timer->next;
+	}
+	timer->previous = head;
+	*head = timer;
+}
 
-	int key = cache->computeKey(element);
-	if (!cacheIsKeyCorrect(cache, key)){
-		return CACHE_ITEM_DOES_NOT_EXIST;
+/** unlinks timer from its slot */
+static void cacheTimerUnlink(CacheTimer *timer) {
+	*timer->previous = timer->next;
+	if (timer->next != NULL) {
+		timer->next->previous = timer->previous;
 	}
-	SetResult removeResult = setRemove(cache->container[key], element);
-	if (removeResult == SET_ITEM_DOES_NOT_EXIST) {
-		return CACHE_ITEM_DOES_NOT_EXIST;
+}
+
+/** removes timer of element, if it has one */
+static void cacheTimerCancel(Cache cache, CacheElement element) {
+	CacheTimerWheel *wheel = cache->timers;
+	if (wheel == NULL || wheel->count == 0) {
+		return;
 	}
-	assert(removeResult == SET_SUCCESS);
-	return CACHE_SUCCESS;
+	int position = cacheTimerIndexFind(wheel, element);
+	CacheTimer *timer = wheel->index[position];
+	if (timer == NULL) {
+		return;
+	}
+	cacheTimerIndexRemoveAt(wheel, position);
+	cacheTimerUnlink(timer);
+	free(timer);
+	--wheel->count;
 }
 
-CacheElement cacheExtractElementByKey(Cache cache, int key){
-	if (cache == NULL) {
-		return NULL;
+/** releases all timers, the wheel remains empty */
+static void cacheTimerWheelClear(CacheTimerWheel *wheel) {
+	if (wheel == NULL) {
+		return;
+	}
+	for (int level = 0; level < CACHE_WHEEL_LEVELS; ++level) {
+		for (int slot = 0; slot < CACHE_WHEEL_SLOTS; ++slot) {
+			while (wheel->slots[level][slot] != NULL) {
+				CacheTimer *timer = wheel->slots[level][slot];
+				wheel->slots[level][slot] = timer->next;
+				free(timer);
+			}
+		}
 	}
+	memset(wheel->index, 0, sizeof(*wheel->index) * wheel->indexCapacity);
+	wheel->count = 0;
+}
 
-	if (!cacheIsKeyCorrect(cache, key)) {
-		return NULL;
+/** releases timer wheel */
+static void cacheTimerWheelDestroy(CacheTimerWheel *wheel) {
+	if (wheel == NULL) {
+		return;
 	}
+	cacheTimerWheelClear(wheel);
+	free(wheel->index);
+	free(wheel);
+}
 
-	if (setGetSize(cache->container[key]) == 0) {
-		return NULL;
+/** creates timer wheel of cache on first use */
+static bool cacheTimerWheelEnsure(Cache cache) {
+	if (cache->timers != NULL) {
+		return true;
+	}
+	CacheTimerWheel *wheel = (CacheTimerWheel*)calloc(1, sizeof(*wheel));
+	if (wheel == NULL) {
+		return false;
 	}
-	CacheElement result = setExtract(cache->container[key], setGetFirst(cache->container[key]));
+	wheel->index = (CacheTimer**)calloc(CACHE_TIMER_INDEX_INITIAL_CAPACITY, sizeof(*wheel->index));
+	if (wheel->index == NULL) {
+		free(wheel);
+		return false;
+	}
+	wheel->indexCapacity = CACHE_TIMER_INDEX_INITIAL_CAPACITY;
+	wheel->time = cache->now + 1;
+	cache->timers = wheel;
+	return true;
+}
+
+/** creates cell for cache */
+static Set cacheCellCreate(Cache cache) {
+	return setCreate(cacheCellElementCopy, cacheCellElementFree, CACHE_CELL_COMPARE(cache));
+}
+
+/** adds element to cell of cache, see setAdd */
+static SetResult cacheCellAdd(Cache cache, Set cell, CacheElement element) {
+	CACHE_STATS_ENTER(cache);
+	SetResult result = setAdd(cell, element);
+	CACHE_STATS_LEAVE();
 	return result;
 }
 
-bool cacheIsIn(Cache cache, CacheElement element) {
-	if (cache == NULL || element == NULL) {
-		// null argument
-		return false;
+/** checks whether element is in cell of cache, see setIsIn */
+static bool cacheCellIsIn(Cache cache, Set cell, CacheElement element) {
+	CACHE_STATS_ENTER(cache);
+	bool found = setIsIn(cell, element);
+	CACHE_STATS_LEAVE();
+	return found;
+}
+
+/** takes element out of cell of cache, see setExtract */
+static CacheElement cacheCellExtract(Cache cache, Set cell, CacheElement element) {
+	CACHE_STATS_ENTER(cache);
+	CacheElement extracted = setExtract(cell, element);
+	CACHE_STATS_LEAVE();
+	return extracted;
+}
+
+/** empties cell of cache without releasing its elements, see setClear */
+static void cacheCellEmpty(Cache cache, Set cell) {
+	CACHE_STATS_ENTER(cache);
+	setClear(cell);
+	CACHE_STATS_LEAVE();
+}
+
+/**
+ * releases all elements of cell, the cell remains empty. Every element leaves
+ * the cell before it is freed, as the set may compare its elements while
+ * removing them.
+ */
+static void cacheCellClear(Cache cache, Set cell) {
+	if (cell == NULL) {
+		return;
 	}
-	int key = cache->computeKey(element);
-	if (!cacheIsKeyCorrect(cache, key)) {
-		// out of range
-		return NULL;
+	CacheElement element;
+	while ((element = setGetFirst(cell)) != NULL) {
+		cacheCellExtract(cache, cell, element);
+		cache->freeElement(element);
 	}
-	return setIsIn(cache->container[key], element);
 }
 
-Set cacheGetFirst(Cache cache) {
-	if (cache == NULL) {
-		return NULL;
+/** releases all elements and cells of container */
+static void cacheContainerDestroy(Cache cache, Set *container, int size) {
+	if (container == NULL) {
+		return;
+	}
+	for (int i = 0; i < size; ++i) {
+		cacheCellClear(cache, container[i]);
+		setDestroy(container[i]);
 	}
-	cache->iteratorIndex = 0;
-	return cache->container[cache->iteratorIndex];
+	free(container);
 }
 
-Set cacheGetNext(Cache cache) {
-	if (cache == NULL ||
-			cache->iteratorIndex == CACHE_INVALID_ITERATOR_INDEX) {
-		return NULL;
+/**
+ * returns cell stored in slot, resizable cache creates its cells on demand
+ * @return NULL if cell does not exist and create is false or on allocation
+ * failure
+ */
+static Set cacheSlotGetCell(Cache cache, Set *slot, bool create) {
+	assert(slot != NULL);
+	if (*slot == NULL && create) {
+		*slot = cacheCellCreate(cache);
 	}
+	return *slot;
+}
 
-	if (cache->iteratorIndex + 1 == cache->cache_size) {
-		cache->iteratorIndex = CACHE_INVALID_ITERATOR_INDEX;
-		return NULL;
+/**
+ * computes code which locates element in cache: its key, or its (mixed) hash
+ * for hashed cache. Unlike cell index it does not change when cache resizes.
+ */
+static uint64_t cacheElementCode(Cache cache, CacheElement element) {
+	if (!cacheIsHashed(cache)) {
+		return (uint64_t)(int64_t)cache->computeKey(element);
+	}
+	uint64_t hash = cache->hashElement(element);
+	return cache->mixHash ? cacheMixHash(hash) : hash;
+}
+
+/**
+ * finds slot of cell which element with given code belongs to
+ * @return NULL if key of element is out of range
+ */
+static Set *cacheFindSlotByCode(Cache cache, uint64_t code) {
+	if (!cacheIsHashed(cache)) {
+		int key = (int)(int64_t)code;
+		return cacheIsKeyCorrect(cache, key) ? cache->container + key : NULL;
+	}
+	uint64_t hash = code;
+	if (cacheIsMigrating(cache)) {
+		int oldIndex = (int)(hash & (uint64_t)(cache->old_size - 1));
+		if (oldIndex >= cache->migrateIndex) {
+			// not moved yet
+			return cache->oldContainer + oldIndex;
+		}
 	}
-	++cache->iteratorIndex;
+	return cache->container + (int)(hash & (uint64_t)(cache->cache_size - 1));
+}
 
-	return cache->container[cache->iteratorIndex];
+/**
+ * finds slot of cell which element belongs to
+ * @return NULL if key of element is out of range
+ */
+static Set *cacheFindSlot(Cache cache, CacheElement element) {
+	return cacheFindSlotByCode(cache, cacheElementCode(cache, element));
 }
 
-Set cacheGetCurrent(Cache cache) {
-	if (cache == NULL || cache->iteratorIndex == CACHE_INVALID_ITERATOR_INDEX){
-		return NULL;
+/** checks whether cache keeps totals of bytes of its elements */
+inline static bool cacheIsAccounted(const Cache cache) {
+	return cache->cellBytes != NULL;
+}
+
+/** returns bytes accounted for element */
+static long cacheElementBytes(Cache cache, CacheElement element) {
+	long bytes = CACHE_NODE_OVERHEAD;
+	if (cache->sizeElement != NULL) {
+		bytes += cache->sizeElement(element);
 	}
-	return cache->container[cache->iteratorIndex];
+	return bytes;
 }
 
-CacheResult cacheClear(Cache cache) {
-	if (cache == NULL) {
-		return CACHE_NULL_ARGUMENT;
+/** returns total of bytes of cell in slot of either container */
+static long *cacheSlotBytes(Cache cache, Set *slot) {
+	assert(cacheIsAccounted(cache) && slot != NULL);
+	uintptr_t address = (uintptr_t)slot;
+	uintptr_t begin = (uintptr_t)cache->container;
+	if (address >= begin && address < (uintptr_t)(cache->container + cache->cache_size)) {
+		return cache->cellBytes + (slot - cache->container);
 	}
+	assert(cacheIsMigrating(cache));
+	return cache->oldCellBytes + (slot - cache->oldContainer);
+}
 
-	CACHE_CONTAINER_FOREACH(i, cache) {
-		setClear(cache->container[i]);
+/**
+ * adds (sign 1) or subtracts (sign -1) bytes of element to totals of its
+ * cell and cache. Budget is charged before element is added, and is returned
+ * its bytes here.
+ */
+static void cacheAccountElement(Cache cache, CacheElement element, int sign) {
+	if (!cacheIsAccounted(cache)) {
+		return;
+	}
+	long bytes = cacheElementBytes(cache, element);
+	*cacheSlotBytes(cache, cacheFindSlot(cache, element)) += sign * bytes;
+	cache->elementBytes += sign * bytes;
+	if (sign < 0 && cache->budget != NULL) {
+		CACHE_ATOMIC_ADD(&cache->budget->used, -bytes);
 	}
+}
 
-	return CACHE_SUCCESS;
+/**
+ * charges bytes to budget if they fit
+ * @return false if they do not
+ */
+static bool cacheBudgetReserve(CacheBudget budget, long bytes) {
+	long used = CACHE_ATOMIC_LOAD(&budget->used);
+	do {
+		if (used + bytes > budget->limit) {
+			return false;
+		}
+	} while (!CACHE_ATOMIC_CAS(&budget->used, &used, used + bytes));
+	return true;
 }
 
-void cacheDestroy(Cache cache) {
-	if (cache == NULL) {
-		return;
+/** returns bytes charged to budget of cache, if it has one */
+static void cacheBudgetRelease(Cache cache, long bytes) {
+	if (cache->budget != NULL) {
+		CACHE_ATOMIC_ADD(&cache->budget->used, -bytes);
 	}
+}
 
-	for (int i = 0; i < cache->cache_size; ++i) {
-		setDestroy(cache->container[i]);
+/**
+ * moves elements of the next old cell to the new container
+ * @return false if allocation failed, the cell is left in old container then
+ */
+static bool cacheMigrateCell(Cache cache) {
+	assert(cacheIsMigrating(cache));
+	Set oldCell = cache->oldContainer[cache->migrateIndex];
+	while (oldCell != NULL && setGetSize(oldCell) > 0) {
+		CacheElement element = setGetFirst(oldCell);
+		uint64_t hash = cacheElementCode(cache, element);
+		Set *slot = cache->container + (int)(hash & (uint64_t)(cache->cache_size - 1));
+		Set newCell = cacheSlotGetCell(cache, slot, true);
+		if (newCell == NULL || cacheCellAdd(cache, newCell, element) == SET_OUT_OF_MEMORY) {
+			return false;
+		}
+		cacheCellExtract(cache, oldCell, element);
+		if (cacheIsAccounted(cache)) {
+			long bytes = cacheElementBytes(cache, element);
+			cache->cellBytes[slot - cache->container] += bytes;
+			cache->oldCellBytes[cache->migrateIndex] -= bytes;
+		}
 	}
-	free(cache->container);
-	free(cache);
+	setDestroy(oldCell);
+	cache->oldContainer[cache->migrateIndex++] = NULL;
+	if (cache->migrateIndex == cache->old_size) {
+		free(cache->oldContainer);
+		free(cache->oldCellBytes);
+		cache->oldCellBytes = NULL;
+		cache->oldContainer = NULL;
+		cache->old_size = 0;
+		cache->migrateIndex = 0;
+	}
+	return true;
+}
+
+/**
+ * does a bounded portion of migration, called on every operation, so the cost
+ * of resize is spread between them
+ */
+static void cacheResizeStep(Cache cache) {
+	int emptyVisited = 0;
+	for (int moved = 0; cacheIsMigrating(cache) &&
+			moved < CACHE_RESIZE_STEP && emptyVisited < CACHE_RESIZE_EMPTY_STEP; ) {
+		Set oldCell = cache->oldContainer[cache->migrateIndex];
+		if (oldCell == NULL || setGetSize(oldCell) == 0) {
+			++emptyVisited;
+		} else {
+			++moved;
+		}
+		if (!cacheMigrateCell(cache)) {
+			// not enough memory, try next time
+			return;
+		}
+	}
+}
+
+/** completes migration if there is one */
+static bool cacheResizeFinish(Cache cache) {
+	while (cacheIsMigrating(cache)) {
+		if (!cacheMigrateCell(cache)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * starts migration to container of new size if cache is too loaded or too
+ * sparse. Allocation failure is not an error, cache just stays in its size.
+ */
+static void cacheResizeIfNeeded(Cache cache) {
+	if (!cacheIsResizable(cache) || cacheIsMigrating(cache)) {
+		return;
+	}
+	int newSize;
+	if (cache->elementsCount > cache->cache_size * CACHE_RESIZE_GROW_LOAD) {
+		newSize = cache->cache_size * 2;
+	} else if (cache->cache_size > cache->minimal_size &&
+			cache->elementsCount * CACHE_RESIZE_SHRINK_RATIO < cache->cache_size) {
+		newSize = cache->cache_size / 2;
+	} else {
+		return;
+	}
+	// cells are created on demand, so the cost here does not depend on size
+	Set *newContainer = (Set*)calloc(newSize, sizeof(*newContainer));
+	long *newCellBytes = NULL;
+	if (cacheIsAccounted(cache)) {
+		newCellBytes = (long*)calloc(newSize, sizeof(*newCellBytes));
+	}
+	if (newContainer == NULL || (cacheIsAccounted(cache) && newCellBytes == NULL)) {
+		free(newContainer);
+		free(newCellBytes);
+		return;
+	}
+	cache->oldCellBytes = cache->cellBytes;
+	cache->cellBytes = newCellBytes;
+	cache->oldContainer = cache->container;
+	cache->old_size = cache->cache_size;
+	cache->migrateIndex = 0;
+	cache->container = newContainer;
+	cache->cache_size = newSize;
+	cache->iteratorIndex = CACHE_INVALID_ITERATOR_INDEX;
+}
+
+/** updates cache state after element was added to one of cells */
+static void cacheElementAdded(Cache cache, CacheElement element) {
+	++cache->elementsCount;
+	cacheAccountElement(cache, element, 1);
+	cacheBloomUpdate(cache, element, 1);
+	cacheResizeIfNeeded(cache);
+}
+
+/**
+ * updates cache state after element was taken out of its cell, element
+ * itself is not released
+ */
+static void cacheElementRemoved(Cache cache, CacheElement element) {
+	--cache->elementsCount;
+	cacheAccountElement(cache, element, -1);
+	cacheTimerCancel(cache, element);
+	cacheBloomUpdate(cache, element, -1);
+	cacheResizeIfNeeded(cache);
+}
+
+/**
+ * removes element whose time has come from cache and releases it, timer must
+ * be unlinked from the wheel already
+ */
+static void cacheTimerFire(Cache cache, CacheTimer *timer) {
+	CacheTimerWheel *wheel = cache->timers;
+	CacheElement element = timer->element;
+	cacheTimerIndexRemoveAt(wheel, cacheTimerIndexFind(wheel, element));
+	free(timer);
+	--wheel->count;
+
+	Set *slot = cacheFindSlot(cache, element);
+	assert(slot != NULL && *slot != NULL);
+	CacheElement removed = cacheCellExtract(cache, *slot, element);
+	assert(removed == element);
+	cacheElementRemoved(cache, removed);
+	cache->freeElement(removed);
+}
+
+/** moves timers of a higher level slot to lower levels */
+static void cacheTimerCascade(Cache cache, int level, int slot) {
+	CacheTimerWheel *wheel = cache->timers;
+	CacheTimer *timer = wheel->slots[level][slot];
+	wheel->slots[level][slot] = NULL;
+	while (timer != NULL) {
+		CacheTimer *next = timer->next;
+		cacheTimerLink(wheel, timer);
+		timer = next;
+	}
+}
+
+/** processes a single tick: cascades higher levels if needed, fires timers */
+static void cacheTimerTick(Cache cache) {
+	CacheTimerWheel *wheel = cache->timers;
+	uint64_t time = wheel->time;
+	// cascade from the highest level reached at this tick down
+	int levels = 1;
+	while (levels < CACHE_WHEEL_LEVELS &&
+			((time >> (CACHE_WHEEL_BITS * (levels - 1))) & CACHE_WHEEL_MASK) == 0) {
+		++levels;
+	}
+	for (int level = levels - 1; level > 0; --level) {
+		cacheTimerCascade(cache, level, (time >> (CACHE_WHEEL_BITS * level)) & CACHE_WHEEL_MASK);
+	}
+	CacheTimer **head = &wheel->slots[0][time & CACHE_WHEEL_MASK];
+	while (*head != NULL) {
+		CacheTimer *timer = *head;
+		assert(timer->expiry == time);
+		cacheTimerUnlink(timer);
+		cacheTimerFire(cache, timer);
+	}
+	++wheel->time;
+}
+
+/**
+ * fires all timers at once and links the rest again, cheaper than ticking
+ * when time jumps far relative to number of timers
+ */
+static void cacheTimerRebase(Cache cache, uint64_t now) {
+	CacheTimerWheel *wheel = cache->timers;
+	CacheTimer *pending = NULL;
+	for (int level = 0; level < CACHE_WHEEL_LEVELS; ++level) {
+		for (int slot = 0; slot < CACHE_WHEEL_SLOTS; ++slot) {
+			while (wheel->slots[level][slot] != NULL) {
+				CacheTimer *timer = wheel->slots[level][slot];
+				cacheTimerUnlink(timer);
+				// previous is not used while pending
+				timer->next = pending;
+				pending = timer;
+			}
+		}
+	}
+	wheel->time = now + 1;
+	while (pending != NULL) {
+		CacheTimer *timer = pending;
+		pending = pending->next;
+		if (timer->expiry <= now) {
+			cacheTimerFire(cache, timer);
+		} else {
+			cacheTimerLink(wheel, timer);
+		}
+	}
+}
+
+/** advances the wheel to time now, removing all elements expired by then */
+static void cacheExpireUntil(Cache cache, uint64_t now) {
+	if (now == UINT64_MAX) {
+		// wheel keeps the next tick, which must not wrap around
+		now = UINT64_MAX - 1;
+	}
+	if (now <= cache->now) {
+		// time does not go back
+		return;
+	}
+	cache->now = now;
+	CacheTimerWheel *wheel = cache->timers;
+	if (wheel == NULL) {
+		return;
+	}
+	if (wheel->count == 0) {
+		wheel->time = now + 1;
+		return;
+	}
+	if ((now - wheel->time) / CACHE_WHEEL_SLOTS > (uint64_t)wheel->count) {
+		cacheTimerRebase(cache, now);
+		return;
+	}
+	while (wheel->time <= now) {
+		cacheTimerTick(cache);
+		// skip empty slots of the lowest level up to the next cascade
+		while (wheel->time <= now && (wheel->time & CACHE_WHEEL_MASK) != 0 &&
+				wheel->slots[0][wheel->time & CACHE_WHEEL_MASK] == NULL) {
+			++wheel->time;
+		}
+	}
+}
+
+/** expires elements according to cache clock, if cache has one */
+static void cacheExpireLazily(Cache cache) {
+	if (cache->clock != NULL) {
+		cacheExpireUntil(cache, cache->clock());
+	}
+}
+
+/** checks whether cache has to evict an element before adding another one */
+static bool cacheIsFull(const Cache cache) {
+	return cache->capacity != CACHE_UNBOUNDED && cache->elementsCount >= cache->capacity;
+}
+
+/**
+ * finds the first non empty cell after cell index of current container, and
+ * then in part of old container which was not migrated yet
+ * @return NULL if cache is empty
+ */
+static Set cacheFindNonEmptyCell(Cache cache, int index) {
+	for (int i = 1; i <= cache->cache_size; ++i) {
+		Set cell = cache->container[(index + i) % cache->cache_size];
+		if (cell != NULL && setGetSize(cell) > 0) {
+			return cell;
+		}
+	}
+	for (int i = cache->migrateIndex; i < cache->old_size; ++i) {
+		Set cell = cache->oldContainer[i];
+		if (cell != NULL && setGetSize(cell) > 0) {
+			return cell;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * makes room for element with given code in full cache. The victim is the
+ * least frequent element of the element's cell, or of the next non empty cell.
+ * With admission filter the element replaces the victim only if it is more
+ * frequent, otherwise nothing is evicted.
+ */
+static CacheResult cacheEvictFor(Cache cache, CacheElement element, uint64_t code) {
+	Set *slot = cacheFindSlotByCode(cache, code);
+	assert(slot != NULL);
+	Set cell = *slot;
+	if (cell == NULL || setGetSize(cell) == 0) {
+		int index = cacheIsHashed(cache) ?
+				(int)(code & (uint64_t)(cache->cache_size - 1)) : (int)(int64_t)code;
+		cell = cacheFindNonEmptyCell(cache, index);
+	}
+	assert(cell != NULL);
+	CacheElement victim = NULL;
+	int victimFrequency = INT_MAX;
+	SET_FOREACH(CacheElement, candidate, cell) {
+		int frequency = cacheSketchEstimate(cache, candidate);
+		if (frequency < victimFrequency) {
+			victim = candidate;
+			victimFrequency = frequency;
+		}
+	}
+	if (cache->sketchCounters != NULL &&
+			cacheSketchEstimate(cache, element) <= victimFrequency) {
+		return CACHE_ITEM_REJECTED;
+	}
+	CacheElement removed = cacheCellExtract(cache, cell, victim);
+	assert(removed == victim);
+	cacheElementRemoved(cache, removed);
+	if (cache->evictionListener != NULL) {
+		cache->evictionListener(removed, cache->evictionContext);
+	}
+	cache->freeElement(removed);
+	return CACHE_SUCCESS;
+}
+
+/**
+ * charges bytes of element with given code to budget of cache, evicting
+ * elements of the cache while they do not fit if policy says so
+ */
+static CacheResult cacheBudgetMakeRoom(Cache cache, CacheElement element, uint64_t code,
+		long bytes) {
+	assert(cache->budget != NULL);
+	if (bytes > cache->budget->limit) {
+		return CACHE_ITEM_REJECTED;
+	}
+	while (!cacheBudgetReserve(cache->budget, bytes)) {
+		if (cache->budgetPolicy == CACHE_BUDGET_REJECT || cache->elementsCount == 0) {
+			return CACHE_ITEM_REJECTED;
+		}
+		CacheResult evictResult = cacheEvictFor(cache, element, code);
+		if (evictResult != CACHE_SUCCESS) {
+			return evictResult;
+		}
+	}
+	return CACHE_SUCCESS;
+}
+
+/** returns node of pool with given index, its chunk must exist */
+static CachePoolNode *cachePoolNode(const CachePool *pool, uint32_t index) {
+	int chunk = 0;
+	uint32_t chunkSize = CACHE_POOL_FIRST_CHUNK;
+	while (index >= chunkSize) {
+		index -= chunkSize;
+		chunkSize *= 2;
+		++chunk;
+	}
+	CachePoolNode *nodes = CACHE_ATOMIC_LOAD(&pool->chunks[chunk]);
+	assert(nodes != NULL);
+	return nodes + index;
+}
+
+/** pushes node on stack */
+static void cachePoolStackPush(CachePool *pool, uint64_t *head, uint32_t index) {
+	CachePoolNode *node = cachePoolNode(pool, index);
+	uint64_t old = CACHE_ATOMIC_LOAD(head);
+	uint64_t new;
+	do {
+		CACHE_ATOMIC_STORE(&node->next, (uint32_t)(old & CACHE_POOL_INDEX_MASK));
+		uint64_t tag = (old >> CACHE_POOL_TAG_SHIFT) + 1;
+		new = tag << CACHE_POOL_TAG_SHIFT | (uint64_t)(index + 1);
+	} while (!CACHE_ATOMIC_CAS(head, &old, new));
+}
+
+/**
+ * pops node from stack. Next of a node may be read after another thread
+ * popped and reused it, then the tag of head has changed and swap fails.
+ * @return false if stack is empty
+ */
+static bool cachePoolStackPop(CachePool *pool, uint64_t *head, uint32_t *index) {
+	uint64_t old = CACHE_ATOMIC_LOAD(head);
+	while ((old & CACHE_POOL_INDEX_MASK) != 0) {
+		uint32_t top = (uint32_t)(old & CACHE_POOL_INDEX_MASK) - 1;
+		uint32_t next = CACHE_ATOMIC_LOAD(&cachePoolNode(pool, top)->next);
+		uint64_t tag = (old >> CACHE_POOL_TAG_SHIFT) + 1;
+		if (CACHE_ATOMIC_CAS(head, &old, tag << CACHE_POOL_TAG_SHIFT | next)) {
+			*index = top;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * takes node from free stack, or a new one
+ * @return false on allocation failure
+ */
+static bool cachePoolAllocateNode(CachePool *pool, uint32_t *index) {
+	if (cachePoolStackPop(pool, &pool->freeHead, index)) {
+		return true;
+	}
+	uint32_t fresh = CACHE_ATOMIC_ADD(&pool->nodesUsed, 1);
+	if (fresh >= CACHE_POOL_MAX_NODES) {
+		return false;
+	}
+	int chunk = 0;
+	uint32_t chunkStart = 0;
+	uint32_t chunkSize = CACHE_POOL_FIRST_CHUNK;
+	while (fresh >= chunkStart + chunkSize) {
+		chunkStart += chunkSize;
+		chunkSize *= 2;
+		++chunk;
+	}
+	if (CACHE_ATOMIC_LOAD(&pool->chunks[chunk]) == NULL) {
+		pthread_mutex_lock(&pool->chunksLock);
+		if (pool->chunks[chunk] == NULL) {
+			CachePoolNode *nodes = (CachePoolNode*)calloc(chunkSize, sizeof(*nodes));
+			CACHE_ATOMIC_STORE(&pool->chunks[chunk], nodes);
+		}
+		pthread_mutex_unlock(&pool->chunksLock);
+		if (CACHE_ATOMIC_LOAD(&pool->chunks[chunk]) == NULL) {
+			// the index is lost, a later allocation retries the chunk
+			return false;
+		}
+	}
+	*index = fresh;
+	return true;
+}
+
+/** adds copy of element to cell key of pool, O(1) and thread safe */
+static CacheResult cachePoolPush(Cache cache, CacheElement element, int key) {
+	if (!cacheIsKeyCorrect(cache, key)) {
+		return CACHE_OUT_OF_RANGE;
+	}
+	CachePool *pool = cache->pool;
+	uint32_t index;
+	if (!cachePoolAllocateNode(pool, &index)) {
+		return CACHE_OUT_OF_MEMORY;
+	}
+	CacheElement copy = cache->copyElement(element);
+	if (copy == NULL) {
+		cachePoolStackPush(pool, &pool->freeHead, index);
+		return CACHE_OUT_OF_MEMORY;
+	}
+	cachePoolNode(pool, index)->element = copy;
+	cachePoolStackPush(pool, pool->heads + key, index);
+	CACHE_ATOMIC_ADD(&cache->elementsCount, 1);
+	return CACHE_SUCCESS;
+}
+
+/**
+ * removes the last pushed element of cell key of pool, O(1) and thread safe
+ * @return NULL if the cell is empty
+ */
+static CacheElement cachePoolPop(Cache cache, int key) {
+	CachePool *pool = cache->pool;
+	uint32_t index;
+	if (!cachePoolStackPop(pool, pool->heads + key, &index)) {
+		return NULL;
+	}
+	CacheElement element = cachePoolNode(pool, index)->element;
+	cachePoolStackPush(pool, &pool->freeHead, index);
+	CACHE_ATOMIC_ADD(&cache->elementsCount, -1);
+	return element;
+}
+
+/**
+ * searches cell key of pool for element, linear in size of the cell
+ * @return false if not found
+ */
+static bool cachePoolIsIn(Cache cache, CacheElement element, int key) {
+	if (!cacheIsKeyCorrect(cache, key)) {
+		return false;
+	}
+	CachePool *pool = cache->pool;
+	uint32_t next = (uint32_t)(CACHE_ATOMIC_LOAD(pool->heads + key) & CACHE_POOL_INDEX_MASK);
+	while (next != 0) {
+		CachePoolNode *node = cachePoolNode(pool, next - 1);
+		if (cacheCompare(cache, node->element, element) == 0) {
+			return true;
+		}
+		next = CACHE_ATOMIC_LOAD(&node->next);
+	}
+	return false;
+}
+
+/**
+ * removes element equal to given one from cell key of pool. Elements above it
+ * are popped and pushed back in the same order.
+ * @return the removed element, NULL if there is none
+ */
+static CacheElement cachePoolExtract(Cache cache, CacheElement element, int key) {
+	if (!cacheIsKeyCorrect(cache, key)) {
+		return NULL;
+	}
+	CachePool *pool = cache->pool;
+	CacheElement found = NULL;
+	uint32_t held = 0;
+	uint32_t index;
+	while (found == NULL && cachePoolStackPop(pool, pool->heads + key, &index)) {
+		CachePoolNode *node = cachePoolNode(pool, index);
+		if (cacheCompare(cache, node->element, element) == 0) {
+			found = node->element;
+			cachePoolStackPush(pool, &pool->freeHead, index);
+			CACHE_ATOMIC_ADD(&cache->elementsCount, -1);
+		} else {
+			// popped nodes are ours, linked through next until pushed back
+			CACHE_ATOMIC_STORE(&node->next, held);
+			held = index + 1;
+		}
+	}
+	while (held != 0) {
+		index = held - 1;
+		held = CACHE_ATOMIC_LOAD(&cachePoolNode(pool, index)->next);
+		cachePoolStackPush(pool, pool->heads + key, index);
+	}
+	return found;
+}
+
+/**
+ * fills iteration cell of pool with elements of cell key, sorted
+ * @return NULL on allocation failure
+ */
+static Set cachePoolMaterialize(Cache cache, int key) {
+	CachePool *pool = cache->pool;
+	cacheCellEmpty(cache, cache->iterationCell);
+	uint32_t next = (uint32_t)(CACHE_ATOMIC_LOAD(pool->heads + key) & CACHE_POOL_INDEX_MASK);
+	while (next != 0) {
+		CachePoolNode *node = cachePoolNode(pool, next - 1);
+		if (cacheCellAdd(cache, cache->iterationCell, node->element) == SET_OUT_OF_MEMORY) {
+			return NULL;
+		}
+		next = CACHE_ATOMIC_LOAD(&node->next);
+	}
+	return cache->iterationCell;
+}
+
+/** releases all elements of pool, not thread safe */
+static void cachePoolClear(Cache cache) {
+	// the iteration cell must not hold freed elements
+	cacheCellEmpty(cache, cache->iterationCell);
+	for (int key = 0; key < cache->cache_size; ++key) {
+		CacheElement element;
+		while ((element = cachePoolPop(cache, key)) != NULL) {
+			cache->freeElement(element);
+		}
+	}
+}
+
+/** releases pool with all its elements */
+static void cachePoolDestroy(Cache cache) {
+	CachePool *pool = cache->pool;
+	if (pool->heads != NULL) {
+		cachePoolClear(cache);
+	}
+	for (int chunk = 0; chunk < CACHE_POOL_CHUNKS; ++chunk) {
+		free(pool->chunks[chunk]);
+	}
+	pthread_mutex_destroy(&pool->chunksLock);
+	free(pool->heads);
+	free(pool);
+	cache->pool = NULL;
+}
+
+/**
+ * marks calling thread as a reader of concurrent cache, from the current
+ * epoch on. Readers start looking for a free slot at a place depending on
+ * their stack, so that each one tends to use its own slot. A reader which
+ * finds no free slot in one pass is counted as an overflow reader instead.
+ * @return slot of the reader, NULL for overflow reader
+ */
+static CacheReaderSlot *cacheReaderEnter(CacheConcurrent *concurrent) {
+	int marker;
+	uint64_t start = cacheMixHash((uint64_t)(uintptr_t)&marker >> CACHE_STACK_SHIFT);
+	for (uint64_t i = start; i < start + CACHE_READER_SLOTS; ++i) {
+		CacheReaderSlot *slot = concurrent->readers + (i & (CACHE_READER_SLOTS - 1));
+		uint64_t idle = 0;
+		if (CACHE_ATOMIC_LOAD(&slot->epoch) == 0 &&
+				CACHE_ATOMIC_CAS(&slot->epoch, &idle, CACHE_ATOMIC_LOAD(&concurrent->epoch))) {
+			return slot;
+		}
+	}
+	CACHE_ATOMIC_ADD(&concurrent->overflowReaders, 1);
+	return NULL;
+}
+
+/** ends lookup of reader */
+static void cacheReaderExit(CacheConcurrent *concurrent, CacheReaderSlot *slot) {
+	if (slot == NULL) {
+		CACHE_ATOMIC_ADD(&concurrent->overflowReaders, -1);
+	} else {
+		CACHE_ATOMIC_STORE(&slot->epoch, 0);
+	}
+}
+
+/**
+ * finds position of element in version, or where it would be inserted
+ * @return true if the element is there
+ */
+static bool cacheVersionFind(Cache cache, const CacheCellVersion *version,
+		CacheElement element, int *position) {
+	int low = 0, high = version == NULL ? 0 : version->size;
+	while (low < high) {
+		int middle = low + (high - low) / 2;
+		int comparison = cacheCompare(cache, version->elements[middle], element);
+		if (comparison == 0) {
+			*position = middle;
+			return true;
+		}
+		if (comparison < 0) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	*position = low;
+	return false;
+}
+
+/**
+ * creates copy of version with element inserted at position (if element is
+ * not NULL) or with element at position removed
+ * @return NULL on allocation failure or if the version becomes empty
+ */
+static CacheCellVersion *cacheVersionChange(const CacheCellVersion *version,
+		int position, CacheElement element, bool *failed) {
+	int oldSize = version == NULL ? 0 : version->size;
+	int size = element != NULL ? oldSize + 1 : oldSize - 1;
+	*failed = false;
+	if (size == 0) {
+		return NULL;
+	}
+	CacheCellVersion *changed = (CacheCellVersion*)malloc(
+			sizeof(*changed) + (size_t)size * sizeof(CacheElement));
+	if (changed == NULL) {
+		*failed = true;
+		return NULL;
+	}
+	changed->size = size;
+	int skip = element != NULL ? 0 : 1;
+	if (position > 0) {
+		memcpy(changed->elements, version->elements, (size_t)position * sizeof(CacheElement));
+	}
+	if (element != NULL) {
+		changed->elements[position] = element;
+	}
+	int rest = oldSize - position - skip;
+	if (rest > 0) {
+		memcpy(changed->elements + position + 1 - skip, version->elements + position + skip,
+				(size_t)rest * sizeof(CacheElement));
+	}
+	return changed;
+}
+
+/** releases version, with its elements if asked */
+static void cacheVersionRelease(Cache cache, CacheCellVersion *version,
+		bool releaseElements) {
+	if (releaseElements && version != NULL) {
+		for (int i = 0; i < version->size; ++i) {
+			cache->freeElement(version->elements[i]);
+		}
+	}
+	free(version);
+}
+
+/** releases retired version and elements retired with it */
+static void cacheRetiredRelease(Cache cache, CacheRetired *retired) {
+	cacheVersionRelease(cache, retired->version, retired->releaseElements);
+	if (retired->element != NULL) {
+		cache->freeElement(retired->element);
+	}
+	free(retired);
+}
+
+/** releases retired versions which no reader can see anymore */
+static void cacheConcurrentReclaim(Cache cache) {
+	CacheConcurrent *concurrent = cache->concurrent;
+	// epochs of overflow readers are not known, they may see anything
+	if (CACHE_ATOMIC_LOAD(&concurrent->overflowReaders) > 0) {
+		return;
+	}
+	uint64_t oldest = CACHE_ATOMIC_LOAD(&concurrent->epoch);
+	for (int i = 0; i < CACHE_READER_SLOTS; ++i) {
+		uint64_t epoch = CACHE_ATOMIC_LOAD(&concurrent->readers[i].epoch);
+		if (epoch != 0 && epoch < oldest) {
+			oldest = epoch;
+		}
+	}
+	// list is ordered by epoch, the latest first
+	CacheRetired **link = &concurrent->retired;
+	while (*link != NULL && (*link)->epoch >= oldest) {
+		link = &(*link)->next;
+	}
+	CacheRetired *released = *link;
+	*link = NULL;
+	while (released != NULL) {
+		CacheRetired *next = released->next;
+		cacheRetiredRelease(cache, released);
+		released = next;
+	}
+}
+
+/**
+ * replaces version of cell key by a new one, which may be NULL. The old
+ * version is retired together with element (if not NULL), or with all its
+ * elements.
+ * @return false on allocation failure, nothing is changed then
+ */
+static bool cacheConcurrentPublish(Cache cache, int key, CacheCellVersion *version,
+		CacheElement element, bool releaseElements) {
+	CacheConcurrent *concurrent = cache->concurrent;
+	CacheRetired *retired;
+	CACHE_ALLOCATE(CacheRetired, retired, false);
+	retired->version = concurrent->cells[key];
+	retired->element = element;
+	retired->releaseElements = releaseElements;
+	CACHE_ATOMIC_STORE(concurrent->cells + key, version);
+	retired->epoch = CACHE_ATOMIC_ADD(&concurrent->epoch, 1);
+	retired->next = concurrent->retired;
+	concurrent->retired = retired;
+	cacheConcurrentReclaim(cache);
+	return true;
+}
+
+/** adds copy of element to cell key of concurrent cache */
+static CacheResult cacheConcurrentPush(Cache cache, CacheElement element, int key) {
+	if (!cacheIsKeyCorrect(cache, key)) {
+		return CACHE_OUT_OF_RANGE;
+	}
+	CacheConcurrent *concurrent = cache->concurrent;
+	pthread_mutex_lock(&concurrent->writeLock);
+	CacheCellVersion *version = concurrent->cells[key];
+	int position;
+	CacheResult result = CACHE_SUCCESS;
+	CacheElement copy = NULL;
+	CacheCellVersion *changed = NULL;
+	bool failed = false;
+	if (cacheVersionFind(cache, version, element, &position)) {
+		result = CACHE_ITEM_ALREADY_EXISTS;
+	} else if ((copy = cache->copyElement(element)) == NULL ||
+			(changed = cacheVersionChange(version, position, copy, &failed)) == NULL ||
+			!cacheConcurrentPublish(cache, key, changed, NULL, false)) {
+		free(changed);
+		if (copy != NULL) {
+			cache->freeElement(copy);
+		}
+		result = CACHE_OUT_OF_MEMORY;
+	} else {
+		++cache->elementsCount;
+	}
+	pthread_mutex_unlock(&concurrent->writeLock);
+	return result;
+}
+
+/**
+ * removes element equal to given one (if element is not NULL) or the first
+ * element from cell key of concurrent cache. Readers may still compare with
+ * the element, so it is released later and a copy is returned if asked.
+ * @return result code, CACHE_OUT_OF_MEMORY also if copy failed
+ */
+static CacheResult cacheConcurrentRemove(Cache cache, CacheElement element, int key,
+		CacheElement *copy) {
+	if (!cacheIsKeyCorrect(cache, key)) {
+		return CACHE_ITEM_DOES_NOT_EXIST;
+	}
+	if (copy != NULL) {
+		*copy = NULL;
+	}
+	CacheConcurrent *concurrent = cache->concurrent;
+	pthread_mutex_lock(&concurrent->writeLock);
+	CacheCellVersion *version = concurrent->cells[key];
+	int position = 0;
+	bool found = element == NULL ? version != NULL :
+			cacheVersionFind(cache, version, element, &position);
+	CacheResult result = CACHE_SUCCESS;
+	if (!found) {
+		result = CACHE_ITEM_DOES_NOT_EXIST;
+	} else {
+		CacheElement removed = version->elements[position];
+		bool failed;
+		CacheCellVersion *changed = cacheVersionChange(version, position, NULL, &failed);
+		if (copy != NULL && !failed) {
+			*copy = cache->copyElement(removed);
+			failed = *copy == NULL;
+		}
+		if (failed || !cacheConcurrentPublish(cache, key, changed, removed, false)) {
+			if (copy != NULL && *copy != NULL) {
+				cache->freeElement(*copy);
+				*copy = NULL;
+			}
+			free(changed);
+			result = CACHE_OUT_OF_MEMORY;
+		} else {
+			--cache->elementsCount;
+		}
+	}
+	pthread_mutex_unlock(&concurrent->writeLock);
+	return result;
+}
+
+/** checks whether element is in cell key of concurrent cache, never blocks */
+static bool cacheConcurrentIsIn(Cache cache, CacheElement element, int key) {
+	if (!cacheIsKeyCorrect(cache, key)) {
+		return false;
+	}
+	CacheConcurrent *concurrent = cache->concurrent;
+	CacheReaderSlot *slot = cacheReaderEnter(concurrent);
+	int position;
+	bool found = cacheVersionFind(cache, CACHE_ATOMIC_LOAD(concurrent->cells + key),
+			element, &position);
+	cacheReaderExit(concurrent, slot);
+	return found;
+}
+
+/**
+ * fills iteration cell with elements of cell key of concurrent cache
+ * @return NULL on allocation failure
+ */
+static Set cacheConcurrentMaterialize(Cache cache, int key) {
+	CacheConcurrent *concurrent = cache->concurrent;
+	cacheCellEmpty(cache, cache->iterationCell);
+	pthread_mutex_lock(&concurrent->writeLock);
+	CacheCellVersion *version = concurrent->cells[key];
+	bool failed = false;
+	for (int i = 0; version != NULL && i < version->size && !failed; ++i) {
+		failed = cacheCellAdd(cache, cache->iterationCell, version->elements[i]) ==
+				SET_OUT_OF_MEMORY;
+	}
+	pthread_mutex_unlock(&concurrent->writeLock);
+	return failed ? NULL : cache->iterationCell;
+}
+
+/** removes all elements of concurrent cache */
+static CacheResult cacheConcurrentClear(Cache cache) {
+	CacheConcurrent *concurrent = cache->concurrent;
+	CacheResult result = CACHE_SUCCESS;
+	cacheCellEmpty(cache, cache->iterationCell);
+	pthread_mutex_lock(&concurrent->writeLock);
+	for (int key = 0; key < cache->cache_size && result == CACHE_SUCCESS; ++key) {
+		CacheCellVersion *version = concurrent->cells[key];
+		if (version == NULL) {
+			continue;
+		}
+		// with no readers the version is released right away
+		int size = version->size;
+		if (cacheConcurrentPublish(cache, key, NULL, NULL, true)) {
+			cache->elementsCount -= size;
+		} else {
+			result = CACHE_OUT_OF_MEMORY;
+		}
+	}
+	pthread_mutex_unlock(&concurrent->writeLock);
+	return result;
+}
+
+/** releases concurrent storage with all elements, no reader may be left */
+static void cacheConcurrentDestroy(Cache cache) {
+	CacheConcurrent *concurrent = cache->concurrent;
+	cacheCellEmpty(cache, cache->iterationCell);
+	while (concurrent->retired != NULL) {
+		CacheRetired *next = concurrent->retired->next;
+		cacheRetiredRelease(cache, concurrent->retired);
+		concurrent->retired = next;
+	}
+	for (int key = 0; concurrent->cells != NULL && key < cache->cache_size; ++key) {
+		cacheVersionRelease(cache, concurrent->cells[key], true);
+	}
+	pthread_mutex_destroy(&concurrent->writeLock);
+	free(concurrent->cells);
+	free(concurrent);
+	cache->concurrent = NULL;
+}
+
+/** allocates cache structure with empty container */
+static Cache cacheAllocate(
+    int size,
+    FreeCacheElement free_element,
+    CopyCacheElement copy_element,
+    CompareCacheElements compare_elements) {
+	//memory allocation
+	Cache cache;
+	CACHE_ALLOCATE(cache_t, cache, NULL);
+
+	//initialization
+	cache->freeElement = free_element;
+	cache->copyElement = copy_element;
+	cache->compareElements = compare_elements;
+	cache->computeKey = NULL;
+	cache->hashElement = NULL;
+	cache->mixHash = false;
+	cache->cache_size = size;
+	cache->iteratorIndex = CACHE_INVALID_ITERATOR_INDEX;
+	cache->elementsCount = 0;
+	cache->minimal_size = size;
+	cache->oldContainer = NULL;
+	cache->old_size = 0;
+	cache->migrateIndex = 0;
+	cache->bloomHash = NULL;
+	cache->bloomCounters = NULL;
+	cache->bloomMask = 0;
+	cache->capacity = CACHE_UNBOUNDED;
+	cache->sketchHash = NULL;
+	cache->sketchCounters = NULL;
+	cache->sketchMask = 0;
+	cache->sketchAdditions = 0;
+	cache->sketchSampleSize = 0;
+	cache->evictionListener = NULL;
+	cache->evictionContext = NULL;
+	cache->sizeElement = NULL;
+	cache->cellBytes = NULL;
+	cache->oldCellBytes = NULL;
+	cache->elementBytes = 0;
+	cache->budget = NULL;
+	cache->budgetPolicy = CACHE_BUDGET_REJECT;
+	cache->pool = NULL;
+	cache->concurrent = NULL;
+	cache->iterationCell = NULL;
+	cache->timers = NULL;
+	cache->clock = NULL;
+	cache->now = 0;
+	cache->restore = NULL;
+	cache->restoreResult = CACHE_SUCCESS;
+#ifdef CACHE_STATS
+	memset(&cache->stats, 0, sizeof(cache->stats));
+	cache->probeLength = 0;
+#endif
+	cache->container = (Set*)calloc(size, sizeof(*cache->container));
+	if (cache->container == NULL) {
+		free(cache);
+		return NULL;
+	}
+	return cache;
+}
+
+/**
+ * creates cache with special size
+ */
+Cache cacheCreate(
+    int size,
+    FreeCacheElement free_element,
+    CopyCacheElement copy_element,
+    CompareCacheElements compare_elements,
+    ComputeCacheKey compute_key) {
+	if (size <= 0 || !free_element || !copy_element || !compare_elements || !compute_key) {
+		return NULL;
+	}
+	Cache cache = cacheAllocate(size, free_element, copy_element, compare_elements);
+	if (cache == NULL) {
+		return NULL;
+	}
+	cache->computeKey = compute_key;
+	CACHE_CONTAINER_FOREACH(i, cache) {
+		cache->container[i] = cacheCellCreate(cache);
+		if (cache->container[i] == NULL) {
+			cacheDestroy(cache);
+			return NULL;
+		}
+	}
+	return cache;
+}
+
+Cache cacheCreatePool(
+    int size,
+    FreeCacheElement free_element,
+    CopyCacheElement copy_element,
+    CompareCacheElements compare_elements,
+    ComputeCacheKey compute_key) {
+	if (size <= 0 || !free_element || !copy_element || !compare_elements || !compute_key) {
+		return NULL;
+	}
+	Cache cache = cacheAllocate(size, free_element, copy_element, compare_elements);
+	if (cache == NULL) {
+		return NULL;
+	}
+	cache->computeKey = compute_key;
+	CachePool *pool = (CachePool*)calloc(1, sizeof(*pool));
+	if (pool == NULL) {
+		cacheDestroy(cache);
+		return NULL;
+	}
+	if (pthread_mutex_init(&pool->chunksLock, NULL) != 0) {
+		free(pool);
+		cacheDestroy(cache);
+		return NULL;
+	}
+	cache->pool = pool;
+	pool->heads = (uint64_t*)calloc(size, sizeof(*pool->heads));
+	cache->iterationCell = cacheCellCreate(cache);
+	if (pool->heads == NULL || cache->iterationCell == NULL) {
+		cacheDestroy(cache);
+		return NULL;
+	}
+	return cache;
+}
+
+Cache cacheCreateConcurrent(
+    int size,
+    FreeCacheElement free_element,
+    CopyCacheElement copy_element,
+    CompareCacheElements compare_elements,
+    ComputeCacheKey compute_key) {
+	if (size <= 0 || !free_element || !copy_element || !compare_elements || !compute_key) {
+		return NULL;
+	}
+	Cache cache = cacheAllocate(size, free_element, copy_element, compare_elements);
+	if (cache == NULL) {
+		return NULL;
+	}
+	cache->computeKey = compute_key;
+	CacheConcurrent *concurrent = (CacheConcurrent*)calloc(1, sizeof(*concurrent));
+	if (concurrent == NULL) {
+		cacheDestroy(cache);
+		return NULL;
+	}
+	if (pthread_mutex_init(&concurrent->writeLock, NULL) != 0) {
+		free(concurrent);
+		cacheDestroy(cache);
+		return NULL;
+	}
+	// readers mark themselves with epoch, 0 means no reader
+	concurrent->epoch = 1;
+	cache->concurrent = concurrent;
+	concurrent->cells = (CacheCellVersion**)calloc(size, sizeof(*concurrent->cells));
+	cache->iterationCell = cacheCellCreate(cache);
+	if (concurrent->cells == NULL || cache->iterationCell == NULL) {
+		cacheDestroy(cache);
+		return NULL;
+	}
+	return cache;
+}
+
+/** creates cache whose cells are chosen by hash bits, with lazily created cells */
+static Cache cacheCreateByHash(
+    int initial_size,
+    FreeCacheElement free_element,
+    CopyCacheElement copy_element,
+    CompareCacheElements compare_elements,
+    HashCacheElement hash_element,
+    bool mix_hash) {
+	if (initial_size <= 0 || !free_element || !copy_element || !compare_elements || !hash_element) {
+		return NULL;
+	}
+	// cells are chosen by hash bits, so size is a power of two
+	int size = 1;
+	while (size < initial_size) {
+		if (size > INT_MAX / 2) {
+			return NULL;
+		}
+		size *= 2;
+	}
+	Cache cache = cacheAllocate(size, free_element, copy_element, compare_elements);
+	if (cache == NULL) {
+		return NULL;
+	}
+	cache->hashElement = hash_element;
+	cache->mixHash = mix_hash;
+	return cache;
+}
+
+Cache cacheCreateResizable(
+    int initial_size,
+    FreeCacheElement free_element,
+    CopyCacheElement copy_element,
+    CompareCacheElements compare_elements,
+    HashCacheElement hash_element) {
+	return cacheCreateByHash(initial_size, free_element, copy_element, compare_elements,
+			hash_element, false);
+}
+
+Cache cacheCreateHashed(
+    int size,
+    FreeCacheElement free_element,
+    CopyCacheElement copy_element,
+    CompareCacheElements compare_elements,
+    HashCacheElement hash_element) {
+	return cacheCreateByHash(size, free_element, copy_element, compare_elements,
+			hash_element, true);
+}
+
+/**
+ * adds element with known code to cache
+ * @param pushed - if not NULL, receives copy of element stored in cache
+ */
+static CacheResult cachePushByCode(Cache cache, CacheElement element, uint64_t code,
+		CacheElement *pushed) {
+	assert(cache != NULL && element != NULL);
+	CACHE_STATS_COUNT(cache, pushes);
+	if (cacheIsPool(cache)) {
+		assert(pushed == NULL);
+		return cachePoolPush(cache, element, (int)(int64_t)code);
+	}
+	if (cacheIsConcurrent(cache)) {
+		assert(pushed == NULL);
+		return cacheConcurrentPush(cache, element, (int)(int64_t)code);
+	}
+	cacheResizeStep(cache);
+
+	Set *slot = cacheFindSlotByCode(cache, code);
+	if (slot == NULL) {
+		return CACHE_OUT_OF_RANGE;
+	}
+	cacheSketchRecord(cache, element);
+
+	CACHE_STATS_LOOKUP_BEGIN(cache);
+	bool exists = *slot != NULL && cacheBloomMayContain(cache, element) &&
+			cacheCellIsIn(cache, *slot, element);
+	CACHE_STATS_LOOKUP_END(cache);
+	if (exists) {
+		return CACHE_ITEM_ALREADY_EXISTS;
+	}
+	if (cacheIsFull(cache)) {
+		CacheResult evictResult = cacheEvictFor(cache, element, code);
+		if (evictResult != CACHE_SUCCESS) {
+			return evictResult;
+		}
+		// eviction may have started resize
+		slot = cacheFindSlotByCode(cache, code);
+	}
+	long bytes = 0;
+	if (cache->budget != NULL) {
+		bytes = cacheElementBytes(cache, element);
+		CacheResult budgetResult = cacheBudgetMakeRoom(cache, element, code, bytes);
+		if (budgetResult != CACHE_SUCCESS) {
+			return budgetResult;
+		}
+		slot = cacheFindSlotByCode(cache, code);
+	}
+
+	Set cell = cacheSlotGetCell(cache, slot, true);
+	CacheElement copy = cell == NULL ? NULL : cache->copyElement(element);
+	if (copy == NULL) {
+		cacheBudgetRelease(cache, bytes);
+		return CACHE_OUT_OF_MEMORY;
+	}
+	SetResult setAddResult = cacheCellAdd(cache, cell, copy);
+	if (setAddResult == SET_OUT_OF_MEMORY) {
+		cache->freeElement(copy);
+		cacheBudgetRelease(cache, bytes);
+		return CACHE_OUT_OF_MEMORY;
+	}
+	assert(setAddResult == SET_SUCCESS);
+	cacheElementAdded(cache, copy);
+	if (pushed != NULL) {
+		*pushed = copy;
+	}
+
+	return CACHE_SUCCESS;
+}
+
+/**
+ * adds element restored from snapshot to cache and releases it. Elements
+ * already in cache, or rejected by admission filter, are not an error.
+ */
+static CacheResult cacheAddRestored(Cache cache, CacheElement element) {
+	CacheResult result = cachePushByCode(cache, element,
+			cacheElementCode(cache, element), NULL);
+	cache->freeElement(element);
+	return result == CACHE_ITEM_ALREADY_EXISTS || result == CACHE_ITEM_REJECTED ?
+			CACHE_SUCCESS : result;
+}
+
+/**
+ * moves up to limit decoded elements from restore queue to cache
+ * @return number of elements moved
+ */
+static int cacheRestoreDrain(Cache cache, int limit) {
+	CacheRestore *restore = cache->restore;
+	CacheElement elements[CACHE_RESTORE_STEP];
+	if (limit > CACHE_RESTORE_STEP) {
+		limit = CACHE_RESTORE_STEP;
+	}
+	pthread_mutex_lock(&restore->lock);
+	int taken = 0;
+	while (taken < limit && restore->queueCount > 0) {
+		elements[taken++] = restore->queue[restore->queueHead];
+		restore->queueHead = (restore->queueHead + 1) % CACHE_RESTORE_QUEUE_SIZE;
+		--restore->queueCount;
+	}
+	pthread_cond_broadcast(&restore->changed);
+	pthread_mutex_unlock(&restore->lock);
+	for (int i = 0; i < taken; ++i) {
+		CacheResult result = cacheAddRestored(cache, elements[i]);
+		if (result != CACHE_SUCCESS && restore->pushResult == CACHE_SUCCESS) {
+			restore->pushResult = result;
+		}
+	}
+	return taken;
+}
+
+/**
+ * stops restore thread (early if cancel is true) and releases restore
+ * @return result of the restore
+ */
+static CacheResult cacheRestoreFinish(Cache cache, bool cancel) {
+	CacheRestore *restore = cache->restore;
+	pthread_mutex_lock(&restore->lock);
+	restore->cancelled = cancel;
+	pthread_cond_broadcast(&restore->changed);
+	while (!cancel && !(restore->done && restore->queueCount == 0)) {
+		if (restore->queueCount == 0) {
+			pthread_cond_wait(&restore->changed, &restore->lock);
+			continue;
+		}
+		pthread_mutex_unlock(&restore->lock);
+		cacheRestoreDrain(cache, CACHE_RESTORE_STEP);
+		pthread_mutex_lock(&restore->lock);
+	}
+	pthread_mutex_unlock(&restore->lock);
+	pthread_join(restore->thread, NULL);
+	// thread is gone, elements left (if cancelled) are released without lock
+	for (; restore->queueCount > 0; --restore->queueCount) {
+		restore->freeElement(restore->queue[restore->queueHead]);
+		restore->queueHead = (restore->queueHead + 1) % CACHE_RESTORE_QUEUE_SIZE;
+	}
+	CacheResult result = restore->readResult != CACHE_SUCCESS ?
+			restore->readResult : restore->pushResult;
+	fclose(restore->file);
+	pthread_cond_destroy(&restore->changed);
+	pthread_mutex_destroy(&restore->lock);
+	free(restore);
+	cache->restore = NULL;
+	return result;
+}
+
+/**
+ * moves a few restored elements to cache, completes the restore once
+ * everything was read and moved
+ */
+static void cacheRestoreStep(Cache cache) {
+	if (cache->restore == NULL) {
+		return;
+	}
+	if (cacheRestoreDrain(cache, CACHE_RESTORE_STEP) > 0) {
+		return;
+	}
+	pthread_mutex_lock(&cache->restore->lock);
+	bool finished = cache->restore->done && cache->restore->queueCount == 0;
+	pthread_mutex_unlock(&cache->restore->lock);
+	if (finished) {
+		cache->restoreResult = cacheRestoreFinish(cache, false);
+	}
+}
+
+CacheResult cachePush(Cache cache, CacheElement element) {
+	if (cache == NULL || element == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	cacheExpireLazily(cache);
+	cacheRestoreStep(cache);
+	return cachePushByCode(cache, element, cacheElementCode(cache, element), NULL);
+}
+
+CacheResult cachePushWithTTL(Cache cache, CacheElement element, uint64_t ttl) {
+	if (cache == NULL || element == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	if (ttl == 0) {
+		return CACHE_OUT_OF_RANGE;
+	}
+	if (cacheIsShared(cache)) {
+		return CACHE_NOT_SUPPORTED;
+	}
+	cacheExpireLazily(cache);
+	cacheRestoreStep(cache);
+	// everything the timer needs is allocated before element is pushed
+	CacheTimer *timer;
+	CACHE_ALLOCATE(CacheTimer, timer, CACHE_OUT_OF_MEMORY);
+	if (!cacheTimerWheelEnsure(cache) || !cacheTimerIndexReserve(cache->timers)) {
+		free(timer);
+		return CACHE_OUT_OF_MEMORY;
+	}
+	CacheResult result = cachePushByCode(cache, element,
+			cacheElementCode(cache, element), &timer->element);
+	if (result != CACHE_SUCCESS) {
+		free(timer);
+		return result;
+	}
+	CacheTimerWheel *wheel = cache->timers;
+	timer->expiry = cache->now + ttl < cache->now ? UINT64_MAX : cache->now + ttl;
+	cacheTimerLink(wheel, timer);
+	wheel->index[cacheTimerIndexFind(wheel, timer->element)] = timer;
+	++wheel->count;
+	return CACHE_SUCCESS;
+}
+
+CacheResult cacheExpire(Cache cache, uint64_t now) {
+	if (cache == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	cacheExpireUntil(cache, now);
+	return CACHE_SUCCESS;
+}
+
+CacheResult cacheSetClock(Cache cache, CacheClock clock) {
+	if (cache == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	if (cacheIsShared(cache)) {
+		return CACHE_NOT_SUPPORTED;
+	}
+	cache->clock = clock;
+	return CACHE_SUCCESS;
+}
+
+CacheResult cacheFreeElement(Cache cache, CacheElement element) {
+	if (cache == NULL || element == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	cacheExpireLazily(cache);
+	cacheRestoreStep(cache);
+	CACHE_STATS_COUNT(cache, frees);
+	if (cacheIsPool(cache)) {
+		CacheElement removed = cachePoolExtract(cache, element, cache->computeKey(element));
+		if (removed == NULL) {
+			return CACHE_ITEM_DOES_NOT_EXIST;
+		}
+		cache->freeElement(removed);
+		return CACHE_SUCCESS;
+	}
+	if (cacheIsConcurrent(cache)) {
+		return cacheConcurrentRemove(cache, element, cache->computeKey(element), NULL);
+	}
+	cacheResizeStep(cache);
+
+	Set *slot = cacheFindSlot(cache, element);
+	if (slot == NULL || *slot == NULL || !cacheBloomMayContain(cache, element)) {
+		return CACHE_ITEM_DOES_NOT_EXIST;
+	}
+	CACHE_STATS_LOOKUP_BEGIN(cache);
+	CacheElement removed = cacheCellExtract(cache, *slot, element);
+	CACHE_STATS_LOOKUP_END(cache);
+	if (removed == NULL) {
+		return CACHE_ITEM_DOES_NOT_EXIST;
+	}
+	cacheElementRemoved(cache, removed);
+	cache->freeElement(removed);
+	return CACHE_SUCCESS;
+}
+
+/**
+ * finds element of old container that belongs to cell key of new container
+ * @return NULL if there is no such element
+ */
+static CacheElement cacheFindMigratingElement(Cache cache, int key) {
+	assert(cacheIsMigrating(cache));
+	for (int oldIndex = key & (cache->old_size - 1);
+			oldIndex < cache->old_size;
+			oldIndex += cache->cache_size) {
+		Set oldCell = cache->oldContainer[oldIndex];
+		if (oldIndex < cache->migrateIndex || oldCell == NULL) {
+			continue;
+		}
+		SET_FOREACH(CacheElement, element, oldCell) {
+			uint64_t hash = cacheElementCode(cache, element);
+			if ((int)(hash & (uint64_t)(cache->cache_size - 1)) == key) {
+				return cacheCellExtract(cache, oldCell, element);
+			}
+		}
+	}
+	return NULL;
+}
+
+/** removes an element of cell key from cache */
+static CacheElement cacheExtractFromCell(Cache cache, int key) {
+	assert(cache != NULL);
+	CACHE_STATS_COUNT(cache, extracts);
+	cacheResizeStep(cache);
+
+	if (!cacheIsKeyCorrect(cache, key)) {
+		return NULL;
+	}
+	if (cacheIsPool(cache)) {
+		return cachePoolPop(cache, key);
+	}
+	if (cacheIsConcurrent(cache)) {
+		CacheElement copy;
+		cacheConcurrentRemove(cache, NULL, key, &copy);
+		return copy;
+	}
+
+	CacheElement result = NULL;
+	Set cell = cache->container[key];
+	if (cell != NULL && setGetSize(cell) > 0) {
+		result = cacheCellExtract(cache, cell, setGetFirst(cell));
+	} else if (cacheIsMigrating(cache)) {
+		result = cacheFindMigratingElement(cache, key);
+	}
+	if (result == NULL) {
+		return NULL;
+	}
+	cacheElementRemoved(cache, result);
+	return result;
+}
+
+CacheElement cacheExtractElementByKey(Cache cache, int key){
+	if (cache == NULL) {
+		return NULL;
+	}
+	cacheExpireLazily(cache);
+	cacheRestoreStep(cache);
+	return cacheExtractFromCell(cache, key);
+}
+
+int cacheExtractBatch(Cache cache, int key, int n, CacheElement *out) {
+	if (cache == NULL || out == NULL || n < 0) {
+		return -1;
+	}
+	cacheExpireLazily(cache);
+	cacheRestoreStep(cache);
+	int extracted = 0;
+	while (extracted < n && (out[extracted] = cacheExtractFromCell(cache, key)) != NULL) {
+		++extracted;
+	}
+	return extracted;
+}
+
+/** checks whether element with known code is in cache */
+static bool cacheIsInByCode(Cache cache, CacheElement element, uint64_t code) {
+	assert(cache != NULL && element != NULL);
+	CACHE_STATS_COUNT(cache, isIns);
+	cacheResizeStep(cache);
+	Set *slot = cacheFindSlotByCode(cache, code);
+	cacheSketchRecord(cache, element);
+	bool found = false;
+	if (cacheIsPool(cache)) {
+		CACHE_STATS_LOOKUP_BEGIN(cache);
+		found = cachePoolIsIn(cache, element, (int)(int64_t)code);
+		CACHE_STATS_LOOKUP_END(cache);
+	} else if (cacheIsConcurrent(cache)) {
+		CACHE_STATS_LOOKUP_BEGIN(cache);
+		found = cacheConcurrentIsIn(cache, element, (int)(int64_t)code);
+		CACHE_STATS_LOOKUP_END(cache);
+	} else if (slot != NULL && *slot != NULL && cacheBloomMayContain(cache, element)) {
+		CACHE_STATS_LOOKUP_BEGIN(cache);
+		found = cacheCellIsIn(cache, *slot, element);
+		CACHE_STATS_LOOKUP_END(cache);
+	}
+	if (found) {
+		CACHE_STATS_COUNT(cache, hits);
+	} else {
+		CACHE_STATS_COUNT(cache, misses);
+	}
+	return found;
+}
+
+bool cacheIsIn(Cache cache, CacheElement element) {
+	if (cache == NULL || element == NULL) {
+		// null argument
+		return false;
+	}
+	cacheExpireLazily(cache);
+	cacheRestoreStep(cache);
+	return cacheIsInByCode(cache, element, cacheElementCode(cache, element));
+}
+
+/** element of batch together with location of its cell */
+typedef struct CacheBatchEntry_t {
+	uintptr_t cell;
+	uint64_t code;
+	int index;
+} CacheBatchEntry;
+
+/** orders batch entries by cell, and by position in batch inside cell */
+static int cacheBatchEntryCompare(const void *entry1, const void *entry2) {
+	const CacheBatchEntry *first = entry1, *second = entry2;
+	if (first->cell != second->cell) {
+		return first->cell < second->cell ? -1 : 1;
+	}
+	return first->index - second->index;
+}
+
+/**
+ * computes codes of batch elements once and groups them by cell, keeping
+ * order of elements inside every cell
+ * @return NULL on allocation failure, sorted entries otherwise
+ */
+static CacheBatchEntry *cacheBatchPrepare(Cache cache, CacheElement *elements, int n) {
+	CacheBatchEntry *entries = (CacheBatchEntry*)malloc(sizeof(*entries) * n);
+	if (entries == NULL) {
+		return NULL;
+	}
+	for (int i = 0; i < n; ++i) {
+		entries[i].index = i;
+		entries[i].code = elements[i] == NULL ? 0 : cacheElementCode(cache, elements[i]);
+		entries[i].cell = elements[i] == NULL ? 0 :
+				(uintptr_t)cacheFindSlotByCode(cache, entries[i].code);
+	}
+	qsort(entries, n, sizeof(*entries), cacheBatchEntryCompare);
+	return entries;
+}
+
+/** prefetches cell of i-th batch entry, if there is one */
+static void cacheBatchPrefetch(Cache cache, CacheBatchEntry *entries, int i, int n) {
+	if (i >= n || entries[i].cell == 0) {
+		return;
+	}
+	Set *slot = cacheFindSlotByCode(cache, entries[i].code);
+	if (slot != NULL && *slot != NULL) {
+		CACHE_PREFETCH(*slot);
+	}
+}
+
+CacheResult cachePushBatch(Cache cache, CacheElement *elements, int n,
+		CacheResult *results) {
+	if (cache == NULL || elements == NULL || results == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	if (n < 0) {
+		return CACHE_OUT_OF_RANGE;
+	}
+	cacheExpireLazily(cache);
+	cacheRestoreStep(cache);
+	// without memory for grouping, elements are processed in given order
+	CacheBatchEntry *entries = cacheBatchPrepare(cache, elements, n);
+	for (int i = 0; i < n; ++i) {
+		int index = entries != NULL ? entries[i].index : i;
+		if (elements[index] == NULL) {
+			results[index] = CACHE_NULL_ARGUMENT;
+			continue;
+		}
+		if (entries != NULL) {
+			cacheBatchPrefetch(cache, entries, i + CACHE_BATCH_PREFETCH_DISTANCE, n);
+		}
+		uint64_t code = entries != NULL ? entries[i].code :
+				cacheElementCode(cache, elements[index]);
+		results[index] = cachePushByCode(cache, elements[index], code, NULL);
+	}
+	free(entries);
+	return CACHE_SUCCESS;
+}
+
+CacheResult cacheIsInBatch(Cache cache, CacheElement *elements, int n, bool *results) {
+	if (cache == NULL || elements == NULL || results == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	if (n < 0) {
+		return CACHE_OUT_OF_RANGE;
+	}
+	cacheExpireLazily(cache);
+	cacheRestoreStep(cache);
+	CacheBatchEntry *entries = cacheBatchPrepare(cache, elements, n);
+	for (int i = 0; i < n; ++i) {
+		int index = entries != NULL ? entries[i].index : i;
+		if (elements[index] == NULL) {
+			results[index] = false;
+			continue;
+		}
+		if (entries != NULL) {
+			cacheBatchPrefetch(cache, entries, i + CACHE_BATCH_PREFETCH_DISTANCE, n);
+		}
+		uint64_t code = entries != NULL ? entries[i].code :
+				cacheElementCode(cache, elements[index]);
+		results[index] = cacheIsInByCode(cache, elements[index], code);
+	}
+	free(entries);
+	return CACHE_SUCCESS;
+}
+
+/** Lookup of cacheIsInProbes in flight, advanced one stage at a time */
+typedef struct CacheProbe_t {
+	/** index of probed element, -1 if the probe is idle */
+	int index;
+	int stage;
+	uint64_t code;
+} CacheProbe;
+
+/** stages of a probe, each one loads what the previous one prefetched */
+enum {
+	CACHE_PROBE_CELL_REFERENCE,
+	CACHE_PROBE_CELL,
+	CACHE_PROBE_FIRST_ELEMENT,
+	CACHE_PROBE_COMPARE
+};
+
+/**
+ * returns address holding reference to cell of code, NULL if code is out of
+ * range. It is recomputed every stage, as lookups of other probes may move
+ * cells of a resizable cache.
+ */
+static const void *cacheProbeCellReference(Cache cache, uint64_t code) {
+	if (!cacheIsShared(cache)) {
+		return cacheFindSlotByCode(cache, code);
+	}
+	int key = (int)(int64_t)code;
+	if (!cacheIsKeyCorrect(cache, key)) {
+		return NULL;
+	}
+	return cacheIsPool(cache) ? (const void*)(cache->pool->heads + key) :
+			(const void*)(cache->concurrent->cells + key);
+}
+
+/**
+ * advances probe by one stage, prefetching what the next stage reads.
+ * Elements of a set cell are hidden by the set, so its lookup goes on right
+ * after the set itself was prefetched. Versions of a concurrent cache must be
+ * read by a registered reader.
+ * @return true if the probe is done and its result is set
+ */
+static bool cacheProbeAdvance(Cache cache, CacheProbe *probe, CacheElement *elements,
+		bool *results) {
+	CacheElement element = elements[probe->index];
+	const void *reference = probe->stage == CACHE_PROBE_CELL_REFERENCE ? NULL :
+			cacheProbeCellReference(cache, probe->code);
+	switch (probe->stage++) {
+	case CACHE_PROBE_CELL_REFERENCE:
+		if (element == NULL) {
+			results[probe->index] = false;
+			return true;
+		}
+		probe->code = cacheElementCode(cache, element);
+		CACHE_PREFETCH(cacheProbeCellReference(cache, probe->code));
+		return false;
+	case CACHE_PROBE_CELL:
+		if (cacheIsPool(cache)) {
+			uint32_t top = reference == NULL ? 0 : (uint32_t)(CACHE_ATOMIC_LOAD(
+					(uint64_t*)reference) & CACHE_POOL_INDEX_MASK);
+			if (top != 0) {
+				CACHE_PREFETCH(cachePoolNode(cache->pool, top - 1));
+			}
+		} else if (cacheIsConcurrent(cache)) {
+			if (reference != NULL) {
+				CACHE_PREFETCH(CACHE_ATOMIC_LOAD((CacheCellVersion**)reference));
+			}
+		} else {
+			if (reference != NULL && *(const Set*)reference != NULL) {
+				CACHE_PREFETCH(*(const Set*)reference);
+			}
+			probe->stage = CACHE_PROBE_COMPARE;
+		}
+		return false;
+	case CACHE_PROBE_FIRST_ELEMENT:
+		if (cacheIsPool(cache)) {
+			uint32_t top = reference == NULL ? 0 : (uint32_t)(CACHE_ATOMIC_LOAD(
+					(uint64_t*)reference) & CACHE_POOL_INDEX_MASK);
+			if (top != 0) {
+				CACHE_PREFETCH(cachePoolNode(cache->pool, top - 1)->element);
+			}
+		} else if (cacheIsConcurrent(cache) && reference != NULL) {
+			const CacheCellVersion *version =
+					CACHE_ATOMIC_LOAD((CacheCellVersion**)reference);
+			if (version != NULL) {
+				// the element binary search compares first
+				CACHE_PREFETCH(version->elements[version->size / 2]);
+			}
+		}
+		return false;
+	default:
+		results[probe->index] = cacheIsInByCode(cache, element, probe->code);
+		return true;
+	}
+}
+
+CacheResult cacheIsInProbes(Cache cache, CacheElement *elements, int n, bool *results) {
+	if (cache == NULL || elements == NULL || results == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	if (n < 0) {
+		return CACHE_OUT_OF_RANGE;
+	}
+	cacheExpireLazily(cache);
+	cacheRestoreStep(cache);
+	// keeps versions read between stages from being reclaimed
+	bool reading = cacheIsConcurrent(cache);
+	CacheReaderSlot *reader = reading ? cacheReaderEnter(cache->concurrent) : NULL;
+	CacheProbe probes[CACHE_PROBE_WINDOW];
+	for (int i = 0; i < CACHE_PROBE_WINDOW; ++i) {
+		probes[i].index = -1;
+	}
+	int next = 0, active = 0;
+	while (next < n || active > 0) {
+		for (int i = 0; i < CACHE_PROBE_WINDOW; ++i) {
+			if (probes[i].index < 0) {
+				if (next >= n) {
+					continue;
+				}
+				probes[i].index = next++;
+				probes[i].stage = CACHE_PROBE_CELL_REFERENCE;
+				++active;
+			}
+			if (cacheProbeAdvance(cache, probes + i, elements, results)) {
+				probes[i].index = -1;
+				--active;
+			}
+		}
+	}
+	if (reading) {
+		cacheReaderExit(cache->concurrent, reader);
+	}
+	return CACHE_SUCCESS;
+}
+
+int cacheGetSize(Cache cache) {
+	if (cache == NULL) {
+		return -1;
+	}
+	return cache->cache_size;
+}
+
+/** returns cell for iteration, which always exists */
+static Set cacheGetIteratorCell(Cache cache) {
+	assert(cacheIsKeyCorrect(cache, cache->iteratorIndex));
+	if (cacheIsShared(cache)) {
+		return cache->iterationCell;
+	}
+	return cacheSlotGetCell(cache, cache->container + cache->iteratorIndex, true);
+}
+
+/**
+ * moves iteration to cell, cell of pool or concurrent cache is copied when
+ * iteration reaches it
+ */
+static Set cacheIteratorMoveTo(Cache cache, int index) {
+	cache->iteratorIndex = index;
+	bool failed = (cacheIsPool(cache) && cachePoolMaterialize(cache, index) == NULL) ||
+			(cacheIsConcurrent(cache) && cacheConcurrentMaterialize(cache, index) == NULL);
+	if (failed) {
+		cache->iteratorIndex = CACHE_INVALID_ITERATOR_INDEX;
+		return NULL;
+	}
+	return cacheGetIteratorCell(cache);
+}
+
+Set cacheGetFirst(Cache cache) {
+	if (cache == NULL) {
+		return NULL;
+	}
+	cacheExpireLazily(cache);
+	cacheRestoreStep(cache);
+	// iteration goes over single container
+	if (!cacheResizeFinish(cache)) {
+		cache->iteratorIndex = CACHE_INVALID_ITERATOR_INDEX;
+		return NULL;
+	}
+	return cacheIteratorMoveTo(cache, 0);
+}
+
+Set cacheGetNext(Cache cache) {
+	if (cache == NULL ||
+			cache->iteratorIndex == CACHE_INVALID_ITERATOR_INDEX) {
+		return NULL;
+	}
+
+	if (cache->iteratorIndex + 1 == cache->cache_size) {
+		cache->iteratorIndex = CACHE_INVALID_ITERATOR_INDEX;
+		return NULL;
+	}
+	return cacheIteratorMoveTo(cache, cache->iteratorIndex + 1);
+}
+
+Set cacheGetCurrent(Cache cache) {
+	if (cache == NULL || cache->iteratorIndex == CACHE_INVALID_ITERATOR_INDEX){
+		return NULL;
+	}
+	return cacheGetIteratorCell(cache);
+}
+
+/** prepares cache for read only traversal of its current container */
+static CacheResult cacheTraversalBegin(Cache cache) {
+	if (cacheIsShared(cache)) {
+		return CACHE_NOT_SUPPORTED;
+	}
+	cacheExpireLazily(cache);
+	cacheRestoreStep(cache);
+	return cacheResizeFinish(cache) ? CACHE_SUCCESS : CACHE_OUT_OF_MEMORY;
+}
+
+CacheResult cacheCursorInit(Cache cache, CacheCursor *cursor) {
+	if (cache == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	return cacheCursorInitRange(cache, cursor, 0, cache->cache_size);
+}
+
+CacheResult cacheCursorInitRange(Cache cache, CacheCursor *cursor, int begin, int end) {
+	if (cache == NULL || cursor == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	CacheResult result = cacheTraversalBegin(cache);
+	if (result != CACHE_SUCCESS) {
+		return result;
+	}
+	if (begin < 0 || begin > end || end > cache->cache_size) {
+		return CACHE_OUT_OF_RANGE;
+	}
+	cursor->cache = cache;
+	cursor->index = begin;
+	cursor->end = end;
+	return CACHE_SUCCESS;
+}
+
+Set cacheCursorNext(CacheCursor *cursor) {
+	if (cursor == NULL) {
+		return NULL;
+	}
+	while (cursor->index < cursor->end) {
+		Set cell = cursor->cache->container[cursor->index++];
+		if (cell != NULL && setGetSize(cell) > 0) {
+			return cell;
+		}
+	}
+	return NULL;
+}
+
+/** traversal shared by workers, which take chunks of cells from it */
+typedef struct CacheParallelJob_t {
+	Cache cache;
+	VisitCacheCell visit;
+	void *context;
+	pthread_mutex_t lock;
+	int nextCell;
+} CacheParallelJob;
+
+typedef struct CacheParallelWorker_t {
+	CacheParallelJob *job;
+	int index;
+} CacheParallelWorker;
+
+/** visits chunks of cells until there are no more */
+static void cacheParallelWork(CacheParallelJob *job, int worker) {
+	while (true) {
+		pthread_mutex_lock(&job->lock);
+		int begin = job->nextCell;
+		int end = job->cache->cache_size - begin > CACHE_PARALLEL_CHUNK ?
+				begin + CACHE_PARALLEL_CHUNK : job->cache->cache_size;
+		job->nextCell = end;
+		pthread_mutex_unlock(&job->lock);
+		if (begin == end) {
+			return;
+		}
+		CacheCursor cursor = { job->cache, begin, end };
+		CACHE_CURSOR_FOREACH(cell, &cursor) {
+			job->visit(cell, worker, job->context);
+		}
+	}
+}
+
+static void *cacheParallelWorkerMain(void *argument) {
+	CacheParallelWorker *worker = (CacheParallelWorker*)argument;
+	cacheParallelWork(worker->job, worker->index);
+	return NULL;
+}
+
+CacheResult cacheParallelForEach(Cache cache, VisitCacheCell visit, void *context,
+		int nthreads) {
+	if (cache == NULL || visit == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	if (nthreads <= 0) {
+		return CACHE_OUT_OF_RANGE;
+	}
+	CacheResult result = cacheTraversalBegin(cache);
+	if (result != CACHE_SUCCESS) {
+		return result;
+	}
+	int chunks = (cache->cache_size - 1) / CACHE_PARALLEL_CHUNK + 1;
+	int helpers = (nthreads < chunks ? nthreads : chunks) - 1;
+	pthread_t *threads = (pthread_t*)malloc((helpers + 1) * sizeof(*threads));
+	CacheParallelWorker *workers =
+			(CacheParallelWorker*)malloc((helpers + 1) * sizeof(*workers));
+	if (threads == NULL || workers == NULL) {
+		free(threads);
+		free(workers);
+		return CACHE_OUT_OF_MEMORY;
+	}
+	CacheParallelJob job;
+	job.cache = cache;
+	job.visit = visit;
+	job.context = context;
+	job.nextCell = 0;
+	if (pthread_mutex_init(&job.lock, NULL) != 0) {
+		free(threads);
+		free(workers);
+		return CACHE_OUT_OF_MEMORY;
+	}
+	// threads which could not be started leave their share to the others
+	int started = 0;
+	for (int i = 0; i < helpers; ++i) {
+		workers[started].job = &job;
+		workers[started].index = started + 1;
+		if (pthread_create(threads + started, NULL, cacheParallelWorkerMain,
+				workers + started) == 0) {
+			++started;
+		}
+	}
+	cacheParallelWork(&job, 0);
+	for (int i = 0; i < started; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_mutex_destroy(&job.lock);
+	free(threads);
+	free(workers);
+	return CACHE_SUCCESS;
+}
+
+CacheResult cacheClear(Cache cache) {
+	if (cache == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	if (cacheIsPool(cache)) {
+		cachePoolClear(cache);
+		return CACHE_SUCCESS;
+	}
+	if (cacheIsConcurrent(cache)) {
+		return cacheConcurrentClear(cache);
+	}
+
+	cacheContainerDestroy(cache, cache->oldContainer, cache->old_size);
+	cache->oldContainer = NULL;
+	cache->old_size = 0;
+	cache->migrateIndex = 0;
+	CACHE_CONTAINER_FOREACH(i, cache) {
+		cacheCellClear(cache, cache->container[i]);
+	}
+	cache->elementsCount = 0;
+	if (cacheIsAccounted(cache)) {
+		free(cache->oldCellBytes);
+		cache->oldCellBytes = NULL;
+		memset(cache->cellBytes, 0, cache->cache_size * sizeof(*cache->cellBytes));
+		cacheBudgetRelease(cache, cache->elementBytes);
+		cache->elementBytes = 0;
+	}
+	cacheTimerWheelClear(cache->timers);
+	if (cache->bloomCounters != NULL) {
+		memset(cache->bloomCounters, 0, (size_t)cache->bloomMask + 1);
+	}
+
+	return CACHE_SUCCESS;
+}
+
+void cacheDestroy(Cache cache) {
+	if (cache == NULL) {
+		return;
+	}
+
+	cacheContainerDestroy(cache, cache->oldContainer, cache->old_size);
+	cacheContainerDestroy(cache, cache->container, cache->cache_size);
+	cacheBudgetRelease(cache, cache->elementBytes);
+	free(cache->cellBytes);
+	free(cache->oldCellBytes);
+	free(cache->bloomCounters);
+	free(cache->sketchCounters);
+	cacheTimerWheelDestroy(cache->timers);
+	if (cache->restore != NULL) {
+		cacheRestoreFinish(cache, true);
+	}
+	if (cacheIsPool(cache)) {
+		cachePoolDestroy(cache);
+	}
+	if (cacheIsConcurrent(cache)) {
+		cacheConcurrentDestroy(cache);
+	}
+	setDestroy(cache->iterationCell);
+	free(cache);
+}
+
+/** adds elements of cells [begin, end) of container to bloom filter */
+static void cacheBloomAddContainer(Cache cache, Set *container, int begin, int end) {
+	for (int i = begin; i < end; ++i) {
+		if (container[i] == NULL) {
+			continue;
+		}
+		SET_FOREACH(CacheElement, element, container[i]) {
+			cacheBloomUpdate(cache, element, 1);
+		}
+	}
+}
+
+CacheResult cacheEnableBloomFilter(Cache cache, HashCacheElement hash_element,
+		int expected_elements) {
+	if (cache == NULL || hash_element == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	if (expected_elements <= 0) {
+		return CACHE_OUT_OF_RANGE;
+	}
+	if (cacheIsShared(cache)) {
+		return CACHE_NOT_SUPPORTED;
+	}
+	uint64_t counters = 1;
+	while (counters < (uint64_t)expected_elements * CACHE_BLOOM_COUNTERS_PER_ELEMENT) {
+		counters *= 2;
+	}
+	if (counters > SIZE_MAX) {
+		return CACHE_OUT_OF_MEMORY;
+	}
+	uint8_t *bloomCounters = (uint8_t*)calloc((size_t)counters, sizeof(*bloomCounters));
+	if (bloomCounters == NULL) {
+		return CACHE_OUT_OF_MEMORY;
+	}
+	free(cache->bloomCounters);
+	cache->bloomHash = hash_element;
+	cache->bloomCounters = bloomCounters;
+	cache->bloomMask = counters - 1;
+	// elements pushed before
+	cacheBloomAddContainer(cache, cache->container, 0, cache->cache_size);
+	cacheBloomAddContainer(cache, cache->oldContainer, cache->migrateIndex, cache->old_size);
+	return CACHE_SUCCESS;
+}
+
+CacheResult cacheSetCapacity(Cache cache, int capacity) {
+	if (cache == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	if (capacity < 0 || (capacity != CACHE_UNBOUNDED && capacity < cache->elementsCount)) {
+		return CACHE_OUT_OF_RANGE;
+	}
+	if (cacheIsShared(cache) && capacity != CACHE_UNBOUNDED) {
+		return CACHE_NOT_SUPPORTED;
+	}
+	cache->capacity = capacity;
+	return CACHE_SUCCESS;
+}
+
+CacheResult cacheSetEvictionListener(Cache cache, CacheEvictionListener listener,
+		void *context) {
+	if (cache == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	cache->evictionListener = listener;
+	cache->evictionContext = context;
+	return CACHE_SUCCESS;
+}
+
+CacheResult cacheEnableAdmissionFilter(Cache cache, HashCacheElement hash_element) {
+	if (cache == NULL || hash_element == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	if (cache->capacity == CACHE_UNBOUNDED) {
+		return CACHE_OUT_OF_RANGE;
+	}
+	uint64_t width = CACHE_SKETCH_MIN_WIDTH;
+	while (width < (uint64_t)cache->capacity) {
+		width *= 2;
+	}
+	if (width * CACHE_SKETCH_ROWS > SIZE_MAX) {
+		return CACHE_OUT_OF_MEMORY;
+	}
+	uint8_t *sketchCounters = (uint8_t*)calloc((size_t)(width * CACHE_SKETCH_ROWS),
+			sizeof(*sketchCounters));
+	if (sketchCounters == NULL) {
+		return CACHE_OUT_OF_MEMORY;
+	}
+	free(cache->sketchCounters);
+	cache->sketchHash = hash_element;
+	cache->sketchCounters = sketchCounters;
+	cache->sketchMask = width - 1;
+	cache->sketchAdditions = 0;
+	cache->sketchSampleSize = (long)width * CACHE_SKETCH_SAMPLE_RATIO;
+	return CACHE_SUCCESS;
+}
+
+/** adds bytes of elements of cells [begin, end) of container to totals */
+static void cacheAccountContainer(Cache cache, Set *container, long *cellBytes,
+		int begin, int end) {
+	for (int i = begin; i < end; ++i) {
+		cellBytes[i] = 0;
+		if (container[i] == NULL) {
+			continue;
+		}
+		SET_FOREACH(CacheElement, element, container[i]) {
+			cellBytes[i] += cacheElementBytes(cache, element);
+		}
+		cache->elementBytes += cellBytes[i];
+	}
+}
+
+/**
+ * measures all elements of cache again, allocating totals if accounting is
+ * off. Bytes charged to budget are not changed.
+ * @return false on allocation failure
+ */
+static bool cacheAccountAll(Cache cache) {
+	if (!cacheIsAccounted(cache)) {
+		long *cellBytes = (long*)calloc(cache->cache_size, sizeof(*cellBytes));
+		long *oldCellBytes = NULL;
+		if (cacheIsMigrating(cache)) {
+			oldCellBytes = (long*)calloc(cache->old_size, sizeof(*oldCellBytes));
+		}
+		if (cellBytes == NULL || (cacheIsMigrating(cache) && oldCellBytes == NULL)) {
+			free(cellBytes);
+			free(oldCellBytes);
+			return false;
+		}
+		cache->cellBytes = cellBytes;
+		cache->oldCellBytes = oldCellBytes;
+	}
+	cache->elementBytes = 0;
+	cacheAccountContainer(cache, cache->container, cache->cellBytes, 0, cache->cache_size);
+	if (cacheIsMigrating(cache)) {
+		cacheAccountContainer(cache, cache->oldContainer, cache->oldCellBytes,
+				cache->migrateIndex, cache->old_size);
+	}
+	return true;
+}
+
+CacheResult cacheSetElementSize(Cache cache, SizeCacheElement size_element) {
+	if (cache == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	if (cacheIsShared(cache)) {
+		return CACHE_NOT_SUPPORTED;
+	}
+	SizeCacheElement oldSizeElement = cache->sizeElement;
+	long oldBytes = cache->elementBytes;
+	cache->sizeElement = size_element;
+	if (!cacheAccountAll(cache)) {
+		cache->sizeElement = oldSizeElement;
+		return CACHE_OUT_OF_MEMORY;
+	}
+	// budget follows the new measure, even if it is exceeded now
+	if (cache->budget != NULL) {
+		CACHE_ATOMIC_ADD(&cache->budget->used, cache->elementBytes - oldBytes);
+	}
+	return CACHE_SUCCESS;
+}
+
+CacheBudget cacheBudgetCreate(long limit) {
+	if (limit <= 0) {
+		return NULL;
+	}
+	CacheBudget budget;
+	CACHE_ALLOCATE(struct cache_budget_t, budget, NULL);
+	budget->limit = limit;
+	budget->used = 0;
+	return budget;
+}
+
+long cacheBudgetGetUsage(CacheBudget budget) {
+	if (budget == NULL) {
+		return -1;
+	}
+	return CACHE_ATOMIC_LOAD(&budget->used);
+}
+
+void cacheBudgetDestroy(CacheBudget budget) {
+	free(budget);
+}
+
+CacheResult cacheSetBudget(Cache cache, CacheBudget budget, CacheBudgetPolicy policy) {
+	if (cache == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	if (cacheIsShared(cache)) {
+		return CACHE_NOT_SUPPORTED;
+	}
+	if (budget != NULL && !cacheIsAccounted(cache) && !cacheAccountAll(cache)) {
+		return CACHE_OUT_OF_MEMORY;
+	}
+	if (budget != NULL && budget != cache->budget &&
+			!cacheBudgetReserve(budget, cache->elementBytes)) {
+		return CACHE_OUT_OF_RANGE;
+	}
+	if (budget != cache->budget) {
+		cacheBudgetRelease(cache, cache->elementBytes);
+	}
+	cache->budget = budget;
+	cache->budgetPolicy = policy;
+	return CACHE_SUCCESS;
+}
+
+/** returns bytes of cells of container */
+static long cacheContainerMemoryUsage(Set *container, int size) {
+	long usage = (long)size * (long)sizeof(*container);
+	for (int i = 0; i < size; ++i) {
+		if (container[i] != NULL) {
+			usage += CACHE_CELL_OVERHEAD;
+		}
+	}
+	return usage;
+}
+
+long cacheGetMemoryUsage(Cache cache) {
+	if (cache == NULL) {
+		return -1;
+	}
+	long usage = sizeof(*cache);
+	usage += cacheContainerMemoryUsage(cache->container, cache->cache_size);
+	if (cacheIsMigrating(cache)) {
+		usage += cacheContainerMemoryUsage(cache->oldContainer, cache->old_size);
+	}
+	if (cacheIsAccounted(cache)) {
+		usage += (long)(cache->cache_size + cache->old_size) * (long)sizeof(long);
+		usage += cache->elementBytes;
+	} else {
+		usage += (long)cache->elementsCount * CACHE_NODE_OVERHEAD;
+	}
+	if (cache->bloomCounters != NULL) {
+		usage += (long)cache->bloomMask + 1;
+	}
+	if (cache->sketchCounters != NULL) {
+		usage += CACHE_SKETCH_ROWS * ((long)cache->sketchMask + 1);
+	}
+	if (cache->timers != NULL) {
+		usage += sizeof(*cache->timers);
+		usage += (long)cache->timers->indexCapacity * (long)sizeof(*cache->timers->index);
+		usage += (long)cache->timers->count * (long)sizeof(CacheTimer);
+	}
+	if (cacheIsPool(cache)) {
+		CachePool *pool = cache->pool;
+		usage += sizeof(*pool) + CACHE_CELL_OVERHEAD;
+		usage += (long)cache->cache_size * (long)sizeof(*pool->heads);
+		long chunkSize = CACHE_POOL_FIRST_CHUNK;
+		for (int chunk = 0; chunk < CACHE_POOL_CHUNKS; ++chunk, chunkSize *= 2) {
+			if (CACHE_ATOMIC_LOAD(&pool->chunks[chunk]) != NULL) {
+				usage += chunkSize * (long)sizeof(CachePoolNode);
+			}
+		}
+	}
+	if (cacheIsConcurrent(cache)) {
+		CacheConcurrent *concurrent = cache->concurrent;
+		usage += sizeof(*concurrent) + CACHE_CELL_OVERHEAD;
+		usage += (long)cache->cache_size * (long)sizeof(*concurrent->cells);
+		pthread_mutex_lock(&concurrent->writeLock);
+		for (int key = 0; key < cache->cache_size; ++key) {
+			if (concurrent->cells[key] != NULL) {
+				usage += sizeof(CacheCellVersion) +
+						(long)concurrent->cells[key]->size * (long)sizeof(CacheElement);
+			}
+		}
+		pthread_mutex_unlock(&concurrent->writeLock);
+	}
+	return usage;
+}
+
+long cacheGetCellMemoryUsage(Cache cache, int key) {
+	if (cache == NULL || !cacheIsAccounted(cache)) {
+		return -1;
+	}
+	// totals of current container are complete once migration is
+	if (!cacheResizeFinish(cache) || !cacheIsKeyCorrect(cache, key)) {
+		return -1;
+	}
+	return cache->cellBytes[key];
+}
+
+/** writes 32-bit value in little endian order */
+static bool cacheSnapshotWriteLength(FILE *file, unsigned long value) {
+	unsigned char bytes[4];
+	for (int i = 0; i < 4; ++i) {
+		bytes[i] = (unsigned char)(value >> (8 * i));
+	}
+	return fwrite(bytes, 1, sizeof(bytes), file) == sizeof(bytes);
+}
+
+/** reads 32-bit little endian value */
+static bool cacheSnapshotReadLength(FILE *file, unsigned long *value) {
+	unsigned char bytes[4];
+	if (fread(bytes, 1, sizeof(bytes), file) != sizeof(bytes)) {
+		return false;
+	}
+	*value = 0;
+	for (int i = 0; i < 4; ++i) {
+		*value |= (unsigned long)bytes[i] << (8 * i);
+	}
+	return true;
+}
+
+/**
+ * writes records of all elements of cache to file
+ * @return CACHE_IO_ERROR on encoding or write failure
+ */
+static CacheResult cacheSnapshotWrite(Cache cache, FILE *file, EncodeCacheElement encode) {
+	if (fwrite(CACHE_SNAPSHOT_MAGIC, 1, CACHE_SNAPSHOT_MAGIC_SIZE, file) !=
+			CACHE_SNAPSHOT_MAGIC_SIZE ||
+			!cacheSnapshotWriteLength(file, CACHE_SNAPSHOT_VERSION)) {
+		return CACHE_IO_ERROR;
+	}
+	int size = CACHE_SNAPSHOT_BUFFER_SIZE;
+	unsigned char *buffer = (unsigned char*)malloc(size);
+	if (buffer == NULL) {
+		return CACHE_OUT_OF_MEMORY;
+	}
+	CacheResult result = CACHE_SUCCESS;
+	CacheCursor cursor = { cache, 0, cache->cache_size };
+	CACHE_CURSOR_FOREACH(cell, &cursor) {
+		SET_FOREACH(CacheElement, element, cell) {
+			int length = encode(element, buffer, size);
+			if (length > size) {
+				// buffer too small, nothing was written to it
+				unsigned char *grown = (unsigned char*)realloc(buffer, length);
+				if (grown == NULL) {
+					free(buffer);
+					return CACHE_OUT_OF_MEMORY;
+				}
+				buffer = grown;
+				size = length;
+				length = encode(element, buffer, size);
+			}
+			if (length < 0 || length > size ||
+					!cacheSnapshotWriteLength(file, (unsigned long)length) ||
+					fwrite(buffer, 1, length, file) != (size_t)length) {
+				result = CACHE_IO_ERROR;
+				break;
+			}
+		}
+		if (result != CACHE_SUCCESS) {
+			break;
+		}
+	}
+	free(buffer);
+	if (result == CACHE_SUCCESS && !cacheSnapshotWriteLength(file, CACHE_SNAPSHOT_END)) {
+		result = CACHE_IO_ERROR;
+	}
+	return result;
+}
+
+CacheResult cacheSnapshot(Cache cache, const char *path, EncodeCacheElement encode) {
+	if (cache == NULL || path == NULL || encode == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	CacheResult result = cacheTraversalBegin(cache);
+	if (result != CACHE_SUCCESS) {
+		return result;
+	}
+	// the old snapshot stays intact until the new one is complete
+	char *temporaryPath = (char*)malloc(strlen(path) + sizeof(".tmp"));
+	if (temporaryPath == NULL) {
+		return CACHE_OUT_OF_MEMORY;
+	}
+	strcat(strcpy(temporaryPath, path), ".tmp");
+	FILE *file = fopen(temporaryPath, "wb");
+	if (file == NULL) {
+		free(temporaryPath);
+		return CACHE_IO_ERROR;
+	}
+	result = cacheSnapshotWrite(cache, file, encode);
+	if (fclose(file) != 0 && result == CACHE_SUCCESS) {
+		result = CACHE_IO_ERROR;
+	}
+	if (result == CACHE_SUCCESS && rename(temporaryPath, path) != 0) {
+		// rename does not replace existing file on some systems
+		remove(path);
+		if (rename(temporaryPath, path) != 0) {
+			result = CACHE_IO_ERROR;
+		}
+	}
+	if (result != CACHE_SUCCESS) {
+		remove(temporaryPath);
+	}
+	free(temporaryPath);
+	return result;
+}
+
+/**
+ * opens snapshot file and checks its header
+ * @return NULL if file cannot be opened or is not a snapshot
+ */
+static FILE *cacheSnapshotOpen(const char *path) {
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		return NULL;
+	}
+	char magic[CACHE_SNAPSHOT_MAGIC_SIZE];
+	unsigned long version;
+	if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+			memcmp(magic, CACHE_SNAPSHOT_MAGIC, sizeof(magic)) != 0 ||
+			!cacheSnapshotReadLength(file, &version) ||
+			version != CACHE_SNAPSHOT_VERSION) {
+		fclose(file);
+		return NULL;
+	}
+	return file;
+}
+
+/** receives decoded elements, returns false to stop reading */
+typedef bool (*CacheSnapshotSink)(void *target, CacheElement element);
+
+/**
+ * reads records of snapshot, decodes them and passes to sink
+ * @return CACHE_IO_ERROR if snapshot is malformed or truncated
+ */
+static CacheResult cacheSnapshotRead(FILE *file, DecodeCacheElement decode,
+		CacheSnapshotSink sink, void *target) {
+	size_t size = CACHE_SNAPSHOT_BUFFER_SIZE;
+	unsigned char *buffer = (unsigned char*)malloc(size);
+	if (buffer == NULL) {
+		return CACHE_OUT_OF_MEMORY;
+	}
+	CacheResult result = CACHE_SUCCESS;
+	unsigned long length;
+	while (true) {
+		if (!cacheSnapshotReadLength(file, &length)) {
+			result = CACHE_IO_ERROR;
+			break;
+		}
+		if (length == CACHE_SNAPSHOT_END) {
+			break;
+		}
+		if (length > INT_MAX) {
+			result = CACHE_IO_ERROR;
+			break;
+		}
+		if (length > size) {
+			unsigned char *grown = (unsigned char*)realloc(buffer, length);
+			if (grown == NULL) {
+				result = CACHE_OUT_OF_MEMORY;
+				break;
+			}
+			buffer = grown;
+			size = length;
+		}
+		if (fread(buffer, 1, length, file) != length) {
+			result = CACHE_IO_ERROR;
+			break;
+		}
+		CacheElement element = decode(buffer, (int)length);
+		if (element == NULL) {
+			result = CACHE_OUT_OF_MEMORY;
+			break;
+		}
+		if (!sink(target, element)) {
+			break;
+		}
+	}
+	free(buffer);
+	return result;
+}
+
+/** restore sink which adds elements to cache right away */
+static bool cacheRestoreSinkCache(void *target, CacheElement element) {
+	Cache cache = (Cache)target;
+	CacheResult result = cacheAddRestored(cache, element);
+	if (result != CACHE_SUCCESS) {
+		cache->restoreResult = result;
+		return false;
+	}
+	return true;
+}
+
+CacheResult cacheRestore(Cache cache, const char *path, DecodeCacheElement decode) {
+	if (cache == NULL || path == NULL || decode == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	if (cache->restore != NULL) {
+		cache->restoreResult = cacheRestoreFinish(cache, false);
+	}
+	FILE *file = cacheSnapshotOpen(path);
+	if (file == NULL) {
+		return CACHE_IO_ERROR;
+	}
+	// the sink reports through restoreResult, which holds the result of
+	// background restore until cacheRestoreWait collects it
+	CacheResult backgroundResult = cache->restoreResult;
+	cache->restoreResult = CACHE_SUCCESS;
+	CacheResult result = cacheSnapshotRead(file, decode, cacheRestoreSinkCache, cache);
+	fclose(file);
+	if (result == CACHE_SUCCESS) {
+		result = cache->restoreResult;
+	}
+	cache->restoreResult = backgroundResult;
+	return result;
+}
+
+/** restore sink which queues elements, waiting while the queue is full */
+static bool cacheRestoreSinkQueue(void *target, CacheElement element) {
+	CacheRestore *restore = (CacheRestore*)target;
+	pthread_mutex_lock(&restore->lock);
+	while (restore->queueCount == CACHE_RESTORE_QUEUE_SIZE && !restore->cancelled) {
+		pthread_cond_wait(&restore->changed, &restore->lock);
+	}
+	bool cancelled = restore->cancelled;
+	if (!cancelled) {
+		int tail = (restore->queueHead + restore->queueCount) % CACHE_RESTORE_QUEUE_SIZE;
+		restore->queue[tail] = element;
+		++restore->queueCount;
+		pthread_cond_broadcast(&restore->changed);
+	}
+	pthread_mutex_unlock(&restore->lock);
+	if (cancelled) {
+		restore->freeElement(element);
+	}
+	return !cancelled;
+}
+
+static void *cacheRestoreThreadMain(void *argument) {
+	CacheRestore *restore = (CacheRestore*)argument;
+	CacheResult result = cacheSnapshotRead(restore->file, restore->decode,
+			cacheRestoreSinkQueue, restore);
+	pthread_mutex_lock(&restore->lock);
+	restore->readResult = result;
+	restore->done = true;
+	pthread_cond_broadcast(&restore->changed);
+	pthread_mutex_unlock(&restore->lock);
+	return NULL;
+}
+
+CacheResult cacheRestoreAsync(Cache cache, const char *path, DecodeCacheElement decode) {
+	if (cache == NULL || path == NULL || decode == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	if (cacheIsShared(cache)) {
+		// restored elements would be added by operations of any thread
+		return CACHE_NOT_SUPPORTED;
+	}
+	if (cache->restore != NULL) {
+		cache->restoreResult = cacheRestoreFinish(cache, false);
+	}
+	CacheRestore *restore;
+	CACHE_ALLOCATE(CacheRestore, restore, CACHE_OUT_OF_MEMORY);
+	restore->file = cacheSnapshotOpen(path);
+	if (restore->file == NULL) {
+		free(restore);
+		return CACHE_IO_ERROR;
+	}
+	restore->decode = decode;
+	restore->freeElement = cache->freeElement;
+	restore->queueHead = 0;
+	restore->queueCount = 0;
+	restore->done = false;
+	restore->cancelled = false;
+	restore->readResult = CACHE_SUCCESS;
+	restore->pushResult = CACHE_SUCCESS;
+	if (pthread_mutex_init(&restore->lock, NULL) != 0) {
+		fclose(restore->file);
+		free(restore);
+		return CACHE_OUT_OF_MEMORY;
+	}
+	if (pthread_cond_init(&restore->changed, NULL) != 0) {
+		pthread_mutex_destroy(&restore->lock);
+		fclose(restore->file);
+		free(restore);
+		return CACHE_OUT_OF_MEMORY;
+	}
+	if (pthread_create(&restore->thread, NULL, cacheRestoreThreadMain, restore) != 0) {
+		pthread_cond_destroy(&restore->changed);
+		pthread_mutex_destroy(&restore->lock);
+		fclose(restore->file);
+		free(restore);
+		return CACHE_OUT_OF_MEMORY;
+	}
+	cache->restore = restore;
+	return CACHE_SUCCESS;
+}
+
+CacheResult cacheRestoreWait(Cache cache) {
+	if (cache == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	if (cache->restore != NULL) {
+		cache->restoreResult = cacheRestoreFinish(cache, false);
+	}
+	CacheResult result = cache->restoreResult;
+	cache->restoreResult = CACHE_SUCCESS;
+	return result;
+}
+
+#ifdef CACHE_STATS
+CacheResult cacheGetStats(Cache cache, CacheStats *stats) {
+	if (cache == NULL || stats == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	*stats = cache->stats;
+	return CACHE_SUCCESS;
+}
+
+CacheResult cacheResetStats(Cache cache) {
+	if (cache == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	memset(&cache->stats, 0, sizeof(cache->stats));
+	return CACHE_SUCCESS;
+}
+
+/** writes histogram as a json array */
+static void cacheStatsDumpJsonArray(FILE *output, const long *histogram) {
+	fprintf(output, "[");
+	for (int i = 0; i < CACHE_STATS_HISTOGRAM_SIZE; ++i) {
+		fprintf(output, "%s%ld", i == 0 ? "" : ", ", histogram[i]);
+	}
+	fprintf(output, "]");
+}
+
+/** writes histogram as csv lines */
+static void cacheStatsDumpCsvArray(FILE *output, const char *name, const long *histogram) {
+	for (int i = 0; i < CACHE_STATS_HISTOGRAM_SIZE; ++i) {
+		fprintf(output, "%s_%d%s,%ld\n", name, i,
+				i + 1 == CACHE_STATS_HISTOGRAM_SIZE ? "_or_more" : "", histogram[i]);
+	}
+}
+
+/** adds a cell holding size elements to occupancy histogram */
+static void cacheStatsAddOccupancy(int size, long *occupancy, int *maxOccupancy) {
+	++occupancy[size < CACHE_STATS_HISTOGRAM_SIZE ? size : CACHE_STATS_HISTOGRAM_SIZE - 1];
+	*maxOccupancy = size > *maxOccupancy ? size : *maxOccupancy;
+}
+
+/** adds sizes of cells [begin, end) of container to occupancy histogram */
+static void cacheStatsCountOccupancy(Set *container, int begin, int end,
+		long *occupancy, int *maxOccupancy) {
+	for (int i = begin; i < end; ++i) {
+		int size = container[i] == NULL ? 0 : setGetSize(container[i]);
+		cacheStatsAddOccupancy(size, occupancy, maxOccupancy);
+	}
+}
+
+/** adds sizes of the cell stacks of pool to occupancy histogram */
+static void cacheStatsCountPoolOccupancy(Cache cache, long *occupancy, int *maxOccupancy) {
+	CachePool *pool = cache->pool;
+	for (int key = 0; key < cache->cache_size; ++key) {
+		int size = 0;
+		uint32_t next = (uint32_t)(CACHE_ATOMIC_LOAD(pool->heads + key) & CACHE_POOL_INDEX_MASK);
+		while (next != 0) {
+			++size;
+			next = CACHE_ATOMIC_LOAD(&cachePoolNode(pool, next - 1)->next);
+		}
+		cacheStatsAddOccupancy(size, occupancy, maxOccupancy);
+	}
+}
+
+/** adds sizes of the current cell versions of concurrent cache to occupancy histogram */
+static void cacheStatsCountConcurrentOccupancy(Cache cache, long *occupancy,
+		int *maxOccupancy) {
+	CacheConcurrent *concurrent = cache->concurrent;
+	// versions are released by writers only, under the lock
+	pthread_mutex_lock(&concurrent->writeLock);
+	for (int key = 0; key < cache->cache_size; ++key) {
+		int size = concurrent->cells[key] == NULL ? 0 : concurrent->cells[key]->size;
+		cacheStatsAddOccupancy(size, occupancy, maxOccupancy);
+	}
+	pthread_mutex_unlock(&concurrent->writeLock);
+}
+
+CacheResult cacheDumpStats(Cache cache, FILE *output, CacheStatsFormat format) {
+	if (cache == NULL || output == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	// occupancy is computed from the cells themselves, it costs nothing on updates
+	long occupancy[CACHE_STATS_HISTOGRAM_SIZE] = { 0 };
+	int maxOccupancy = 0;
+	if (cacheIsPool(cache)) {
+		cacheStatsCountPoolOccupancy(cache, occupancy, &maxOccupancy);
+	} else if (cacheIsConcurrent(cache)) {
+		cacheStatsCountConcurrentOccupancy(cache, occupancy, &maxOccupancy);
+	} else {
+		cacheStatsCountOccupancy(cache->container, 0, cache->cache_size,
+				occupancy, &maxOccupancy);
+		cacheStatsCountOccupancy(cache->oldContainer, cache->migrateIndex, cache->old_size,
+				occupancy, &maxOccupancy);
+	}
+	const CacheStats *stats = &cache->stats;
+	if (format == CACHE_STATS_JSON) {
+		fprintf(output, "{\"cells\": %d, \"elements\": %d, "
+				"\"pushes\": %ld, \"is_ins\": %ld, \"extracts\": %ld, \"frees\": %ld, "
+				"\"hits\": %ld, \"misses\": %ld, "
+				"\"lookups\": %ld, \"comparisons\": %ld, \"max_occupancy\": %d, "
+				"\"probe_histogram\": ",
+				cache->cache_size, cache->elementsCount,
+				stats->pushes, stats->isIns, stats->extracts, stats->frees,
+				stats->hits, stats->misses,
+				stats->lookups, stats->comparisons, maxOccupancy);
+		cacheStatsDumpJsonArray(output, stats->probeHistogram);
+		fprintf(output, ", \"occupancy_histogram\": ");
+		cacheStatsDumpJsonArray(output, occupancy);
+		fprintf(output, "}\n");
+	} else {
+		fprintf(output, "metric,value\n"
+				"cells,%d\nelements,%d\n"
+				"pushes,%ld\nis_ins,%ld\nextracts,%ld\nfrees,%ld\n"
+				"hits,%ld\nmisses,%ld\n"
+				"lookups,%ld\ncomparisons,%ld\nmax_occupancy,%d\n",
+				cache->cache_size, cache->elementsCount,
+				stats->pushes, stats->isIns, stats->extracts, stats->frees,
+				stats->hits, stats->misses,
+				stats->lookups, stats->comparisons, maxOccupancy);
+		cacheStatsDumpCsvArray(output, "probe", stats->probeHistogram);
+		cacheStatsDumpCsvArray(output, "occupancy", occupancy);
+	}
+	return ferror(output) ? CACHE_IO_ERROR : CACHE_SUCCESS;
 }
+#endif
@@ -10,6 +10,10 @@
 
 #include "set.h"
 #include <stdbool.h>
+#include <stdint.h>
+#ifdef CACHE_STATS
+#include <stdio.h>
+#endif
 
 /**
  * Types defintion for the generic implementation.
@@ -19,6 +23,13 @@ typedef void (*FreeCacheElement)(CacheElement);
 typedef CacheElement (*CopyCacheElement)(CacheElement);
 typedef int (*CompareCacheElements)(CacheElement, CacheElement);
 typedef int (*ComputeCacheKey)(CacheElement);
+typedef uint64_t (*HashCacheElement)(CacheElement);
+typedef uint64_t (*CacheClock)(void);
+typedef void (*VisitCacheCell)(Set cell, int worker, void *context);
+typedef void (*CacheEvictionListener)(CacheElement element, void *context);
+typedef long (*SizeCacheElement)(CacheElement);
+typedef int (*EncodeCacheElement)(CacheElement, unsigned char *buffer, int size);
+typedef CacheElement (*DecodeCacheElement)(const unsigned char *buffer, int length);
 
 /**
  * Defintion of different result types.
@@ -32,11 +43,42 @@ typedef enum CacheResult_t {
 	CACHE_ITEM_ALREADY_EXISTS,
 	CACHE_ITEM_DOES_NOT_EXIST,
 	CACHE_OUT_OF_MEMORY,
+	CACHE_IO_ERROR,
+	CACHE_ITEM_REJECTED,
+	CACHE_NOT_SUPPORTED,
 
 } CacheResult;
 
 typedef struct cache_t* Cache;
 
+/**
+ * Byte budget which one or more caches charge their elements to, so that a
+ * process can bound memory of all its caches together. A budget may be
+ * shared by caches used from different threads.
+ */
+typedef struct cache_budget_t* CacheBudget;
+
+/**
+ * What a cache does with an element which does not fit its budget.
+ */
+typedef enum CacheBudgetPolicy_t {
+	/** the element is not added */
+	CACHE_BUDGET_REJECT,
+	/** elements of this cache are evicted, as from a full bounded cache */
+	CACHE_BUDGET_EVICT,
+} CacheBudgetPolicy;
+
+/**
+ * External read-only iterator over cells of a cache. Unlike the internal
+ * iterator, any number of cursors can walk the same cache at once. Fields
+ * are internal to the cache implementation.
+ */
+typedef struct CacheCursor_t {
+	Cache cache;
+	int index;
+	int end;
+} CacheCursor;
+
 /**
  * Creates a new cache of elements.
  *
@@ -57,15 +99,176 @@ Cache cacheCreate(
     ComputeCacheKey compute_key);
 
 /**
- * Adds an element to the cache.
+ * Creates a new pool cache: a cache whose cells are unordered stacks rather
+ * than sets, for free lists and other pools of interchangeable elements.
+ *
+ * Pushing an element, extracting an element by key and checking whether a
+ * cell is empty take constant time, and may be called from several threads
+ * at once without locking (unless built with CACHE_STATS). Extraction returns
+ * the element pushed to the cell last. Elements are not checked for
+ * duplicates. Removing a specific element is linear in the size of its cell.
+ * Iteration copies each cell into a sorted set when it is reached, so it
+ * sees cells in the usual order, but must not run concurrently with changes.
+ *
+ * Time to live, capacity, bloom and admission filters, memory accounting,
+ * cursors, parallel traversal, snapshots and asynchronous restore are not
+ * supported and return CACHE_NOT_SUPPORTED.
+ *
+ * @param size - number of cells in cache container.
+ * @param free_element - callback to be called for destroying an element.
+ * @param copy_element - callback to be called for copying an element.
+ * @param compare_elements - callback to be called for comparing between elements.
+ * @param compute_key - callback to be called for computing the key for an
+ * element.
+ *
+ * @return A new allocated cache, or NULL in case of error.
+ */
+Cache cacheCreatePool(
+    int size,
+    FreeCacheElement free_element,
+    CopyCacheElement copy_element,
+    CompareCacheElements compare_elements,
+    ComputeCacheKey compute_key);
+
+/**
+ * Creates a new concurrent cache: a cache for read-mostly use from several
+ * threads, whose lookups never lock nor write to shared memory.
+ *
+ * Every cell is an immutable sorted array. cacheIsIn searches it without
+ * locking, from any number of threads. Changes (pushing, removing, clearing)
+ * are serialized by a lock and copy the cell, then publish the copy; the old
+ * copy and removed elements are released only when no lookup can still see
+ * them. So a change costs time linear in the size of its cell.
+ *
+ * Since lookups may still compare with an element after it is removed,
+ * cacheExtractElementByKey returns a copy of the removed element (NULL if
+ * copying fails, the element stays then). Iteration copies each cell into a
+ * sorted set when it is reached, and must not run concurrently with changes.
+ * With CACHE_STATS lookups are not thread safe either.
+ *
+ * Time to live, capacity, bloom and admission filters, memory accounting,
+ * cursors, parallel traversal, snapshots and asynchronous restore are not
+ * supported and return CACHE_NOT_SUPPORTED.
+ *
+ * @param size - number of cells in cache container.
+ * @param free_element - callback to be called for destroying an element.
+ * @param copy_element - callback to be called for copying an element.
+ * @param compare_elements - callback to be called for comparing between elements.
+ * @param compute_key - callback to be called for computing the key for an
+ * element.
+ *
+ * @return A new allocated cache, or NULL in case of error.
+ */
+Cache cacheCreateConcurrent(
+    int size,
+    FreeCacheElement free_element,
+    CopyCacheElement copy_element,
+    CompareCacheElements compare_elements,
+    ComputeCacheKey compute_key);
+
+/**
+ * Creates a new cache of elements, which changes number of its cells
+ * according to number of elements it holds.
+ *
+ * Cell of an element is chosen by the lower bits of its hash, so the
+ * container size is always a power of two. When the cache grows or shrinks
+ * its elements are moved to the new container a few cells on every
+ * operation, rather than all at once.
+ *
+ * @param initial_size - initial (and minimal) number of cells in cache
+ * container, rounded up to a power of two.
+ * @param destroy-element - callback to be called for destroying an element.
+ * @param compare_elements - callback to be called for comparing between elements.
+ * @param hash_element - callback to be called for computing 64-bit hash of
+ * an element. Equal elements must have equal hashes.
+ *
+ * @return A new allocated cache, or NULL in case of error.
+ */
+Cache cacheCreateResizable(
+    int initial_size,
+    FreeCacheElement free_element,
+    CopyCacheElement copy_element,
+    CompareCacheElements compare_elements,
+    HashCacheElement hash_element);
+
+/**
+ * Creates a new cache of elements with fixed number of cells, chosen by a
+ * 64-bit hash of element instead of a key. The hash is mixed, so that all of
+ * its bits affect the cell, and masked, so every element gets a cell in
+ * range without division. Even hashes with poor low bits, like addresses,
+ * spread well.
+ *
+ * Keys of cells, as used by cacheExtractElementByKey, are indices in the
+ * container.
+ *
+ * @param size - number of cells in cache container, rounded up to a power
+ * of two.
+ * @param free_element - callback to be called for destroying an element.
+ * @param copy_element - callback to be called for copying an element.
+ * @param compare_elements - callback to be called for comparing between elements.
+ * @param hash_element - callback to be called for computing 64-bit hash of
+ * an element. Equal elements must have equal hashes.
+ *
+ * @return A new allocated cache, or NULL in case of error.
+ */
+Cache cacheCreateHashed(
+    int size,
+    FreeCacheElement free_element,
+    CopyCacheElement copy_element,
+    CompareCacheElements compare_elements,
+    HashCacheElement hash_element);
+
+/**
+ * Adds an element to the cache. If the cache is bounded and full, an element
+ * is evicted first (see cacheSetCapacity).
  * 
  * @param cache - cache to add the element to.
  * @param element - element to be added.
  *
- * @return Result code.
+ * @return Result code, CACHE_ITEM_REJECTED if admission filter decided to
+ * keep the elements in cache instead, or the element does not fit budget.
  */
 CacheResult cachePush(Cache cache, CacheElement element);
 
+/**
+ * Adds an element to the cache for a limited time. The element is removed
+ * and destroyed by the first expiration (cacheExpire, or any operation if
+ * the cache has a clock) at time now + ttl or later, where now is the last
+ * time the cache has seen.
+ *
+ * @param cache - cache to add the element to.
+ * @param element - element to be added.
+ * @param ttl - number of clock ticks the element lives, positive.
+ *
+ * @return Result code, CACHE_OUT_OF_RANGE if ttl is zero.
+ */
+CacheResult cachePushWithTTL(Cache cache, CacheElement element, uint64_t ttl);
+
+/**
+ * Advances time of the cache and destroys all elements which expired by then.
+ * Works in amortized constant time per expired element. Time never goes back,
+ * an earlier time than seen before is ignored.
+ *
+ * @param cache - cache to expire elements of.
+ * @param now - current time in clock ticks.
+ *
+ * @return Result code.
+ */
+CacheResult cacheExpire(Cache cache, uint64_t now);
+
+/**
+ * Sets clock of the cache. With a clock set, every cache operation first
+ * expires elements as cacheExpire(cache, clock()) would.
+ *
+ * @param cache - cache to set the clock of.
+ * @param clock - callback returning current time in ticks, or NULL to stop
+ * expiring on access.
+ *
+ * @return Result code, CACHE_NOT_SUPPORTED for pool and concurrent caches, as
+ * lazy expiry would change the cache from inside their lookups.
+ */
+CacheResult cacheSetClock(Cache cache, CacheClock clock);
+
 /**
  * Removes an element from the cache and destroyes it.
  *
@@ -81,7 +284,8 @@ CacheResult cacheFreeElement(Cache cache, CacheElement element);
  * the user.
  *
  * @param cache - cache to remove the element from.
- * @param key - key associated with the element removed.
+ * @param key - key associated with the element removed. For resizable cache
+ * it is index of a cell in [0, cacheGetSize(cache)).
  *
  * @return pointer to extracted element if succeeds, NULL otherwise.
  */
@@ -97,6 +301,220 @@ CacheElement cacheExtractElementByKey(Cache cache, int key);
  */
 bool cacheIsIn(Cache cache, CacheElement element);
 
+/**
+ * Adds a group of elements to the cache. Elements are grouped by cell and
+ * processed cell after cell, so every key is computed once and cells are
+ * prefetched. Elements of the same cell are added in order they are given.
+ *
+ * @param cache - cache to add the elements to.
+ * @param elements - array of elements to be added.
+ * @param n - number of elements.
+ * @param results - array of n result codes, one for every element as
+ * cachePush would return.
+ *
+ * @return Result code of the whole call, CACHE_SUCCESS if all elements were
+ * processed.
+ */
+CacheResult cachePushBatch(Cache cache, CacheElement *elements, int n,
+		CacheResult *results);
+
+/**
+ * Checks whether each of a group of elements exists in the cache, visiting
+ * cells in the same way as cachePushBatch.
+ *
+ * @param cache - cache to search.
+ * @param elements - array of elements to find.
+ * @param n - number of elements.
+ * @param results - array of n flags, true if the element was found.
+ *
+ * @return Result code of the whole call.
+ */
+CacheResult cacheIsInBatch(Cache cache, CacheElement *elements, int n, bool *results);
+
+/**
+ * Checks whether each of a small group of elements exists in the cache, with
+ * their lookups interleaved: the cell of every element is prefetched before
+ * any of them is compared, so that cache misses of different lookups overlap.
+ * Unlike cacheIsInBatch it allocates nothing and does not reorder elements,
+ * which suits a few independent lookups into a cache much larger than the
+ * processor caches.
+ *
+ * @param cache - cache to search.
+ * @param elements - array of elements to find, NULL elements are not found.
+ * @param n - number of elements.
+ * @param results - array of n flags, true if the element was found.
+ *
+ * @return Result code of the whole call.
+ */
+CacheResult cacheIsInProbes(Cache cache, CacheElement *elements, int n, bool *results);
+
+/**
+ * Removes up to n elements with the specified key from the cache, and returns
+ * them to the user.
+ *
+ * @param cache - cache to remove the elements from.
+ * @param key - key associated with the elements removed.
+ * @param n - maximal number of elements to remove.
+ * @param out - array of at least n places for removed elements.
+ *
+ * @return -1 if NULL was passed or n is negative, number of elements removed
+ * otherwise.
+ */
+int cacheExtractBatch(Cache cache, int key, int n, CacheElement *out);
+
+/**
+ * Puts counting bloom filter in front of the cache, so that most lookups of
+ * missing elements (cacheIsIn, cachePush, cacheFreeElement) are answered
+ * without searching the cell. Elements already in cache are added to the
+ * filter. Calling it again replaces the filter.
+ *
+ * @param cache - cache to add filter to.
+ * @param hash_element - callback computing 64-bit hash of an element. Equal
+ * elements must have equal hashes.
+ * @param expected_elements - number of elements the filter is sized for, the
+ * filter takes about 10 bytes per expected element.
+ *
+ * @return Result code, CACHE_OUT_OF_RANGE if expected_elements is not
+ * positive.
+ */
+CacheResult cacheEnableBloomFilter(Cache cache, HashCacheElement hash_element,
+		int expected_elements);
+
+/**
+ * Bounds number of elements in the cache. Adding an element to a full cache
+ * evicts the least frequently used (according to admission filter, if any)
+ * element of the new element's cell, or of the next non empty cell.
+ *
+ * @param cache - cache to bound.
+ * @param capacity - maximal number of elements, 0 removes the bound.
+ *
+ * @return Result code, CACHE_OUT_OF_RANGE if capacity is negative or less
+ * than number of elements in cache.
+ */
+CacheResult cacheSetCapacity(Cache cache, int capacity);
+
+/**
+ * Sets callback notified about elements evicted from a full bounded cache,
+ * so that they can be kept elsewhere. The listener is called right before
+ * the element is destroyed, and must not use the cache.
+ *
+ * @param cache - cache to listen to.
+ * @param listener - callback receiving evicted element and context, or NULL
+ * to remove the listener.
+ * @param context - passed to listener as is.
+ *
+ * @return Result code.
+ */
+CacheResult cacheSetEvictionListener(Cache cache, CacheEvictionListener listener,
+		void *context);
+
+/**
+ * Puts TinyLFU admission filter in front of a bounded cache: a count-min
+ * sketch of recent access frequencies (pushes and lookups), periodically
+ * aged. A new element is added to a full cache only if it is estimated to
+ * be more frequent than the element it would evict, so that elements seen
+ * once do not push out popular ones. The sketch takes 4 bytes per element
+ * of capacity. Calling it again replaces the filter.
+ *
+ * @param cache - bounded cache to add filter to.
+ * @param hash_element - callback computing 64-bit hash of an element. Equal
+ * elements must have equal hashes.
+ *
+ * @return Result code, CACHE_OUT_OF_RANGE if cache is not bounded.
+ */
+CacheResult cacheEnableAdmissionFilter(Cache cache, HashCacheElement hash_element);
+
+/**
+ * Turns on memory accounting: the cache keeps running totals of bytes held
+ * by every cell and by the whole cache. Bytes of an element are what
+ * size_element reports plus estimated overhead of its node in the cell.
+ * Calling it again measures all elements with the new callback.
+ *
+ * @param cache - cache to account.
+ * @param size_element - callback returning number of bytes owned by an
+ * element, which must not change while the element is in cache. NULL counts
+ * only the overhead.
+ *
+ * @return Result code, CACHE_NOT_SUPPORTED for pool cache.
+ */
+CacheResult cacheSetElementSize(Cache cache, SizeCacheElement size_element);
+
+/**
+ * Creates a byte budget.
+ *
+ * @param limit - maximal number of bytes charged to the budget, positive.
+ *
+ * @return A new allocated budget, or NULL in case of error.
+ */
+CacheBudget cacheBudgetCreate(long limit);
+
+/**
+ * Returns number of bytes currently charged to a budget.
+ *
+ * @param budget - budget to examine.
+ *
+ * @return -1 if NULL was passed, bytes in use otherwise.
+ */
+long cacheBudgetGetUsage(CacheBudget budget);
+
+/**
+ * Destroys a budget. Caches charging it must be destroyed or detached from
+ * it before.
+ *
+ * @param budget - budget to destroy.
+ */
+void cacheBudgetDestroy(CacheBudget budget);
+
+/**
+ * Charges bytes of cache elements to a budget, turning memory accounting on
+ * if it is not yet. Every added element reserves its bytes first; when they
+ * do not fit, the element is rejected or elements of this cache are evicted
+ * until they do, according to policy. An element larger than the whole
+ * budget, or one which does not fit while the cache is empty, is rejected
+ * either way. Elements removed from the cache return their bytes.
+ *
+ * @param cache - cache to charge.
+ * @param budget - budget to charge, NULL detaches the cache from its budget.
+ * @param policy - what to do with an element which does not fit.
+ *
+ * @return Result code, CACHE_OUT_OF_RANGE if elements already in the cache do
+ * not fit the budget, CACHE_NOT_SUPPORTED for pool cache.
+ */
+CacheResult cacheSetBudget(Cache cache, CacheBudget budget, CacheBudgetPolicy policy);
+
+/**
+ * Returns number of bytes used by a cache: its container, cells and
+ * filters, and its elements as measured by memory accounting. Without
+ * accounting only overhead of elements is counted. Sizes of cells and nodes
+ * are estimates.
+ *
+ * @param cache - cache to examine.
+ *
+ * @return -1 if NULL was passed, bytes in use otherwise.
+ */
+long cacheGetMemoryUsage(Cache cache);
+
+/**
+ * Returns number of bytes of elements of one cell, running total of memory
+ * accounting.
+ *
+ * @param cache - cache to examine.
+ * @param key - index of the cell in current container.
+ *
+ * @return -1 if NULL was passed, the key is out of range or accounting is
+ * off, bytes of cell elements otherwise.
+ */
+long cacheGetCellMemoryUsage(Cache cache, int key);
+
+/**
+ * Returns current number of cells in cache container.
+ *
+ * @param cache - cache to check.
+ *
+ * @return -1 if a NULL pointer was passed, number of cells otherwise.
+ */
+int cacheGetSize(Cache cache);
+
 /**
  * Sets the internal iterator to the first available cell and retrieves it.
  *
@@ -130,6 +548,125 @@ Set cacheGetNext(Cache cache);
  */
 Set cacheGetCurrent(Cache cache);
 
+/**
+ * Initializes cursor to walk over all cells of the cache. The cache must not
+ * be modified while the cursor is in use. Initialization itself is not read
+ * only (it completes resize of the cache), so it must not run concurrently
+ * with other operations on the cache.
+ *
+ * @param cache - cache to walk over.
+ * @param cursor - cursor to initialize.
+ *
+ * @return Result code.
+ */
+CacheResult cacheCursorInit(Cache cache, CacheCursor *cursor);
+
+/**
+ * Initializes cursor to walk over cells [begin, end) of the cache, so that
+ * the cache can be split between several cursors. Same restrictions as for
+ * cacheCursorInit apply.
+ *
+ * @param cache - cache to walk over.
+ * @param cursor - cursor to initialize.
+ * @param begin - index of the first cell.
+ * @param end - index after the last cell, at most cacheGetSize(cache).
+ *
+ * @return Result code, CACHE_OUT_OF_RANGE if the range is not within cache.
+ */
+CacheResult cacheCursorInitRange(Cache cache, CacheCursor *cursor, int begin, int end);
+
+/**
+ * Advances cursor to the next non empty cell and returns it.
+ *
+ * @param cursor - cursor to advance.
+ *
+ * @return NULL if NULL was passed or there are no more cells, the next non
+ * empty cell otherwise.
+ */
+Set cacheCursorNext(CacheCursor *cursor);
+
+/**
+ * Calls visit for every non empty cell of the cache, splitting the cells
+ * between nthreads workers (the calling thread is one of them). Every cell
+ * is visited exactly once, by a single worker. Visitors may read cells, but
+ * must not modify the cache. Statistics build is not thread safe, so there
+ * visitors must not search the cells.
+ *
+ * @param cache - cache to traverse.
+ * @param visit - callback receiving cell, index of worker in [0, nthreads)
+ * and context.
+ * @param context - passed to visit as is.
+ * @param nthreads - number of workers, positive.
+ *
+ * @return Result code, CACHE_OUT_OF_RANGE if nthreads is not positive.
+ */
+CacheResult cacheParallelForEach(Cache cache, VisitCacheCell visit, void *context,
+		int nthreads);
+
+/**
+ * Writes all elements of the cache to a snapshot file, so that a new cache
+ * can be warmed up from it by cacheRestore. The file is written under a
+ * temporary name and renamed when complete, so an existing snapshot is
+ * replaced only by a complete one.
+ *
+ * The format is a stream of records: 4 bytes magic "CSNP", 32-bit version,
+ * then for each element its encoding prefixed by 32-bit length, and length
+ * 0xffffffff at the end. All numbers are little endian.
+ *
+ * @param cache - cache to write.
+ * @param path - path of snapshot file.
+ * @param encode - callback writing encoding of element to buffer of given
+ * size and returning its length. If the encoding is longer than size, it
+ * returns the length only and is called again with a large enough buffer.
+ * Negative length is an error.
+ *
+ * @return Result code, CACHE_IO_ERROR if encoding or writing failed.
+ */
+CacheResult cacheSnapshot(Cache cache, const char *path, EncodeCacheElement encode);
+
+/**
+ * Adds all elements of a snapshot file to the cache. Elements already in the
+ * cache are kept. Elements pushed with ttl are restored without it.
+ *
+ * @param cache - cache to add the elements to.
+ * @param path - path of snapshot file.
+ * @param decode - callback creating element from its encoding, or returning
+ * NULL on allocation failure. The cache adds a copy of the element and
+ * destroys it with its free callback.
+ *
+ * @return Result code, CACHE_IO_ERROR if the file cannot be read or is not
+ * a complete snapshot. Elements read before an error stay in the cache.
+ * A background restore in progress is finished first, its result is kept for
+ * cacheRestoreWait and not returned here.
+ */
+CacheResult cacheRestore(Cache cache, const char *path, DecodeCacheElement decode);
+
+/**
+ * Starts restoring a snapshot file in background, so the cache can serve
+ * requests while it is warming up. A thread reads and decodes the elements,
+ * and every cache operation adds a few of them to the cache. Since restored
+ * elements keep arriving, an element removed during restore may come back.
+ * The decode callback is called from the background thread.
+ *
+ * @param cache - cache to add the elements to.
+ * @param path - path of snapshot file.
+ * @param decode - same as for cacheRestore.
+ *
+ * @return Result code of starting the restore, CACHE_IO_ERROR if the file
+ * cannot be opened or is not a snapshot.
+ */
+CacheResult cacheRestoreAsync(Cache cache, const char *path, DecodeCacheElement decode);
+
+/**
+ * Waits until background restore adds all elements to the cache.
+ *
+ * @param cache - cache being restored.
+ *
+ * @return Result code of the last background restore, as cacheRestore would
+ * return it. CACHE_SUCCESS if there was none.
+ */
+CacheResult cacheRestoreWait(Cache cache);
+
 /**
  * Clears a cache - frees its all elements.
  * 
@@ -149,6 +686,69 @@ CacheResult cacheClear(Cache cache);
 void cacheDestroy(Cache cache);
 
 
+#ifdef CACHE_STATS
+/** Number of buckets in statistics histograms, the last one counts the rest */
+#define CACHE_STATS_HISTOGRAM_SIZE (16)
+
+/**
+ * Cache usage statistics, available when compiled with CACHE_STATS defined.
+ * Statistics build is not thread safe, and cells given out by the cache may
+ * be iterated, but not searched or changed by set functions.
+ */
+typedef struct CacheStats_t {
+	long pushes;
+	long isIns;
+	long extracts;
+	long frees;
+	/** results of cacheIsIn */
+	long hits;
+	long misses;
+	/** element lookups in cells and comparator calls made by cache */
+	long lookups;
+	long comparisons;
+	/** number of lookups by number of comparator calls they took */
+	long probeHistogram[CACHE_STATS_HISTOGRAM_SIZE];
+} CacheStats;
+
+/** Output formats of statistics dump */
+typedef enum CacheStatsFormat_t {
+	CACHE_STATS_JSON,
+	CACHE_STATS_CSV
+} CacheStatsFormat;
+
+/**
+ * Retrieves statistics gathered since cache creation or last reset.
+ *
+ * @param cache - cache to examine.
+ * @param stats - structure to fill.
+ *
+ * @return Result code.
+ */
+CacheResult cacheGetStats(Cache cache, CacheStats *stats);
+
+/**
+ * Sets all statistics counters to zero.
+ *
+ * @param cache - cache to reset statistics of.
+ *
+ * @return Result code.
+ */
+CacheResult cacheResetStats(Cache cache);
+
+/**
+ * Writes statistics together with histogram of cell occupancy (number of
+ * cells by number of elements they hold).
+ *
+ * @param cache - cache to examine.
+ * @param output - stream to write to.
+ * @param format - CACHE_STATS_JSON for a single json object,
+ * CACHE_STATS_CSV for "metric,value" lines.
+ *
+ * @return Result code, CACHE_IO_ERROR if writing failed.
+ */
+CacheResult cacheDumpStats(Cache cache, FILE *output, CacheStatsFormat format);
+#endif
+
 /**
  * Macro for iterating over a cache.
  *
@@ -175,4 +775,16 @@ void cacheDestroy(Cache cache);
 		iterator ;\
 		iterator = cacheGetNext(cache))
 
+/**
+ * Macro for iterating over cells of a cache with external cursor, which must
+ * be initialized by cacheCursorInit or cacheCursorInitRange.
+ *
+ * @param iterator - name of variable to hold each non empty cell.
+ * @param cursor - pointer to the cursor.
+ */
+#define CACHE_CURSOR_FOREACH(iterator, cursor) \
+	for(Set iterator = cacheCursorNext(cursor) ; \
+		iterator ;\
+		iterator = cacheCursorNext(cursor))
+
 #endif /* CACHE_H_ */
@@ -1,4 +1,5 @@
 #include "test_utilities.h"
+#include <pthread.h>
 #include <stdlib.h>
 #include "../cache.h"
 #include <string.h>
@@ -348,6 +349,1091 @@ static bool testCacheClear(void) {
 	return true;
 }
 
+/** fills cache with several elements per cell, and walks it to fill iteration cells */
+static bool fillCells(Cache cache, char **elements, int size) {
+	for (int i = 0; i < size; ++i) {
+		ASSERT_TEST(cachePush(cache, elements[i]) == CACHE_SUCCESS);
+	}
+	int found = 0;
+	CACHE_FOREACH(cell, cache) {
+		found += setGetSize(cell);
+	}
+	ASSERT_TEST(found == size);
+	return true;
+}
+
+static bool testCacheClearDestroy(void) {
+	// cells are cleared and destroyed with several elements each, through
+	// all kinds of caches
+	Cache (*creators[])(int, FreeCacheElement, CopyCacheElement,
+			CompareCacheElements, ComputeCacheKey) = {
+		cacheCreate, cacheCreatePool, cacheCreateConcurrent
+	};
+	char *elements[] = { "Lumen", "Louna", "Linkin park", "Lacuna Coil", "Rammstein", "Ramones" };
+	const int ELEMENTS_SIZE = sizeof(elements) / sizeof(*elements);
+	for (int c = 0; c < (int)(sizeof(creators) / sizeof(*creators)); ++c) {
+		Cache cache = creators[c](256, freeString, copyString, compareStrings, getFirstLetter);
+		ASSERT_TEST(cache != NULL);
+		ASSERT_TEST(fillCells(cache, elements, ELEMENTS_SIZE));
+		ASSERT_TEST(cacheClear(cache) == CACHE_SUCCESS);
+		for (int i = 0; i < ELEMENTS_SIZE; ++i) {
+			ASSERT_TEST(!cacheIsIn(cache, elements[i]));
+		}
+		ASSERT_TEST(fillCells(cache, elements, ELEMENTS_SIZE));
+		cacheDestroy(cache);
+	}
+	return true;
+}
+
+static uint64_t hashInt(CacheElement element) {
+	return (uint64_t)INT(element);
+}
+
+static bool testCacheResizable(void) {
+	ASSERT_TEST(!cacheCreateResizable(0, freeInt, copyInt, compareInt, hashInt));
+	ASSERT_TEST(!cacheCreateResizable(4, freeInt, copyInt, compareInt, NULL));
+
+	Cache cache = cacheCreateResizable(3, freeInt, copyInt, compareInt, hashInt);
+	ASSERT_TEST(cache != NULL);
+	ASSERT_TEST(cacheGetSize(cache) == 4);
+	ASSERT_TEST(cacheGetSize(NULL) == -1);
+
+	const int ELEMENTS = 1000;
+	for (int i = 0; i < ELEMENTS; ++i) {
+		ASSERT_TEST(cachePush(cache, &i) == CACHE_SUCCESS);
+		ASSERT_TEST(cachePush(cache, &i) == CACHE_ITEM_ALREADY_EXISTS);
+		// every element stays reachable while cells are moved
+		for (int j = 0; j <= i; j += 37) {
+			ASSERT_TEST(cacheIsIn(cache, &j));
+		}
+	}
+	ASSERT_TEST(cacheGetSize(cache) >= ELEMENTS / 2);
+
+	int counted = 0;
+	CACHE_FOREACH(set, cache) {
+		counted += setGetSize(set);
+	}
+	ASSERT_TEST(counted == ELEMENTS);
+
+	for (int i = 0; i < ELEMENTS; i += 2) {
+		ASSERT_TEST(cacheFreeElement(cache, &i) == CACHE_SUCCESS);
+		ASSERT_TEST(!cacheIsIn(cache, &i));
+	}
+	// cache shrinks while extracting, which changes keys
+	for (bool extractedAny = true; extractedAny; ) {
+		extractedAny = false;
+		for (int key = 0; key < cacheGetSize(cache); ++key) {
+			int *extracted;
+			while ((extracted = cacheExtractElementByKey(cache, key)) != NULL) {
+				ASSERT_TEST(INT(extracted) % 2 == 1);
+				ASSERT_TEST(!cacheIsIn(cache, extracted));
+				freeInt(extracted);
+				extractedAny = true;
+			}
+		}
+	}
+	for (int i = 0; i < ELEMENTS; ++i) {
+		ASSERT_TEST(!cacheIsIn(cache, &i));
+	}
+	ASSERT_TEST(cacheGetSize(cache) < ELEMENTS / 2);
+
+	for (int i = 0; i < ELEMENTS; ++i) {
+		ASSERT_TEST(cachePush(cache, &i) == CACHE_SUCCESS);
+	}
+	ASSERT_TEST(cacheClear(cache) == CACHE_SUCCESS);
+	for (int i = 0; i < ELEMENTS; ++i) {
+		ASSERT_TEST(!cacheIsIn(cache, &i));
+	}
+	cacheDestroy(cache);
+	return true;
+}
+
+/** FNV-1a hash of a string */
+static uint64_t hashString(CacheElement element) {
+	uint64_t hash = 14695981039346656037ULL;
+	for (const unsigned char *c = element; *c != '\0'; ++c) {
+		hash = (hash ^ *c) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+static bool testCacheBloomFilter(void) {
+	Cache cache = cacheCreate(256, freeString, copyString, compareStrings, getFirstLetter);
+	ASSERT_TEST(cache != NULL);
+	char *before = "Ramones";
+	ASSERT_TEST(cachePush(cache, before) == CACHE_SUCCESS);
+
+	ASSERT_TEST(cacheEnableBloomFilter(NULL, hashString, 100) == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(cacheEnableBloomFilter(cache, NULL, 100) == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(cacheEnableBloomFilter(cache, hashString, 0) == CACHE_OUT_OF_RANGE);
+	ASSERT_TEST(cacheEnableBloomFilter(cache, hashString, 100) == CACHE_SUCCESS);
+	// elements pushed before filter are still found
+	ASSERT_TEST(cacheIsIn(cache, before));
+	ASSERT_TEST(cachePush(cache, before) == CACHE_ITEM_ALREADY_EXISTS);
+
+	char * elements[] = {
+			"Lumen",
+			"Louna",
+			"Arch Enemy",
+			"Linkin park",
+			"Lacuna Coil"
+	};
+	const int ELEMENTS_SIZE = sizeof(elements) / sizeof(*elements);
+	for (int i = 0; i < ELEMENTS_SIZE; ++i) {
+		ASSERT_TEST(!cacheIsIn(cache, elements[i]));
+		ASSERT_TEST(cacheFreeElement(cache, elements[i]) == CACHE_ITEM_DOES_NOT_EXIST);
+		ASSERT_TEST(cachePush(cache, elements[i]) == CACHE_SUCCESS);
+		ASSERT_TEST(cacheIsIn(cache, elements[i]));
+	}
+
+	// removed elements are not found anymore
+	ASSERT_TEST(cacheFreeElement(cache, elements[0]) == CACHE_SUCCESS);
+	ASSERT_TEST(!cacheIsIn(cache, elements[0]));
+	char *extracted = cacheExtractElementByKey(cache, 'A');
+	ASSERT_TEST(strcmp(extracted, "Arch Enemy") == 0);
+	ASSERT_TEST(!cacheIsIn(cache, extracted));
+	ASSERT_TEST(cachePush(cache, extracted) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheIsIn(cache, extracted));
+	freeString(extracted);
+
+	ASSERT_TEST(cacheClear(cache) == CACHE_SUCCESS);
+	for (int i = 0; i < ELEMENTS_SIZE; ++i) {
+		ASSERT_TEST(!cacheIsIn(cache, elements[i]));
+		ASSERT_TEST(cachePush(cache, elements[i]) == CACHE_SUCCESS);
+		ASSERT_TEST(cacheIsIn(cache, elements[i]));
+	}
+	ASSERT_TEST(!cacheIsIn(cache, before));
+	cacheDestroy(cache);
+	return true;
+}
+
+static bool testCacheBatch(void) {
+	Cache cache = cacheCreate(255, freeString, copyString, compareStrings, getFirstLetter);
+	ASSERT_TEST(cache != NULL);
+
+	char outOfRange[2] = { (char)255, '\0' };
+	CacheElement elements[] = {
+			"Ramones",
+			"Lumen",
+			"Louna",
+			NULL,
+			outOfRange,
+			"Lumen",
+			"Arch Enemy"
+	};
+	const int ELEMENTS_SIZE = sizeof(elements) / sizeof(*elements);
+	CacheResult results[ELEMENTS_SIZE];
+	ASSERT_TEST(cachePushBatch(NULL, elements, ELEMENTS_SIZE, results) == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(cachePushBatch(cache, elements, ELEMENTS_SIZE, NULL) == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(cachePushBatch(cache, elements, -1, results) == CACHE_OUT_OF_RANGE);
+	ASSERT_TEST(cachePushBatch(cache, elements, ELEMENTS_SIZE, results) == CACHE_SUCCESS);
+	ASSERT_TEST(results[0] == CACHE_SUCCESS);
+	ASSERT_TEST(results[1] == CACHE_SUCCESS);
+	ASSERT_TEST(results[2] == CACHE_SUCCESS);
+	ASSERT_TEST(results[3] == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(results[4] == CACHE_OUT_OF_RANGE);
+	// the first of equal elements is added
+	ASSERT_TEST(results[5] == CACHE_ITEM_ALREADY_EXISTS);
+	ASSERT_TEST(results[6] == CACHE_SUCCESS);
+
+	CacheElement probes[] = { "Louna", "Rock", NULL, "Ramones", outOfRange };
+	const int PROBES_SIZE = sizeof(probes) / sizeof(*probes);
+	bool found[PROBES_SIZE];
+	ASSERT_TEST(cacheIsInBatch(cache, probes, PROBES_SIZE, NULL) == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(cacheIsInBatch(cache, probes, PROBES_SIZE, found) == CACHE_SUCCESS);
+	ASSERT_TEST(found[0] && !found[1] && !found[2] && found[3] && !found[4]);
+
+	CacheElement extracted[3];
+	ASSERT_TEST(cacheExtractBatch(NULL, 'L', 3, extracted) == -1);
+	ASSERT_TEST(cacheExtractBatch(cache, 'L', 3, NULL) == -1);
+	ASSERT_TEST(cacheExtractBatch(cache, 'L', 0, extracted) == 0);
+	ASSERT_TEST(cacheExtractBatch(cache, 'L', 3, extracted) == 2);
+	ASSERT_TEST(strcmp(extracted[0], "Louna") == 0);
+	ASSERT_TEST(strcmp(extracted[1], "Lumen") == 0);
+	ASSERT_TEST(!cacheIsIn(cache, "Lumen"));
+	freeString(extracted[0]);
+	freeString(extracted[1]);
+	ASSERT_TEST(cacheExtractBatch(cache, 'R', 3, extracted) == 1);
+	freeString(extracted[0]);
+	ASSERT_TEST(cacheExtractBatch(cache, 255, 3, extracted) == 0);
+
+	cacheDestroy(cache);
+	return true;
+}
+
+static bool testCacheBatchResizable(void) {
+	Cache cache = cacheCreateResizable(1, freeInt, copyInt, compareInt, hashInt);
+	ASSERT_TEST(cache != NULL);
+
+	const int BATCH = 300;
+	int values[BATCH];
+	CacheElement elements[BATCH];
+	CacheResult results[BATCH];
+	bool found[BATCH];
+	for (int i = 0; i < BATCH; ++i) {
+		values[i] = (i * 7919) % BATCH;
+		elements[i] = values + i;
+	}
+	// cache grows in the middle of the batch
+	ASSERT_TEST(cachePushBatch(cache, elements, BATCH, results) == CACHE_SUCCESS);
+	for (int i = 0; i < BATCH; ++i) {
+		ASSERT_TEST(results[i] == CACHE_SUCCESS);
+	}
+	ASSERT_TEST(cacheGetSize(cache) > 1);
+	ASSERT_TEST(cacheIsInBatch(cache, elements, BATCH, found) == CACHE_SUCCESS);
+	for (int i = 0; i < BATCH; ++i) {
+		ASSERT_TEST(found[i]);
+		values[i] += BATCH;
+	}
+	ASSERT_TEST(cacheIsInBatch(cache, elements, BATCH, found) == CACHE_SUCCESS);
+	for (int i = 0; i < BATCH; ++i) {
+		ASSERT_TEST(!found[i]);
+	}
+	cacheDestroy(cache);
+	return true;
+}
+
+static bool testCacheProbes(void) {
+	const int ELEMENTS = 100;
+	int values[ELEMENTS];
+	CacheElement elements[ELEMENTS + 1];
+	bool found[ELEMENTS + 1];
+	for (int i = 0; i < ELEMENTS; ++i) {
+		values[i] = i * 3;
+		elements[i] = values + i;
+	}
+	elements[ELEMENTS] = NULL;
+	Cache caches[] = {
+			cacheCreate(BASE, freeInt, copyInt, compareInt, getLastDigit),
+			cacheCreateResizable(1, freeInt, copyInt, compareInt, hashInt),
+			cacheCreatePool(BASE, freeInt, copyInt, compareInt, getLastDigit),
+			cacheCreateConcurrent(BASE, freeInt, copyInt, compareInt, getLastDigit)
+	};
+	const int CACHES_SIZE = sizeof(caches) / sizeof(*caches);
+	for (int c = 0; c < CACHES_SIZE; ++c) {
+		Cache cache = caches[c];
+		ASSERT_TEST(cache != NULL);
+		ASSERT_TEST(cacheIsInProbes(NULL, elements, ELEMENTS, found) == CACHE_NULL_ARGUMENT);
+		ASSERT_TEST(cacheIsInProbes(cache, elements, -1, found) == CACHE_OUT_OF_RANGE);
+		ASSERT_TEST(cacheIsInProbes(cache, elements, 0, NULL) == CACHE_NULL_ARGUMENT);
+		// every other element, so that some cells hold both found and missing ones
+		for (int i = 0; i < ELEMENTS; i += 2) {
+			ASSERT_TEST(cachePush(cache, elements[i]) == CACHE_SUCCESS);
+		}
+		ASSERT_TEST(cacheIsInProbes(cache, elements, ELEMENTS + 1, found) == CACHE_SUCCESS);
+		for (int i = 0; i < ELEMENTS; ++i) {
+			ASSERT_TEST(found[i] == (i % 2 == 0));
+		}
+		ASSERT_TEST(!found[ELEMENTS]);
+		// fewer probes than lookups in flight
+		ASSERT_TEST(cacheIsInProbes(cache, elements + 1, 2, found) == CACHE_SUCCESS);
+		ASSERT_TEST(!found[0] && found[1]);
+		cacheDestroy(cache);
+	}
+	return true;
+}
+
+static bool testCacheAdmission(void) {
+	Cache cache = cacheCreate(BASE, freeInt, copyInt, compareInt, getLastDigit);
+	ASSERT_TEST(cache != NULL);
+	ASSERT_TEST(cacheSetCapacity(NULL, 1) == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(cacheSetCapacity(cache, -1) == CACHE_OUT_OF_RANGE);
+	ASSERT_TEST(cacheEnableAdmissionFilter(cache, hashInt) == CACHE_OUT_OF_RANGE);
+	int elements[] = { 1, 2, 11, 4 };
+	for (int i = 0; i < 3; ++i) {
+		ASSERT_TEST(cachePush(cache, elements + i) == CACHE_SUCCESS);
+	}
+	ASSERT_TEST(cacheSetCapacity(cache, 2) == CACHE_OUT_OF_RANGE);
+	ASSERT_TEST(cacheSetCapacity(cache, 3) == CACHE_SUCCESS);
+
+	// cell 4 is empty, so the victim comes from the next non empty cell
+	ASSERT_TEST(cachePush(cache, elements + 3) == CACHE_SUCCESS);
+	ASSERT_TEST(!cacheIsIn(cache, elements) && cacheIsIn(cache, elements + 2));
+	ASSERT_TEST(cacheIsIn(cache, elements + 1) && cacheIsIn(cache, elements + 3));
+
+	// a rarely seen element does not replace a popular one
+	ASSERT_TEST(cacheEnableAdmissionFilter(cache, NULL) == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(cacheEnableAdmissionFilter(cache, hashInt) == CACHE_SUCCESS);
+	for (int i = 0; i < 3; ++i) {
+		ASSERT_TEST(cacheIsIn(cache, elements + 1));
+		ASSERT_TEST(cacheIsIn(cache, elements + 2));
+		ASSERT_TEST(cacheIsIn(cache, elements + 3));
+	}
+	int rare = 5;
+	ASSERT_TEST(cachePush(cache, &rare) == CACHE_ITEM_REJECTED);
+	ASSERT_TEST(!cacheIsIn(cache, &rare));
+	for (int i = 0; i < 5; ++i) {
+		ASSERT_TEST(!cacheIsIn(cache, &rare));
+	}
+	ASSERT_TEST(cachePush(cache, &rare) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheIsIn(cache, &rare));
+	ASSERT_TEST(cacheIsIn(cache, elements + 1) + cacheIsIn(cache, elements + 2) +
+			cacheIsIn(cache, elements + 3) == 2);
+
+	ASSERT_TEST(cacheSetCapacity(cache, 0) == CACHE_SUCCESS);
+	ASSERT_TEST(cachePush(cache, elements) == CACHE_SUCCESS);
+	cacheDestroy(cache);
+	return true;
+}
+
+#define TEST_PARALLEL_ELEMENTS (1000)
+#define TEST_PARALLEL_THREADS (4)
+
+typedef struct ParallelCount_t {
+	int elements[TEST_PARALLEL_THREADS];
+	long sums[TEST_PARALLEL_THREADS];
+} ParallelCount;
+
+static void countCell(Set cell, int worker, void *context) {
+	ParallelCount *count = context;
+	SET_FOREACH(int*, it, cell) {
+		++count->elements[worker];
+		count->sums[worker] += INT(it);
+	}
+}
+
+static bool testCacheParallelForEach(void) {
+	Cache cache = cacheCreateResizable(1, freeInt, copyInt, compareInt, hashInt);
+	ASSERT_TEST(cache != NULL);
+	long expectedSum = 0;
+	for (int i = 0; i < TEST_PARALLEL_ELEMENTS; ++i) {
+		ASSERT_TEST(cachePush(cache, &i) == CACHE_SUCCESS);
+		expectedSum += i;
+	}
+	ParallelCount count = { { 0 }, { 0 } };
+	ASSERT_TEST(cacheParallelForEach(NULL, countCell, &count, 1) == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(cacheParallelForEach(cache, NULL, &count, 1) == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(cacheParallelForEach(cache, countCell, &count, 0) == CACHE_OUT_OF_RANGE);
+	ASSERT_TEST(cacheParallelForEach(cache, countCell, &count,
+			TEST_PARALLEL_THREADS) == CACHE_SUCCESS);
+	int elements = 0;
+	long sum = 0;
+	for (int i = 0; i < TEST_PARALLEL_THREADS; ++i) {
+		elements += count.elements[i];
+		sum += count.sums[i];
+	}
+	ASSERT_TEST(elements == TEST_PARALLEL_ELEMENTS && sum == expectedSum);
+
+	// cursors do not disturb internal iterator nor each other
+	CacheCursor cursor;
+	ASSERT_TEST(cacheCursorInit(NULL, &cursor) == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(cacheCursorInit(cache, NULL) == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(cacheCursorInitRange(cache, &cursor, 1, 0) == CACHE_OUT_OF_RANGE);
+	ASSERT_TEST(cacheCursorInitRange(cache, &cursor, 0,
+			cacheGetSize(cache) + 1) == CACHE_OUT_OF_RANGE);
+	ASSERT_TEST(cacheCursorNext(NULL) == NULL);
+	int half = cacheGetSize(cache) / 2;
+	elements = 0;
+	Set first = cacheGetFirst(cache);
+	CacheCursor low, high;
+	ASSERT_TEST(cacheCursorInitRange(cache, &low, 0, half) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheCursorInitRange(cache, &high, half, cacheGetSize(cache)) == CACHE_SUCCESS);
+	CACHE_CURSOR_FOREACH(cell, &low) {
+		elements += setGetSize(cell);
+		Set other = cacheCursorNext(&high);
+		if (other != NULL) {
+			elements += setGetSize(other);
+		}
+	}
+	CACHE_CURSOR_FOREACH(cell, &high) {
+		elements += setGetSize(cell);
+	}
+	ASSERT_TEST(elements == TEST_PARALLEL_ELEMENTS);
+	ASSERT_TEST(cacheGetCurrent(cache) == first);
+	cacheDestroy(cache);
+	return true;
+}
+
+static int encodeString(CacheElement element, unsigned char *buffer, int size) {
+	int length = strlen(element);
+	if (length <= size) {
+		memcpy(buffer, element, length);
+	}
+	return length;
+}
+
+static int encodeFailure(CacheElement element, unsigned char *buffer, int size) {
+	return -1;
+}
+
+static CacheElement decodeString(const unsigned char *buffer, int length) {
+	char *string = malloc(length + 1);
+	if (string != NULL) {
+		memcpy(string, buffer, length);
+		string[length] = '\0';
+	}
+	return string;
+}
+
+static int encodeInt(CacheElement element, unsigned char *buffer, int size) {
+	if (size >= (int)sizeof(int)) {
+		memcpy(buffer, element, sizeof(int));
+	}
+	return sizeof(int);
+}
+
+static CacheElement decodeInt(const unsigned char *buffer, int length) {
+	if (length != sizeof(int)) {
+		return NULL;
+	}
+	int value;
+	memcpy(&value, buffer, sizeof(value));
+	return copyInt(&value);
+}
+
+#define TEST_SNAPSHOT_PATH "cache_test_snapshot.bin"
+#define TEST_SNAPSHOT_TRUNCATED_PATH "cache_test_snapshot_truncated.bin"
+#define TEST_SNAPSHOT_LONG_STRING (1000)
+#define TEST_SNAPSHOT_ELEMENTS (5000)
+
+static bool testCacheSnapshot(void) {
+	char longString[TEST_SNAPSHOT_LONG_STRING + 1];
+	memset(longString, 'x', TEST_SNAPSHOT_LONG_STRING);
+	longString[TEST_SNAPSHOT_LONG_STRING] = '\0';
+	char *strings[] = { "Hello", "", longString, "Goodbye" };
+	const int STRINGS_SIZE = sizeof(strings) / sizeof(*strings);
+	Cache cache = cacheCreate(256, freeString, copyString, compareStrings, getFirstLetter);
+	ASSERT_TEST(cache != NULL);
+	for (int i = 0; i < STRINGS_SIZE; ++i) {
+		ASSERT_TEST(cachePush(cache, strings[i]) == CACHE_SUCCESS);
+	}
+	ASSERT_TEST(cacheSnapshot(NULL, TEST_SNAPSHOT_PATH, encodeString) == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(cacheSnapshot(cache, TEST_SNAPSHOT_PATH, encodeString) == CACHE_SUCCESS);
+	// failed snapshot leaves the previous one
+	ASSERT_TEST(cacheSnapshot(cache, TEST_SNAPSHOT_PATH, encodeFailure) == CACHE_IO_ERROR);
+	cacheDestroy(cache);
+
+	cache = cacheCreate(256, freeString, copyString, compareStrings, getFirstLetter);
+	ASSERT_TEST(cache != NULL);
+	ASSERT_TEST(cachePush(cache, strings[0]) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheRestore(cache, NULL, decodeString) == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(cacheRestore(cache, "no_such_snapshot.bin", decodeString) == CACHE_IO_ERROR);
+	ASSERT_TEST(cacheRestore(cache, TEST_SNAPSHOT_PATH, decodeString) == CACHE_SUCCESS);
+	for (int i = 0; i < STRINGS_SIZE; ++i) {
+		ASSERT_TEST(cacheIsIn(cache, strings[i]));
+	}
+	cacheDestroy(cache);
+
+	// truncated snapshot
+	FILE *file = fopen(TEST_SNAPSHOT_PATH, "rb");
+	ASSERT_TEST(file != NULL);
+	unsigned char head[20];
+	ASSERT_TEST(fread(head, 1, sizeof(head), file) == sizeof(head));
+	fclose(file);
+	file = fopen(TEST_SNAPSHOT_PATH, "wb");
+	ASSERT_TEST(file != NULL);
+	ASSERT_TEST(fwrite(head, 1, sizeof(head), file) == sizeof(head));
+	fclose(file);
+	cache = cacheCreate(256, freeString, copyString, compareStrings, getFirstLetter);
+	ASSERT_TEST(cache != NULL);
+	ASSERT_TEST(cacheRestore(cache, TEST_SNAPSHOT_PATH, decodeString) == CACHE_IO_ERROR);
+	// the empty string comes first (cell 0), and is read before the error
+	ASSERT_TEST(cacheIsIn(cache, strings[1]));
+	cacheDestroy(cache);
+
+	// background restore while cache serves requests
+	cache = cacheCreateResizable(1, freeInt, copyInt, compareInt, hashInt);
+	ASSERT_TEST(cache != NULL);
+	for (int i = 0; i < TEST_SNAPSHOT_ELEMENTS; ++i) {
+		ASSERT_TEST(cachePush(cache, &i) == CACHE_SUCCESS);
+	}
+	ASSERT_TEST(cacheSnapshot(cache, TEST_SNAPSHOT_PATH, encodeInt) == CACHE_SUCCESS);
+	cacheDestroy(cache);
+	cache = cacheCreateResizable(1, freeInt, copyInt, compareInt, hashInt);
+	ASSERT_TEST(cache != NULL);
+	ASSERT_TEST(cacheRestoreWait(cache) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheRestoreAsync(cache, "no_such_snapshot.bin", decodeInt) == CACHE_IO_ERROR);
+	ASSERT_TEST(cacheRestoreAsync(cache, TEST_SNAPSHOT_PATH, decodeInt) == CACHE_SUCCESS);
+	int last = TEST_SNAPSHOT_ELEMENTS - 1;
+	for (int i = 0; i < TEST_SNAPSHOT_ELEMENTS && !cacheIsIn(cache, &last); ++i) {
+		int missing = -1;
+		ASSERT_TEST(!cacheIsIn(cache, &missing));
+	}
+	ASSERT_TEST(cacheRestoreWait(cache) == CACHE_SUCCESS);
+	for (int i = 0; i < TEST_SNAPSHOT_ELEMENTS; ++i) {
+		ASSERT_TEST(cacheIsIn(cache, &i));
+	}
+	cacheDestroy(cache);
+
+	// restore started while a background one is pending finishes it, the
+	// background result is left for cacheRestoreWait
+	file = fopen(TEST_SNAPSHOT_PATH, "rb");
+	ASSERT_TEST(file != NULL);
+	ASSERT_TEST(fread(head, 1, sizeof(head), file) == sizeof(head));
+	fclose(file);
+	file = fopen(TEST_SNAPSHOT_TRUNCATED_PATH, "wb");
+	ASSERT_TEST(file != NULL);
+	ASSERT_TEST(fwrite(head, 1, sizeof(head), file) == sizeof(head));
+	fclose(file);
+	cache = cacheCreateResizable(1, freeInt, copyInt, compareInt, hashInt);
+	ASSERT_TEST(cache != NULL);
+	ASSERT_TEST(cacheRestoreAsync(cache, TEST_SNAPSHOT_TRUNCATED_PATH, decodeInt) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheRestore(cache, TEST_SNAPSHOT_PATH, decodeInt) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheRestoreWait(cache) == CACHE_IO_ERROR);
+	ASSERT_TEST(cacheRestoreWait(cache) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheIsIn(cache, &last));
+	cacheDestroy(cache);
+	ASSERT_TEST(remove(TEST_SNAPSHOT_TRUNCATED_PATH) == 0);
+
+	// destroying cache stops restore
+	cache = cacheCreateResizable(1, freeInt, copyInt, compareInt, hashInt);
+	ASSERT_TEST(cache != NULL);
+	ASSERT_TEST(cacheRestoreAsync(cache, TEST_SNAPSHOT_PATH, decodeInt) == CACHE_SUCCESS);
+	cacheDestroy(cache);
+	ASSERT_TEST(remove(TEST_SNAPSHOT_PATH) == 0);
+	return true;
+}
+
+static uint64_t testClockTime;
+
+static uint64_t testClock(void) {
+	return testClockTime;
+}
+
+#ifndef CACHE_STATS
+#define TEST_CONCURRENT_LOOKUPS (200000)
+/** more readers than the cache has slots for */
+#define TEST_OVERFLOW_READERS (160)
+#define TEST_OVERFLOW_LOOKUPS (100000)
+
+typedef struct ConcurrentReader_t {
+	Cache cache;
+	int lookups;
+	bool failed;
+} ConcurrentReader;
+
+/** looks up elements which stay in cache all the time */
+static void *concurrentReaderMain(void *argument) {
+	ConcurrentReader *reader = argument;
+	for (int i = 0; i < reader->lookups; i += 2) {
+		int element = i % 1000;
+		if (!cacheIsIn(reader->cache, &element)) {
+			reader->failed = true;
+		}
+	}
+	return NULL;
+}
+
+/** looks up elements which stay in cache by batches, each keeping its slot long */
+static void *concurrentBatchReaderMain(void *argument) {
+	ConcurrentReader *reader = argument;
+	int elements[500];
+	bool results[500];
+	CacheElement batch[500];
+	for (int i = 0; i < 500; ++i) {
+		elements[i] = 2 * i;
+		batch[i] = elements + i;
+	}
+	for (int i = 0; i < reader->lookups; i += 500) {
+		if (cacheIsInProbes(reader->cache, batch, 500, results) != CACHE_SUCCESS) {
+			reader->failed = true;
+		}
+		for (int j = 0; j < 500; ++j) {
+			reader->failed |= !results[j];
+		}
+	}
+	return NULL;
+}
+#endif
+
+static bool testCacheConcurrent(void) {
+	ASSERT_TEST(!cacheCreateConcurrent(0, freeInt, copyInt, compareInt, getLastDigit));
+	ASSERT_TEST(!cacheCreateConcurrent(BASE, NULL, copyInt, compareInt, getLastDigit));
+	Cache cache = cacheCreateConcurrent(BASE, freeInt, copyInt, compareInt, getLastDigit);
+	ASSERT_TEST(cache != NULL);
+	int elements[] = { 21, 1, 11, 2 };
+	for (int i = 0; i < 4; ++i) {
+		ASSERT_TEST(cachePush(cache, elements + i) == CACHE_SUCCESS);
+	}
+	ASSERT_TEST(cachePush(cache, elements) == CACHE_ITEM_ALREADY_EXISTS);
+	int negative = -1;
+	ASSERT_TEST(cachePush(cache, &negative) == CACHE_OUT_OF_RANGE);
+	ASSERT_TEST(cachePushWithTTL(cache, elements, 1) == CACHE_NOT_SUPPORTED);
+	ASSERT_TEST(cacheSetClock(cache, testClock) == CACHE_NOT_SUPPORTED);
+	ASSERT_TEST(cacheSetElementSize(cache, NULL) == CACHE_NOT_SUPPORTED);
+	ASSERT_TEST(cacheGetMemoryUsage(cache) > 0);
+	int expected[] = { 1, 11, 21, 2 };
+	int count = 0;
+	CACHE_FOREACH(cell, cache) {
+		SET_FOREACH(int*, it, cell) {
+			ASSERT_TEST(count < 4 && INT(it) == expected[count]);
+			++count;
+		}
+	}
+	ASSERT_TEST(count == 4);
+
+	// extraction takes the smallest element of cell, as from a set
+	int *extracted = cacheExtractElementByKey(cache, 1);
+	ASSERT_TEST(extracted != NULL && *extracted == 1);
+	freeInt(extracted);
+	ASSERT_TEST(!cacheIsIn(cache, elements + 1) && cacheIsIn(cache, elements));
+	ASSERT_TEST(cacheFreeElement(cache, elements + 2) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheFreeElement(cache, elements + 2) == CACHE_ITEM_DOES_NOT_EXIST);
+	ASSERT_TEST(cacheClear(cache) == CACHE_SUCCESS);
+	ASSERT_TEST(!cacheIsIn(cache, elements) && cacheExtractElementByKey(cache, 2) == NULL);
+
+#ifndef CACHE_STATS
+	// readers always find even elements while odd ones come and go
+	for (int i = 0; i < 1000; i += 2) {
+		ASSERT_TEST(cachePush(cache, &i) == CACHE_SUCCESS);
+	}
+	ConcurrentReader readers[TEST_OVERFLOW_READERS];
+	pthread_t threads[TEST_OVERFLOW_READERS];
+	// then with readers left without a slot, which must not spin
+	int readersCounts[] = { TEST_PARALLEL_THREADS, TEST_OVERFLOW_READERS };
+	for (int phase = 0; phase < 2; ++phase) {
+		for (int i = 0; i < readersCounts[phase]; ++i) {
+			readers[i].cache = cache;
+			readers[i].lookups = phase == 0 ? TEST_CONCURRENT_LOOKUPS : TEST_OVERFLOW_LOOKUPS;
+			readers[i].failed = false;
+			ASSERT_TEST(pthread_create(threads + i, NULL,
+					phase == 0 ? concurrentReaderMain : concurrentBatchReaderMain,
+					readers + i) == 0);
+		}
+		for (int round = 0; round < 20; ++round) {
+			for (int i = 1; i < 1000; i += 2) {
+				ASSERT_TEST(cachePush(cache, &i) == CACHE_SUCCESS);
+			}
+			for (int i = 1; i < 1000; i += 2) {
+				ASSERT_TEST(cacheFreeElement(cache, &i) == CACHE_SUCCESS);
+			}
+		}
+		for (int i = 0; i < readersCounts[phase]; ++i) {
+			pthread_join(threads[i], NULL);
+			ASSERT_TEST(!readers[i].failed);
+		}
+	}
+#endif
+	cacheDestroy(cache);
+	return true;
+}
+
+static bool testCacheHashed(void) {
+	ASSERT_TEST(!cacheCreateHashed(0, freeInt, copyInt, compareInt, hashInt));
+	ASSERT_TEST(!cacheCreateHashed(4, freeInt, copyInt, compareInt, NULL));
+	Cache cache = cacheCreateHashed(100, freeInt, copyInt, compareInt, hashInt);
+	ASSERT_TEST(cache != NULL);
+	ASSERT_TEST(cacheGetSize(cache) == 128);
+
+	// aligned values share their low bits, still they spread over cells
+	const int ELEMENTS = 1000, ALIGNMENT = 4096;
+	for (int i = 0; i < ELEMENTS; ++i) {
+		int value = i * ALIGNMENT;
+		ASSERT_TEST(cachePush(cache, &value) == CACHE_SUCCESS);
+	}
+	ASSERT_TEST(cacheGetSize(cache) == 128);
+	int used = 0;
+	CACHE_FOREACH(cell, cache) {
+		used += setGetSize(cell) > 0;
+	}
+	ASSERT_TEST(used > cacheGetSize(cache) / 2);
+	int value = 3 * ALIGNMENT;
+	ASSERT_TEST(cacheIsIn(cache, &value));
+	ASSERT_TEST(cacheFreeElement(cache, &value) == CACHE_SUCCESS);
+	ASSERT_TEST(!cacheIsIn(cache, &value));
+
+	int extracted = 0;
+	for (int key = 0; key < cacheGetSize(cache); ++key) {
+		int *element;
+		while ((element = cacheExtractElementByKey(cache, key)) != NULL) {
+			ASSERT_TEST(*element % ALIGNMENT == 0);
+			freeInt(element);
+			++extracted;
+		}
+	}
+	ASSERT_TEST(extracted == ELEMENTS - 1);
+	ASSERT_TEST(cacheExtractElementByKey(cache, cacheGetSize(cache)) == NULL);
+	cacheDestroy(cache);
+	return true;
+}
+
+static long sizeString(CacheElement element) {
+	return strlen(element) + 1;
+}
+
+static bool testCacheMemoryBudget(void) {
+	Cache cache = cacheCreate(256, freeString, copyString, compareStrings, getFirstLetter);
+	ASSERT_TEST(cache != NULL);
+	ASSERT_TEST(cacheGetMemoryUsage(NULL) == -1);
+	long emptyUsage = cacheGetMemoryUsage(cache);
+	ASSERT_TEST(emptyUsage > 0);
+	ASSERT_TEST(cachePush(cache, "apple") == CACHE_SUCCESS);
+	ASSERT_TEST(cacheGetCellMemoryUsage(cache, 'a') == -1);
+	ASSERT_TEST(cacheSetElementSize(NULL, sizeString) == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(cacheSetElementSize(cache, sizeString) == CACHE_SUCCESS);
+	long appleBytes = cacheGetCellMemoryUsage(cache, 'a');
+	ASSERT_TEST(appleBytes > (long)sizeof("apple"));
+	ASSERT_TEST(cachePush(cache, "avocado") == CACHE_SUCCESS);
+	long avocadoBytes = cacheGetCellMemoryUsage(cache, 'a') - appleBytes;
+	ASSERT_TEST(avocadoBytes - appleBytes == (long)(sizeof("avocado") - sizeof("apple")));
+	ASSERT_TEST(cacheGetCellMemoryUsage(cache, 'b') == 0);
+	ASSERT_TEST(cacheGetCellMemoryUsage(cache, 256) == -1);
+	ASSERT_TEST(cacheGetMemoryUsage(cache) > emptyUsage + appleBytes + avocadoBytes);
+
+	// shared budget, the first cache rejects and the second one evicts
+	ASSERT_TEST(cacheBudgetCreate(0) == NULL);
+	CacheBudget budget = cacheBudgetCreate(appleBytes + avocadoBytes + appleBytes);
+	ASSERT_TEST(budget != NULL);
+	ASSERT_TEST(cacheSetBudget(cache, budget, CACHE_BUDGET_REJECT) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheBudgetGetUsage(budget) == appleBytes + avocadoBytes);
+	Cache other = cacheCreate(256, freeString, copyString, compareStrings, getFirstLetter);
+	ASSERT_TEST(other != NULL);
+	ASSERT_TEST(cacheSetElementSize(other, sizeString) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheSetBudget(other, budget, CACHE_BUDGET_EVICT) == CACHE_SUCCESS);
+	ASSERT_TEST(cachePush(cache, "avocado!") == CACHE_ITEM_REJECTED);
+	ASSERT_TEST(cachePush(other, "apples") == CACHE_ITEM_REJECTED);
+	ASSERT_TEST(cachePush(other, "peach") == CACHE_SUCCESS);
+	ASSERT_TEST(cachePush(cache, "berry") == CACHE_ITEM_REJECTED);
+	ASSERT_TEST(cacheFreeElement(cache, "avocado") == CACHE_SUCCESS);
+	ASSERT_TEST(cacheBudgetGetUsage(budget) == appleBytes * 2);
+	ASSERT_TEST(cachePush(other, "pear") == CACHE_SUCCESS);
+	ASSERT_TEST(cachePush(other, "plum-plum-plum") == CACHE_SUCCESS);
+	ASSERT_TEST(!cacheIsIn(other, "peach") && !cacheIsIn(other, "pear"));
+	ASSERT_TEST(cacheIsIn(other, "plum-plum-plum"));
+
+	// elements leaving caches return their bytes
+	ASSERT_TEST(cacheClear(cache) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheGetCellMemoryUsage(cache, 'a') == 0);
+	cacheDestroy(other);
+	ASSERT_TEST(cacheBudgetGetUsage(budget) == 0);
+	ASSERT_TEST(cachePush(cache, "apple") == CACHE_SUCCESS);
+	ASSERT_TEST(cacheSetBudget(cache, NULL, CACHE_BUDGET_REJECT) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheBudgetGetUsage(budget) == 0);
+	cacheBudgetDestroy(budget);
+	cacheDestroy(cache);
+
+	// totals follow elements while resizable cache migrates
+	cache = cacheCreateResizable(1, freeInt, copyInt, compareInt, hashInt);
+	ASSERT_TEST(cache != NULL);
+	ASSERT_TEST(cacheSetElementSize(cache, NULL) == CACHE_SUCCESS);
+	for (int i = 0; i < 100; ++i) {
+		ASSERT_TEST(cachePush(cache, &i) == CACHE_SUCCESS);
+	}
+	long total = 0;
+	for (int key = 0; key < cacheGetSize(cache); ++key) {
+		total += cacheGetCellMemoryUsage(cache, key);
+	}
+	for (int i = 0; i < 50; ++i) {
+		ASSERT_TEST(cacheFreeElement(cache, &i) == CACHE_SUCCESS);
+	}
+	long half = 0;
+	for (int key = 0; key < cacheGetSize(cache); ++key) {
+		half += cacheGetCellMemoryUsage(cache, key);
+	}
+	ASSERT_TEST(total > 0 && half * 2 == total);
+	cacheDestroy(cache);
+	return true;
+}
+
+#ifndef CACHE_STATS
+// pool cache is thread safe only without statistics
+#define TEST_POOL_OPERATIONS (20000)
+
+typedef struct PoolWorker_t {
+	Cache cache;
+	int first;
+	long poppedSum;
+} PoolWorker;
+
+/** pushes its own range of numbers, popping from some cell after each one */
+static void *poolWorkerMain(void *argument) {
+	PoolWorker *worker = argument;
+	for (int i = worker->first; i < worker->first + TEST_POOL_OPERATIONS; ++i) {
+		if (cachePush(worker->cache, &i) != CACHE_SUCCESS) {
+			worker->poppedSum = -1;
+			return NULL;
+		}
+		int *popped = cacheExtractElementByKey(worker->cache, i / 3 % BASE);
+		if (popped != NULL) {
+			worker->poppedSum += *popped;
+			freeInt(popped);
+		}
+	}
+	return NULL;
+}
+#endif
+
+static bool testCachePool(void) {
+	ASSERT_TEST(!cacheCreatePool(0, freeInt, copyInt, compareInt, getLastDigit));
+	ASSERT_TEST(!cacheCreatePool(BASE, freeInt, copyInt, compareInt, NULL));
+	Cache cache = cacheCreatePool(BASE, freeInt, copyInt, compareInt, getLastDigit);
+	ASSERT_TEST(cache != NULL);
+	int elements[] = { 21, 1, 11, 2 };
+	for (int i = 0; i < 4; ++i) {
+		ASSERT_TEST(cachePush(cache, elements + i) == CACHE_SUCCESS);
+	}
+	int negative = -1;
+	ASSERT_TEST(cachePush(cache, &negative) == CACHE_OUT_OF_RANGE);
+	ASSERT_TEST(cachePushWithTTL(cache, elements, 1) == CACHE_NOT_SUPPORTED);
+	ASSERT_TEST(cacheSetClock(cache, testClock) == CACHE_NOT_SUPPORTED);
+	ASSERT_TEST(cacheSetCapacity(cache, 10) == CACHE_NOT_SUPPORTED);
+	ASSERT_TEST(cacheEnableBloomFilter(cache, hashInt, 10) == CACHE_NOT_SUPPORTED);
+	CacheCursor cursor;
+	ASSERT_TEST(cacheCursorInit(cache, &cursor) == CACHE_NOT_SUPPORTED);
+
+	// iteration sees every cell sorted
+	int expected[] = { 1, 11, 21, 2 };
+	int count = 0;
+	CACHE_FOREACH(cell, cache) {
+		SET_FOREACH(int*, it, cell) {
+			ASSERT_TEST(count < 4 && INT(it) == expected[count]);
+			++count;
+		}
+	}
+	ASSERT_TEST(count == 4);
+	ASSERT_TEST(cacheIsIn(cache, elements + 2) && !cacheIsIn(cache, &negative));
+
+	// cells are stacks
+	ASSERT_TEST(cacheFreeElement(cache, elements + 1) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheFreeElement(cache, elements + 1) == CACHE_ITEM_DOES_NOT_EXIST);
+	int *extracted = cacheExtractElementByKey(cache, 1);
+	ASSERT_TEST(extracted != NULL && *extracted == 11);
+	freeInt(extracted);
+	extracted = cacheExtractElementByKey(cache, 1);
+	ASSERT_TEST(extracted != NULL && *extracted == 21);
+	freeInt(extracted);
+	ASSERT_TEST(cacheExtractElementByKey(cache, 1) == NULL);
+	ASSERT_TEST(cacheClear(cache) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheExtractElementByKey(cache, 2) == NULL);
+
+#ifndef CACHE_STATS
+	// concurrent pushes and pops lose and duplicate nothing
+	PoolWorker workers[TEST_PARALLEL_THREADS];
+	pthread_t threads[TEST_PARALLEL_THREADS];
+	for (int i = 0; i < TEST_PARALLEL_THREADS; ++i) {
+		workers[i].cache = cache;
+		workers[i].first = i * TEST_POOL_OPERATIONS;
+		workers[i].poppedSum = 0;
+		ASSERT_TEST(pthread_create(threads + i, NULL, poolWorkerMain, workers + i) == 0);
+	}
+	long sum = 0;
+	for (int i = 0; i < TEST_PARALLEL_THREADS; ++i) {
+		pthread_join(threads[i], NULL);
+		ASSERT_TEST(workers[i].poppedSum >= 0);
+		sum += workers[i].poppedSum;
+	}
+	for (int key = 0; key < BASE; ++key) {
+		while ((extracted = cacheExtractElementByKey(cache, key)) != NULL) {
+			sum += *extracted;
+			freeInt(extracted);
+		}
+	}
+	long total = (long)TEST_PARALLEL_THREADS * TEST_POOL_OPERATIONS;
+	ASSERT_TEST(sum == total * (total - 1) / 2);
+#endif
+	cacheDestroy(cache);
+	return true;
+}
+
+static bool testCacheTTL(void) {
+	Cache cache = cacheCreate(BASE, freeInt, copyInt, compareInt, getLastDigit);
+	ASSERT_TEST(cache != NULL);
+	int elements[] = { 1, 2, 3, 4, 5 };
+	ASSERT_TEST(cachePushWithTTL(NULL, elements, 1) == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(cachePushWithTTL(cache, elements, 0) == CACHE_OUT_OF_RANGE);
+	ASSERT_TEST(cacheExpire(NULL, 0) == CACHE_NULL_ARGUMENT);
+
+	ASSERT_TEST(cachePushWithTTL(cache, elements, 10) == CACHE_SUCCESS);
+	ASSERT_TEST(cachePushWithTTL(cache, elements, 10) == CACHE_ITEM_ALREADY_EXISTS);
+	ASSERT_TEST(cachePushWithTTL(cache, elements + 1, 300) == CACHE_SUCCESS);
+	ASSERT_TEST(cachePushWithTTL(cache, elements + 2, 100000) == CACHE_SUCCESS);
+	ASSERT_TEST(cachePushWithTTL(cache, elements + 3, 20) == CACHE_SUCCESS);
+	ASSERT_TEST(cachePush(cache, elements + 4) == CACHE_SUCCESS);
+
+	ASSERT_TEST(cacheExpire(cache, 9) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheIsIn(cache, elements));
+	ASSERT_TEST(cacheExpire(cache, 10) == CACHE_SUCCESS);
+	ASSERT_TEST(!cacheIsIn(cache, elements));
+	// timer of removed element is cancelled
+	ASSERT_TEST(cacheFreeElement(cache, elements + 3) == CACHE_SUCCESS);
+	// time does not go back
+	ASSERT_TEST(cacheExpire(cache, 5) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheExpire(cache, 299) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheIsIn(cache, elements + 1));
+	ASSERT_TEST(cacheExpire(cache, 300) == CACHE_SUCCESS);
+	ASSERT_TEST(!cacheIsIn(cache, elements + 1));
+	ASSERT_TEST(cacheExpire(cache, 99999) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheIsIn(cache, elements + 2));
+	ASSERT_TEST(cacheExpire(cache, 100000) == CACHE_SUCCESS);
+	ASSERT_TEST(!cacheIsIn(cache, elements + 2));
+	ASSERT_TEST(cacheIsIn(cache, elements + 4));
+
+	// ttl counts from the last time seen, large jumps skip empty slots
+	ASSERT_TEST(cachePushWithTTL(cache, elements, UINT64_MAX) == CACHE_SUCCESS);
+	ASSERT_TEST(cachePushWithTTL(cache, elements + 1, 1 << 30) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheExpire(cache, 100000 + (1 << 30) - 1) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheIsIn(cache, elements + 1));
+	ASSERT_TEST(cacheExpire(cache, 100000 + (1 << 30)) == CACHE_SUCCESS);
+	ASSERT_TEST(!cacheIsIn(cache, elements + 1));
+	ASSERT_TEST(cacheIsIn(cache, elements));
+	freeInt(cacheExtractElementByKey(cache, 1));
+	ASSERT_TEST(cachePushWithTTL(cache, elements + 3, 5) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheClear(cache) == CACHE_SUCCESS);
+
+	// with a clock the cache expires elements by itself
+	testClockTime = 200000 + (1 << 30);
+	ASSERT_TEST(cacheSetClock(cache, testClock) == CACHE_SUCCESS);
+	ASSERT_TEST(cachePushWithTTL(cache, elements, 5) == CACHE_SUCCESS);
+	ASSERT_TEST(cachePushWithTTL(cache, elements + 1, 50) == CACHE_SUCCESS);
+	ASSERT_TEST(cachePush(cache, elements + 4) == CACHE_SUCCESS);
+	testClockTime += 5;
+	ASSERT_TEST(!cacheIsIn(cache, elements));
+	ASSERT_TEST(cacheIsIn(cache, elements + 1));
+	testClockTime += 45;
+	int remaining = 0;
+	CACHE_FOREACH(set, cache) {
+		SET_FOREACH(int*, it, set) {
+			ASSERT_TEST(INT(it) == elements[4]);
+			++remaining;
+		}
+	}
+	ASSERT_TEST(remaining == 1);
+	ASSERT_TEST(cacheSetClock(cache, NULL) == CACHE_SUCCESS);
+	ASSERT_TEST(cachePushWithTTL(cache, elements, 1) == CACHE_SUCCESS);
+	cacheDestroy(cache);
+	return true;
+}
+
+#ifdef CACHE_STATS
+static bool testCacheStats(void) {
+	Cache cache = cacheCreate(BASE, freeInt, copyInt, compareInt, getLastDigit);
+	ASSERT_TEST(cache != NULL);
+	CacheStats stats;
+	ASSERT_TEST(cacheGetStats(NULL, &stats) == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(cacheGetStats(cache, NULL) == CACHE_NULL_ARGUMENT);
+
+	// cell 0 gets 3 elements, cell 1 gets one
+	int elements[] = { 0, 10, 20, 1 };
+	const int ELEMENTS_SIZE = sizeof(elements) / sizeof(*elements);
+	for (int i = 0; i < ELEMENTS_SIZE; ++i) {
+		ASSERT_TEST(cachePush(cache, elements + i) == CACHE_SUCCESS);
+	}
+	int missing = 30;
+	ASSERT_TEST(cacheIsIn(cache, elements));
+	ASSERT_TEST(!cacheIsIn(cache, &missing));
+	ASSERT_TEST(cacheFreeElement(cache, elements + 3) == CACHE_SUCCESS);
+	freeInt(cacheExtractElementByKey(cache, 0));
+
+	ASSERT_TEST(cacheGetStats(cache, &stats) == CACHE_SUCCESS);
+	ASSERT_TEST(stats.pushes == ELEMENTS_SIZE);
+	ASSERT_TEST(stats.isIns == 2);
+	ASSERT_TEST(stats.hits == 1 && stats.misses == 1);
+	ASSERT_TEST(stats.frees == 1 && stats.extracts == 1);
+	ASSERT_TEST(stats.lookups == ELEMENTS_SIZE + 2 + 1);
+	ASSERT_TEST(stats.comparisons > 0);
+	long histogramTotal = 0;
+	for (int i = 0; i < CACHE_STATS_HISTOGRAM_SIZE; ++i) {
+		histogramTotal += stats.probeHistogram[i];
+	}
+	ASSERT_TEST(histogramTotal == stats.lookups);
+
+	FILE *output = tmpfile();
+	ASSERT_TEST(output != NULL);
+	ASSERT_TEST(cacheDumpStats(NULL, output, CACHE_STATS_JSON) == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(cacheDumpStats(cache, output, CACHE_STATS_JSON) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheDumpStats(cache, output, CACHE_STATS_CSV) == CACHE_SUCCESS);
+	rewind(output);
+	char line[512];
+	ASSERT_TEST(fgets(line, sizeof(line), output) != NULL);
+	ASSERT_TEST(strstr(line, "\"occupancy_histogram\": [9, 0, 1,") != NULL);
+	bool foundCsvOccupancy = false;
+	while (fgets(line, sizeof(line), output) != NULL) {
+		foundCsvOccupancy |= strcmp(line, "occupancy_2,1\n") == 0;
+	}
+	ASSERT_TEST(foundCsvOccupancy);
+	fclose(output);
+
+	ASSERT_TEST(cacheResetStats(cache) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheGetStats(cache, &stats) == CACHE_SUCCESS);
+	ASSERT_TEST(stats.pushes == 0 && stats.lookups == 0);
+	cacheDestroy(cache);
+	return true;
+}
+
+static bool testCacheStatsDumpShared(void) {
+	// pool and concurrent caches keep their elements out of the set cells
+	Cache caches[] = {
+		cacheCreatePool(BASE, freeInt, copyInt, compareInt, getLastDigit),
+		cacheCreateConcurrent(BASE, freeInt, copyInt, compareInt, getLastDigit)
+	};
+	int elements[] = { 0, 10, 20, 1, 2 };
+	for (int c = 0; c < 2; ++c) {
+		ASSERT_TEST(caches[c] != NULL);
+		for (int i = 0; i < (int)(sizeof(elements) / sizeof(*elements)); ++i) {
+			ASSERT_TEST(cachePush(caches[c], elements + i) == CACHE_SUCCESS);
+		}
+		FILE *output = tmpfile();
+		ASSERT_TEST(output != NULL);
+		ASSERT_TEST(cacheDumpStats(caches[c], output, CACHE_STATS_JSON) == CACHE_SUCCESS);
+		rewind(output);
+		char line[512];
+		ASSERT_TEST(fgets(line, sizeof(line), output) != NULL);
+		ASSERT_TEST(strstr(line, "\"max_occupancy\": 3,") != NULL);
+		ASSERT_TEST(strstr(line, "\"occupancy_histogram\": [7, 2, 0, 1,") != NULL);
+		fclose(output);
+		cacheDestroy(caches[c]);
+	}
+	return true;
+}
+
+static bool testCacheStatsManyCaches(void) {
+	// every cache counts its own comparisons, however many there are
+	const int CACHES = 40;
+	Cache caches[CACHES];
+	int elements[] = { 1, 11, 21 };
+	for (int c = 0; c < CACHES; ++c) {
+		caches[c] = cacheCreate(BASE, freeInt, copyInt, compareInt, getLastDigit);
+		ASSERT_TEST(caches[c] != NULL);
+		for (int i = 0; i < 3; ++i) {
+			ASSERT_TEST(cachePush(caches[c], elements + i) == CACHE_SUCCESS);
+		}
+	}
+	for (int c = 0; c < CACHES; ++c) {
+		CacheStats stats;
+		ASSERT_TEST(cacheGetStats(caches[c], &stats) == CACHE_SUCCESS);
+		ASSERT_TEST(stats.comparisons > 0);
+		ASSERT_TEST(stats.probeHistogram[0] == 1);
+		cacheDestroy(caches[c]);
+	}
+	return true;
+}
+
+/** pushes length of string evicted from another cache to the cache in context */
+static void pushEvictedLength(CacheElement element, void *context) {
+	int length = (int)strlen(element);
+	cachePush(context, &length);
+}
+
+static bool testCacheStatsNested(void) {
+	// the string cache calls into the int cache from inside its push, and
+	// goes on comparing strings afterwards
+	Cache lengths = cacheCreate(BASE, freeInt, copyInt, compareInt, getLastDigit);
+	Cache strings = cacheCreate(256, freeString, copyString, compareStrings, getFirstLetter);
+	ASSERT_TEST(lengths != NULL && strings != NULL);
+	ASSERT_TEST(cacheSetCapacity(strings, 2) == CACHE_SUCCESS);
+	ASSERT_TEST(cacheSetEvictionListener(strings, pushEvictedLength, lengths) == CACHE_SUCCESS);
+	char *words[] = { "ant", "apple", "almond", "avocado" };
+	for (int i = 0; i < 4; ++i) {
+		ASSERT_TEST(cachePush(strings, words[i]) == CACHE_SUCCESS);
+		ASSERT_TEST(cacheIsIn(strings, words[i]));
+	}
+	for (int i = 0; i < 4; ++i) {
+		int length = (int)strlen(words[i]);
+		ASSERT_TEST(cacheIsIn(strings, words[i]) != cacheIsIn(lengths, &length));
+	}
+
+	CacheStats stats;
+	ASSERT_TEST(cacheGetStats(strings, &stats) == CACHE_SUCCESS);
+	ASSERT_TEST(stats.pushes == 4 && stats.comparisons > 0);
+	ASSERT_TEST(cacheGetStats(lengths, &stats) == CACHE_SUCCESS);
+	ASSERT_TEST(stats.pushes == 2 && stats.isIns == 4);
+	ASSERT_TEST(cacheClear(strings) == CACHE_SUCCESS);
+	cacheDestroy(strings);
+	cacheDestroy(lengths);
+	return true;
+}
+#endif
+
 int main() {
 	setvbuf(stdout, NULL, _IONBF, 0);
 	setvbuf(stderr, NULL, _IONBF, 0);
@@ -360,6 +1446,26 @@ int main() {
 	RUN_TEST(testCacheIsIn);
 	RUN_TEST(testCacheForeach);
 	RUN_TEST(testCacheClear);
+	RUN_TEST(testCacheClearDestroy);
+	RUN_TEST(testCacheResizable);
+	RUN_TEST(testCacheBloomFilter);
+	RUN_TEST(testCacheBatch);
+	RUN_TEST(testCacheBatchResizable);
+	RUN_TEST(testCacheProbes);
+	RUN_TEST(testCacheTTL);
+	RUN_TEST(testCacheAdmission);
+	RUN_TEST(testCacheParallelForEach);
+	RUN_TEST(testCacheSnapshot);
+	RUN_TEST(testCachePool);
+	RUN_TEST(testCacheMemoryBudget);
+	RUN_TEST(testCacheHashed);
+	RUN_TEST(testCacheConcurrent);
+#ifdef CACHE_STATS
+	RUN_TEST(testCacheStats);
+	RUN_TEST(testCacheStatsNested);
+	RUN_TEST(testCacheStatsManyCaches);
+	RUN_TEST(testCacheStatsDumpShared);
+#endif
 	return 0;
 }
 
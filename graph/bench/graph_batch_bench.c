@@ -0,0 +1,135 @@
+/*
+ * graph_batch_bench.c
+ *
+ * Bulk load of a graph: the same vertices and random edges, with repeats,
+ * added one call per item (graphAddVertex, graphAddDirectedEdge) and in two
+ * batches (graphAddVerticesBatch, graphAddEdgesBatch). Vertices are given in
+ * random order, as read from an unsorted file.
+ *
+ * Usage: graph_batch_bench [vertices] [edges]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../graph.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_DEFAULT_VERTICES (100000)
+#define BENCH_DEFAULT_EDGES (1000000)
+
+static GraphVertex copyId(GraphVertex vertex) {
+	int *copy = malloc(sizeof(*copy));
+	if (copy != NULL) {
+		*copy = *(int*)vertex;
+	}
+	return copy;
+}
+
+static int compareIds(GraphVertex vertex1, GraphVertex vertex2) {
+	return *(int*)vertex1 - *(int*)vertex2;
+}
+
+static void freeId(GraphVertex vertex) {
+	free(vertex);
+}
+
+/** deterministic pseudo random numbers (xorshift64) */
+static unsigned long long benchRandom(unsigned long long *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static double benchNow(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/** @return seconds to load the graph, negative on error */
+static double benchLoad(bool batch, int *names, GraphVertex *vertices, int count,
+		GraphVertex *from, GraphVertex *to, int edges, GraphResult *results, long *added) {
+	Graph graph = graphCreate(copyId, compareIds, freeId);
+	if (graph == NULL) {
+		return -1;
+	}
+	double start = benchNow();
+	*added = 0;
+	if (batch) {
+		if (graphAddVerticesBatch(graph, vertices, count, results) != GRAPH_SUCCESS ||
+				graphAddEdgesBatch(graph, from, to, edges, results) != GRAPH_SUCCESS) {
+			graphDestroy(graph);
+			return -1;
+		}
+		for (int i = 0; i < edges; ++i) {
+			*added += results[i] == GRAPH_SUCCESS;
+		}
+	} else {
+		for (int i = 0; i < count; ++i) {
+			graphAddVertex(graph, names + i);
+		}
+		for (int i = 0; i < edges; ++i) {
+			*added += graphAddDirectedEdge(graph, from[i], to[i]) == GRAPH_SUCCESS;
+		}
+	}
+	double elapsed = benchNow() - start;
+	graphDestroy(graph);
+	return elapsed;
+}
+
+int main(int argc, char *argv[]) {
+	int count = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_VERTICES;
+	int edges = argc > 2 ? atoi(argv[2]) : BENCH_DEFAULT_EDGES;
+	if (count <= 0 || edges <= 0) {
+		fprintf(stderr, "vertices and edges must be positive\n");
+		return 1;
+	}
+	int *names = malloc(count * sizeof(*names));
+	GraphVertex *vertices = malloc(count * sizeof(*vertices));
+	GraphVertex *from = malloc(edges * sizeof(*from));
+	GraphVertex *to = malloc(edges * sizeof(*to));
+	GraphResult *results = malloc((count > edges ? count : edges) * sizeof(*results));
+	if (names == NULL || vertices == NULL || from == NULL || to == NULL || results == NULL) {
+		fprintf(stderr, "allocation failed\n");
+		return 1;
+	}
+	unsigned long long state = 88172645463325252ULL;
+	for (int i = 0; i < count; ++i) {
+		names[i] = i;
+	}
+	for (int i = count - 1; i > 0; --i) {
+		int j = benchRandom(&state) % (i + 1);
+		int swap = names[i];
+		names[i] = names[j];
+		names[j] = swap;
+	}
+	for (int i = 0; i < count; ++i) {
+		vertices[i] = names + i;
+	}
+	for (int i = 0; i < edges; ++i) {
+		from[i] = names + benchRandom(&state) % count;
+		to[i] = names + benchRandom(&state) % count;
+	}
+
+	printf("%-10s %12s %12s\n", "load", "seconds", "edges added");
+	for (int batch = 0; batch < 2; ++batch) {
+		long added;
+		double elapsed = benchLoad(batch, names, vertices, count, from, to, edges, results,
+				&added);
+		if (elapsed < 0) {
+			fprintf(stderr, "load failed\n");
+			return 1;
+		}
+		printf("%-10s %12.3f %12ld\n", batch ? "batch" : "single", elapsed, added);
+	}
+	free(names);
+	free(vertices);
+	free(from);
+	free(to);
+	free(results);
+	return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * graph_bfs_bench.c
+ *
+ * Breadth first traversal on a synthetic power-law graph: R-MAT edges
+ * (Chakrabarti et al.) over 2^scale vertices, as in Graph500. Times the
+ * single-threaded graphBFS and graphParallelBFS with 1, 2, 4, ... threads.
+ *
+ * Usage: graph_bfs_bench [scale] [edges per vertex] [max threads]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../graph.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_DEFAULT_SCALE (16)
+#define BENCH_DEFAULT_EDGE_FACTOR (16)
+#define BENCH_DEFAULT_THREADS (8)
+#define BENCH_SOURCES (8)
+/** R-MAT quadrant probabilities, the rest is the fourth one */
+#define BENCH_RMAT_A (0.57)
+#define BENCH_RMAT_B (0.19)
+#define BENCH_RMAT_C (0.19)
+
+static GraphVertex copyId(GraphVertex vertex) {
+	int *copy = malloc(sizeof(*copy));
+	if (copy != NULL) {
+		*copy = *(int*)vertex;
+	}
+	return copy;
+}
+
+static int compareIds(GraphVertex vertex1, GraphVertex vertex2) {
+	return *(int*)vertex1 - *(int*)vertex2;
+}
+
+static void freeId(GraphVertex vertex) {
+	free(vertex);
+}
+
+/** deterministic pseudo random numbers in [0, 1) (xorshift64) */
+static double benchRandom(unsigned long long *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return (double)(*state >> 11) / (double)(1ULL << 53);
+}
+
+static double benchNow(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/** chooses one of 2^scale vertices, a quadrant per bit */
+static void benchRmatEdge(int scale, unsigned long long *state, int *from, int *to) {
+	*from = *to = 0;
+	for (int bit = 0; bit < scale; ++bit) {
+		double point = benchRandom(state);
+		int row = point >= BENCH_RMAT_A + BENCH_RMAT_B;
+		int column = (point >= BENCH_RMAT_A && point < BENCH_RMAT_A + BENCH_RMAT_B) ||
+				point >= BENCH_RMAT_A + BENCH_RMAT_B + BENCH_RMAT_C;
+		*from = *from << 1 | row;
+		*to = *to << 1 | column;
+	}
+}
+
+static bool benchCountVisit(GraphVertex vertex, int id, int depth, void *context) {
+	(void)vertex;
+	(void)id;
+	(void)depth;
+	++*(long*)context;
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	int scale = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_SCALE;
+	int edgeFactor = argc > 2 ? atoi(argv[2]) : BENCH_DEFAULT_EDGE_FACTOR;
+	int maxThreads = argc > 3 ? atoi(argv[3]) : BENCH_DEFAULT_THREADS;
+	if (scale <= 0 || scale > 28 || edgeFactor <= 0 || maxThreads <= 0) {
+		fprintf(stderr, "scale must be in [1, 28], edge factor and threads positive\n");
+		return 1;
+	}
+	int vertices = 1 << scale;
+	Graph graph = graphCreate(copyId, compareIds, freeId);
+	int *levels = malloc(vertices * sizeof(*levels));
+	if (graph == NULL || levels == NULL) {
+		fprintf(stderr, "allocation failed\n");
+		graphDestroy(graph);
+		free(levels);
+		return 1;
+	}
+	for (int i = 0; i < vertices; ++i) {
+		if (graphAddVertex(graph, &i) != GRAPH_SUCCESS) {
+			fprintf(stderr, "cannot add vertex\n");
+			return 1;
+		}
+	}
+	// ids follow insertion order in a new graph
+	unsigned long long state = 88172645463325252ULL;
+	double start = benchNow();
+	long edges = 0;
+	for (long i = 0; i < (long)vertices * edgeFactor; ++i) {
+		int from, to;
+		benchRmatEdge(scale, &state, &from, &to);
+		edges += graphAddDirectedEdgeById(graph, from, to) == GRAPH_SUCCESS;
+	}
+	printf("vertices: %d, edges: %ld, built in %.2f s\n", vertices, edges, benchNow() - start);
+
+	// sources are vertices with out-edges, the first ones are hubs
+	int sources[BENCH_SOURCES];
+	for (int i = 0, id = 0; i < BENCH_SOURCES; ++id) {
+		if (graphOutDegreeById(graph, id % vertices) > 0) {
+			sources[i++] = id % vertices;
+		}
+	}
+
+	long reached = 0;
+	start = benchNow();
+	for (int i = 0; i < BENCH_SOURCES; ++i) {
+		graphBFS(graph, graphGetVertexById(graph, sources[i]), benchCountVisit, &reached);
+	}
+	double serial = (benchNow() - start) / BENCH_SOURCES;
+	printf("%-10s %12s %12s\n", "threads", "ms/search", "speedup");
+	printf("%-10s %12.2f %12s (%ld vertices reached per search)\n", "graphBFS",
+			serial * 1e3, "", reached / BENCH_SOURCES);
+	for (int threads = 1; threads <= maxThreads; threads *= 2) {
+		start = benchNow();
+		for (int i = 0; i < BENCH_SOURCES; ++i) {
+			if (graphParallelBFS(graph, graphGetVertexById(graph, sources[i]), threads,
+					levels) != GRAPH_SUCCESS) {
+				fprintf(stderr, "search failed\n");
+				return 1;
+			}
+		}
+		double parallel = (benchNow() - start) / BENCH_SOURCES;
+		printf("%-10d %12.2f %12.2f\n", threads, parallel * 1e3, serial / parallel);
+	}
+	graphDestroy(graph);
+	free(levels);
+	return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * graph_edge_bench.c
+ *
+ * Heap allocations and time per edge probe and edge removal of a graph of
+ * string vertices, as memcache uses it. Probes used to allocate an edge and
+ * two vertex copies each, now they compare ids inside adjacency of the
+ * source vertex.
+ *
+ * Allocations are counted by wrapping the allocator at link time:
+ * gcc -std=c99 -O2 graph_edge_bench.c ../graph.c \
+ *     -Wl,--wrap=malloc,--wrap=realloc,--wrap=free
+ *
+ * Usage: graph_edge_bench [vertices] [edges per vertex] [probes]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../graph.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_DEFAULT_VERTICES (10000)
+#define BENCH_DEFAULT_DEGREE (8)
+#define BENCH_DEFAULT_PROBES (1000000)
+#define BENCH_NAME_SIZE (16)
+
+static long benchAllocations;
+
+void *__real_malloc(size_t size);
+void *__real_realloc(void *pointer, size_t size);
+void __real_free(void *pointer);
+
+void *__wrap_malloc(size_t size) {
+	++benchAllocations;
+	return __real_malloc(size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+	++benchAllocations;
+	return __real_realloc(pointer, size);
+}
+
+void __wrap_free(void *pointer) {
+	__real_free(pointer);
+}
+
+static GraphVertex copyName(GraphVertex name) {
+	char *copy = malloc(strlen(name) + 1);
+	return copy == NULL ? NULL : strcpy(copy, name);
+}
+
+static int compareNames(GraphVertex name1, GraphVertex name2) {
+	return strcmp(name1, name2);
+}
+
+static void freeName(GraphVertex name) {
+	free(name);
+}
+
+/** deterministic pseudo random numbers (xorshift64) */
+static unsigned long benchRandom(unsigned long long *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return (unsigned long)(*state >> 1);
+}
+
+static double benchNow(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+	int vertices = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_VERTICES;
+	int degree = argc > 2 ? atoi(argv[2]) : BENCH_DEFAULT_DEGREE;
+	long probes = argc > 3 ? atol(argv[3]) : BENCH_DEFAULT_PROBES;
+	if (vertices <= 0 || degree < 0 || probes <= 0) {
+		fprintf(stderr, "vertices and probes must be positive\n");
+		return 1;
+	}
+	char (*names)[BENCH_NAME_SIZE] = malloc(vertices * sizeof(*names));
+	Graph graph = graphCreate(copyName, compareNames, freeName);
+	if (names == NULL || graph == NULL) {
+		fprintf(stderr, "allocation failed\n");
+		free(names);
+		graphDestroy(graph);
+		return 1;
+	}
+	for (int i = 0; i < vertices; ++i) {
+		sprintf(names[i], "user%d", i);
+		if (graphAddVertex(graph, names[i]) != GRAPH_SUCCESS) {
+			fprintf(stderr, "cannot add vertex\n");
+			return 1;
+		}
+	}
+	unsigned long long state = 88172645463325252ULL;
+	for (int i = 0; i < vertices; ++i) {
+		for (int j = 0; j < degree; ++j) {
+			graphAddDirectedEdge(graph, names[i], names[benchRandom(&state) % vertices]);
+		}
+	}
+
+	long found = 0;
+	long allocations = benchAllocations;
+	double start = benchNow();
+	for (long i = 0; i < probes; ++i) {
+		found += graphIsDirectedEdgeExists(graph, names[benchRandom(&state) % vertices],
+				names[benchRandom(&state) % vertices]);
+	}
+	double probeTime = benchNow() - start;
+	long probeAllocations = benchAllocations - allocations;
+
+	// removals of existing and missing edges, the existing ones are added back
+	allocations = benchAllocations;
+	long removals = 0;
+	start = benchNow();
+	for (long i = 0; i < probes; ++i) {
+		char *from = names[benchRandom(&state) % vertices];
+		char *to = names[benchRandom(&state) % vertices];
+		if (graphRemoveDirectedEdge(graph, from, to) == GRAPH_SUCCESS) {
+			++removals;
+			// capacity of adjacency stays, so adding back does not allocate
+			graphAddDirectedEdge(graph, from, to);
+		}
+	}
+	double removeTime = benchNow() - start;
+	long removeAllocations = benchAllocations - allocations;
+
+	printf("vertices: %d, edges per vertex: %d, probes: %ld, found: %ld\n",
+			vertices, degree, probes, found);
+	printf("%-10s %18s %12s\n", "operation", "allocations/call", "ns/call");
+	printf("%-10s %18.3f %12.1f\n", "exists", (double)probeAllocations / probes,
+			probeTime * 1e9 / probes);
+	printf("%-10s %18.3f %12.1f (%ld edges removed and added back)\n", "remove",
+			(double)removeAllocations / probes, removeTime * 1e9 / probes, removals);
+	graphDestroy(graph);
+	free(names);
+	return 0;
+}
@@ -5,26 +5,92 @@
  *      Author: Infoshoc_2
  */
 
-#include "set.h"
 #include "graph.h"
 #include "assert.h"
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+
+/** Initial number of elements of growing arrays */
+#define GRAPH_INITIAL_CAPACITY (4)
+/**
+ * Traversal goes bottom-up once edges from the frontier are more than this
+ * part of edges from unvisited vertices, and back top-down once the frontier
+ * is less than this part of vertices (Beamer et al.)
+ */
+#define GRAPH_BFS_BOTTOM_UP_EDGES (14)
+#define GRAPH_BFS_TOP_DOWN_VERTICES (24)
+
+/** Number of vertices a worker of parallel traversal takes at once */
+#define GRAPH_PARALLEL_CHUNK (256)
+/** Vertices found by a worker are moved to the next level this many at once */
+#define GRAPH_PARALLEL_BUFFER (256)
+/**
+ * Reachability index is rebuilt after one change it could not follow per
+ * this many vertices and edges of the graph
+ */
+#define GRAPH_REACH_REBUILD_RATIO (16)
+
+#ifdef __GNUC__
+// workers of parallel traversal synchronize at every level, so bits of
+// visited vertices need no ordering
+#define GRAPH_ATOMIC_LOAD(pointer) __atomic_load_n(pointer, __ATOMIC_RELAXED)
+#define GRAPH_ATOMIC_FETCH_OR(pointer, value) \
+	__atomic_fetch_or(pointer, value, __ATOMIC_RELAXED)
+#define GRAPH_PARALLEL_THREADS(nthreads) (nthreads)
+#else
+// without atomic builtins parallel traversal runs in the calling thread
+#define GRAPH_ATOMIC_LOAD(pointer) (*(pointer))
+#define GRAPH_ATOMIC_FETCH_OR(pointer, value) graphFetchOr(pointer, value)
+#define GRAPH_PARALLEL_THREADS(nthreads) (1)
+#endif
+
+/** Bitsets of vertex ids */
+#define GRAPH_BITSET_WORDS(bits) (((bits) + 63) / 64)
+#define GRAPH_BIT_TEST(bitset, bit) (((bitset)[(bit) / 64] >> ((bit) % 64)) & 1)
+#define GRAPH_BIT_SET(bitset, bit) ((bitset)[(bit) / 64] |= (uint64_t)1 << ((bit) % 64))
+
+/** Ids of vertices at the other ends of edges of a vertex, sorted */
+typedef struct GraphAdjacency_t {
+	int *ids;
+	int count;
+	int capacity;
+} GraphAdjacency;
+
+/** Vertex of graph together with its incident edges */
+typedef struct GraphVertexEntry_t {
+	/** NULL if the id is free */
+	GraphVertex vertex;
+	/** vertices edges from this one lead to */
+	GraphAdjacency out;
+	/** vertices edges to this one come from */
+	GraphAdjacency in;
+} GraphVertexEntry;
+
+struct GraphReachIndex_t;
 
 typedef struct Graph_t {
 	copyGraphVertex copyVertex;
 	compareGraphVertex compareVertex;
 	freeGraphVertex freeVertex;
-	Set vertices;
-	Set edges;
+	/** vertices indexed by id, ids below idBound are used or free */
+	GraphVertexEntry *vertices;
+	int idBound;
+	/** ids of vertices sorted by compareVertex */
+	int *order;
+	int verticesCount;
+	long edgesCount;
+	/** free ids below idBound, the latest freed is reused first */
+	int *freeIds;
+	int freeCount;
+	/** number of elements allocated for each of vertices, order and freeIds */
+	int capacity;
+	/** NULL unless reachability index is enabled, built when it is enabled */
+	struct GraphReachIndex_t *reach;
 } Graph_t;
 
-/** Struct for directed edges */
-typedef struct GraphEdge_t {
-	Graph graph; // just for vertex functions
-	GraphVertex from;
-	GraphVertex to;
-} GraphEdge_t, *GraphEdge;
-
 /**
  * Safe allocation of an object of given type to var, which returns error in
  * case of failiture
@@ -36,56 +102,589 @@ typedef struct GraphEdge_t {
 		} \
 	} while(false)
 
-/** Creates new directed edge for graph */
-static GraphEdge graphEdgeCreate(Graph graph, GraphVertex from, GraphVertex to) {
-	GraphEdge edge;
-	GRAPH_ALLOCATE(GraphEdge_t, edge, NULL);
-	edge->graph = graph;
+/**
+ * finds position of id in adjacency, or where it would be inserted
+ * @return true if the id is there
+ */
+static bool graphAdjacencyFind(const GraphAdjacency *adjacency, int id, int *position) {
+	int low = 0, high = adjacency->count;
+	while (low < high) {
+		int middle = low + (high - low) / 2;
+		if (adjacency->ids[middle] == id) {
+			*position = middle;
+			return true;
+		}
+		if (adjacency->ids[middle] < id) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	*position = low;
+	return false;
+}
+
+/**
+ * makes room for count more ids in adjacency
+ * @return false on allocation failure
+ */
+static bool graphAdjacencyReserve(GraphAdjacency *adjacency, int count) {
+	if (adjacency->count + count <= adjacency->capacity) {
+		return true;
+	}
+	int capacity = adjacency->capacity == 0 ? GRAPH_INITIAL_CAPACITY :
+			adjacency->capacity * 2;
+	if (capacity < adjacency->count + count) {
+		capacity = adjacency->count + count;
+	}
+	int *grown = (int*)realloc(adjacency->ids, capacity * sizeof(*grown));
+	if (grown == NULL) {
+		return false;
+	}
+	adjacency->ids = grown;
+	adjacency->capacity = capacity;
+	return true;
+}
 
-	edge->from = graph->copyVertex(from);
-	if (edge->from == NULL) {
-		free(edge);
-		return NULL;
+/** inserts id, which is not in adjacency, returns false on allocation failure */
+static bool graphAdjacencyInsert(GraphAdjacency *adjacency, int id) {
+	if (!graphAdjacencyReserve(adjacency, 1)) {
+		return false;
 	}
+	int position;
+	bool found = graphAdjacencyFind(adjacency, id, &position);
+	assert(!found);
+	(void)found;
+	memmove(adjacency->ids + position + 1, adjacency->ids + position,
+			(adjacency->count - position) * sizeof(*adjacency->ids));
+	adjacency->ids[position] = id;
+	++adjacency->count;
+	return true;
+}
 
-	edge->to = graph->copyVertex(to);
-	if (edge->to == NULL) {
-		free(edge);
-		graph->freeVertex(edge->from);
-		return NULL;
+/** removes id from adjacency, returns false if it is not there */
+static bool graphAdjacencyRemove(GraphAdjacency *adjacency, int id) {
+	int position;
+	if (!graphAdjacencyFind(adjacency, id, &position)) {
+		return false;
+	}
+	--adjacency->count;
+	memmove(adjacency->ids + position, adjacency->ids + position + 1,
+			(adjacency->count - position) * sizeof(*adjacency->ids));
+	return true;
+}
+
+/** checks whether id belongs to a vertex of graph */
+static bool graphIsIdUsed(ConstGraph graph, int id) {
+	return id >= 0 && id < graph->idBound && graph->vertices[id].vertex != NULL;
+}
+
+/** Frees copy of vertex with given id and its adjacency, making the id free */
+static void graphVertexEntryFree(Graph graph, int id) {
+	GraphVertexEntry *entry = graph->vertices + id;
+	graph->freeVertex(entry->vertex);
+	free(entry->out.ids);
+	free(entry->in.ids);
+	entry->out = entry->in = (GraphAdjacency){ NULL, 0, 0 };
+	entry->vertex = NULL;
+}
+
+/**
+ * finds position of vertex in ids of graph sorted by vertex, or where it
+ * would be inserted
+ * @return true if the vertex is there
+ */
+static bool graphFindPosition(ConstGraph graph, GraphVertex vertex, int *position) {
+	int low = 0, high = graph->verticesCount;
+	while (low < high) {
+		int middle = low + (high - low) / 2;
+		int comparison = graph->compareVertex(
+				graph->vertices[graph->order[middle]].vertex, vertex);
+		if (comparison == 0) {
+			*position = middle;
+			return true;
+		}
+		if (comparison < 0) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	*position = low;
+	return false;
+}
+
+/** returns id of vertex, -1 if there is no such vertex */
+static int graphFindId(ConstGraph graph, GraphVertex vertex) {
+	int position;
+	return graphFindPosition(graph, vertex, &position) ? graph->order[position] : -1;
+}
+
+/**
+ * makes sure ids can be given to count more vertices
+ * @return false on allocation failure
+ */
+static bool graphReserveVertices(Graph graph, int count) {
+	int needed = graph->idBound - graph->freeCount + count;
+	if (needed <= graph->capacity) {
+		return true;
+	}
+	int capacity = graph->capacity == 0 ? GRAPH_INITIAL_CAPACITY : graph->capacity * 2;
+	if (capacity < needed) {
+		capacity = needed;
+	}
+	// arrays which did grow stay grown, capacity is their common minimum
+	GraphVertexEntry *vertices = (GraphVertexEntry*)realloc(graph->vertices,
+			capacity * sizeof(*vertices));
+	if (vertices == NULL) {
+		return false;
+	}
+	graph->vertices = vertices;
+	int *order = (int*)realloc(graph->order, capacity * sizeof(*order));
+	if (order == NULL) {
+		return false;
+	}
+	graph->order = order;
+	int *freeIds = (int*)realloc(graph->freeIds, capacity * sizeof(*freeIds));
+	if (freeIds == NULL) {
+		return false;
+	}
+	graph->freeIds = freeIds;
+	graph->capacity = capacity;
+	return true;
+}
+
+/**
+ * Strongly connected components by Tarjan's algorithm, with an explicit
+ * stack instead of recursion. Components are numbered in reverse topological
+ * order: an edge between different components leads to the lower number.
+ * @param component - Filled with component of every id, -1 for free ids
+ * @return number of components, -1 on allocation failure
+ */
+static int graphFindComponents(ConstGraph graph, int *component) {
+	int bound = graph->idBound;
+	int *index = (int*)malloc((bound + 1) * sizeof(int));
+	int *lowlink = (int*)malloc((bound + 1) * sizeof(int));
+	int *edgePosition = (int*)malloc((bound + 1) * sizeof(int));
+	// vertices of components not yet found, and path of the search
+	int *stack = (int*)malloc((bound + 1) * sizeof(int));
+	int *path = (int*)malloc((bound + 1) * sizeof(int));
+	if (index == NULL || lowlink == NULL || edgePosition == NULL || stack == NULL ||
+			path == NULL) {
+		free(index);
+		free(lowlink);
+		free(edgePosition);
+		free(stack);
+		free(path);
+		return -1;
+	}
+	for (int id = 0; id < bound; ++id) {
+		index[id] = -1;
+		component[id] = -1;
+	}
+	int components = 0, counter = 0, stackSize = 0;
+	for (int root = 0; root < bound; ++root) {
+		if (!graphIsIdUsed(graph, root) || index[root] >= 0) {
+			continue;
+		}
+		int depth = 0;
+		path[0] = root;
+		index[root] = lowlink[root] = counter++;
+		edgePosition[root] = 0;
+		stack[stackSize++] = root;
+		while (depth >= 0) {
+			int id = path[depth];
+			const GraphAdjacency *out = &graph->vertices[id].out;
+			if (edgePosition[id] < out->count) {
+				int next = out->ids[edgePosition[id]++];
+				if (index[next] < 0) {
+					index[next] = lowlink[next] = counter++;
+					edgePosition[next] = 0;
+					stack[stackSize++] = next;
+					path[++depth] = next;
+				} else if (component[next] < 0 && index[next] < lowlink[id]) {
+					// visited vertices without component are on the stack
+					lowlink[id] = index[next];
+				}
+				continue;
+			}
+			if (lowlink[id] == index[id]) {
+				int member;
+				do {
+					member = stack[--stackSize];
+					component[member] = components;
+				} while (member != id);
+				++components;
+			}
+			if (--depth >= 0 && lowlink[id] < lowlink[path[depth]]) {
+				lowlink[path[depth]] = lowlink[id];
+			}
+		}
+	}
+	free(index);
+	free(lowlink);
+	free(edgePosition);
+	free(stack);
+	free(path);
+	return components;
+}
+
+/**
+ * Reachability index over the condensation of the graph, the DAG of its
+ * strongly connected components. Components are numbered by rank, their
+ * postorder in a depth first search of the DAG, so every component reachable
+ * from another has lower rank. Each component gets two intervals of ranks:
+ * tree, the ranks of its subtree in the search, which are all reachable from
+ * it, and label, from the least rank reachable from it up to its own rank,
+ * which contains ranks of all reachable components (GRAIL, Yildirim et al.).
+ * Queries answered by neither interval search the DAG, skipping components
+ * whose label does not contain the target. Queries only read the index, it is
+ * changed and rebuilt by changes of the graph.
+ */
+typedef struct GraphReachIndex_t {
+	/** false while stale or when the last build failed */
+	bool valid;
+	/** changes of the graph the index did not follow since it was built */
+	long stale;
+	/** component of every id below bound */
+	int *component;
+	int bound;
+	int componentsCount;
+	/** number of elements allocated for component, and for each array by component */
+	int boundCapacity;
+	int componentsCapacity;
+	/** edges of the DAG by component */
+	GraphAdjacency *out;
+	GraphAdjacency *in;
+	int *rank;
+	/** least rank in the subtree of search of the DAG */
+	int *treeLow;
+	/** least rank reachable */
+	int *labelLow;
+	/** scratch of updates: components seen, all false between updates */
+	bool *seen;
+	int *stack;
+} GraphReachIndex;
+
+/** frees contents of index, which becomes invalid */
+static void graphReachIndexRelease(GraphReachIndex *index) {
+	if (index->out != NULL && index->in != NULL) {
+		for (int i = 0; i < index->componentsCount; ++i) {
+			free(index->out[i].ids);
+			free(index->in[i].ids);
+		}
+	}
+	free(index->component);
+	free(index->out);
+	free(index->in);
+	free(index->rank);
+	free(index->treeLow);
+	free(index->labelLow);
+	free(index->seen);
+	free(index->stack);
+	*index = (GraphReachIndex){ .valid = false };
+}
+
+static bool graphReachIndexBuild(ConstGraph graph, GraphReachIndex *index);
+
+/**
+ * records a change of graph the index can not follow. Queries traverse the
+ * graph while the index is stale, and it is rebuilt once such changes make up
+ * for the cost of the build. If memory runs out the index stays invalid.
+ */
+static void graphReachIndexInvalidate(Graph graph) {
+	GraphReachIndex *index = graph->reach;
+	if (index == NULL) {
+		return;
+	}
+	index->valid = false;
+	if (++index->stale * GRAPH_REACH_REBUILD_RATIO >=
+			graph->verticesCount + graph->edgesCount) {
+		graphReachIndexBuild(graph, index);
 	}
-	return edge;
 }
 
-/** Copies a directed edge  */
-static GraphEdge graphEdgeCopy(GraphEdge edge) {
-	return graphEdgeCreate(edge->graph, edge->from, edge->to);
+/**
+ * makes room in index for ids below bound and count components
+ * @return false on allocation failure
+ */
+static bool graphReachIndexReserve(GraphReachIndex *index, int bound, int count) {
+	if (bound + 1 > index->boundCapacity) {
+		int capacity = 2 * bound + 1;
+		int *component = (int*)realloc(index->component, capacity * sizeof(int));
+		if (component == NULL) {
+			return false;
+		}
+		index->component = component;
+		index->boundCapacity = capacity;
+	}
+	if (count + 1 <= index->componentsCapacity) {
+		return true;
+	}
+	int capacity = 2 * count + 1;
+	GraphAdjacency *out = (GraphAdjacency*)realloc(index->out, capacity * sizeof(*out));
+	if (out != NULL) {
+		index->out = out;
+	}
+	GraphAdjacency *in = (GraphAdjacency*)realloc(index->in, capacity * sizeof(*in));
+	if (in != NULL) {
+		index->in = in;
+	}
+	int *rank = (int*)realloc(index->rank, capacity * sizeof(int));
+	if (rank != NULL) {
+		index->rank = rank;
+	}
+	int *treeLow = (int*)realloc(index->treeLow, capacity * sizeof(int));
+	if (treeLow != NULL) {
+		index->treeLow = treeLow;
+	}
+	int *labelLow = (int*)realloc(index->labelLow, capacity * sizeof(int));
+	if (labelLow != NULL) {
+		index->labelLow = labelLow;
+	}
+	bool *seen = (bool*)realloc(index->seen, capacity * sizeof(bool));
+	if (seen != NULL) {
+		index->seen = seen;
+	}
+	int *stack = (int*)realloc(index->stack, capacity * sizeof(int));
+	if (stack != NULL) {
+		index->stack = stack;
+	}
+	// arrays grown before a failure just stay larger than needed
+	if (out == NULL || in == NULL || rank == NULL || treeLow == NULL ||
+			labelLow == NULL || seen == NULL || stack == NULL) {
+		return false;
+	}
+	index->componentsCapacity = capacity;
+	return true;
 }
 
-/** Frees a directed edge */
-static void graphEdgeFree(GraphEdge edge) {
-	if (edge == NULL) {
+/**
+ * follows a new vertex of graph, which is a component of its own. It gets the
+ * highest rank, and intervals holding just that rank.
+ */
+static void graphReachIndexAddVertex(Graph graph, int id) {
+	GraphReachIndex *index = graph->reach;
+	if (index == NULL) {
+		return;
+	}
+	if (!index->valid ||
+			!graphReachIndexReserve(index, graph->idBound, index->componentsCount + 1)) {
+		graphReachIndexInvalidate(graph);
 		return;
 	}
-	edge->graph->freeVertex(edge->from);
-	edge->graph->freeVertex(edge->to);
-	free(edge);
+	while (index->bound < graph->idBound) {
+		index->component[index->bound++] = -1;
+	}
+	int added = index->componentsCount++;
+	index->component[id] = added;
+	index->out[added] = index->in[added] = (GraphAdjacency){ NULL, 0, 0 };
+	index->rank[added] = index->treeLow[added] = index->labelLow[added] = added;
+	index->seen[added] = false;
+}
+
+/** checks whether label of from contains the one of to */
+static bool graphReachIndexLabelContains(const GraphReachIndex *index, int from, int to) {
+	return index->labelLow[from] <= index->labelLow[to] &&
+			index->rank[to] <= index->rank[from];
+}
+
+/** checks whether to is in the subtree of from */
+static bool graphReachIndexTreeContains(const GraphReachIndex *index, int from, int to) {
+	return index->treeLow[from] <= index->rank[to] && index->rank[to] <= index->rank[from];
+}
+
+/**
+ * fills the DAG, the ranks and the intervals of components found by
+ * graphFindComponents
+ * @return false on allocation failure
+ */
+static bool graphReachIndexBuildDAG(ConstGraph graph, GraphReachIndex *index) {
+	int count = index->componentsCount;
+	for (int id = 0; id < graph->idBound; ++id) {
+		const GraphAdjacency *out = &graph->vertices[id].out;
+		int from = index->component[id];
+		for (int j = 0; from >= 0 && j < out->count; ++j) {
+			int to = index->component[out->ids[j]];
+			int position;
+			if (to == from || graphAdjacencyFind(&index->out[from], to, &position)) {
+				continue;
+			}
+			if (!graphAdjacencyInsert(&index->out[from], to) ||
+					!graphAdjacencyInsert(&index->in[to], from)) {
+				return false;
+			}
+		}
+	}
+	// depth first search from components nothing leads to, keeping positions
+	// in out-edges of components on the path
+	int *position = (int*)malloc((count + 1) * sizeof(int));
+	if (position == NULL) {
+		return false;
+	}
+	for (int i = 0; i < count; ++i) {
+		index->treeLow[i] = -1;
+	}
+	int counter = 0;
+	for (int root = 0; root < count; ++root) {
+		if (index->in[root].count > 0) {
+			continue;
+		}
+		int depth = 0;
+		index->stack[0] = root;
+		index->treeLow[root] = counter;
+		position[root] = 0;
+		while (depth >= 0) {
+			int component = index->stack[depth];
+			const GraphAdjacency *out = &index->out[component];
+			if (position[component] < out->count) {
+				int next = out->ids[position[component]++];
+				if (index->treeLow[next] < 0) {
+					index->treeLow[next] = counter;
+					position[next] = 0;
+					index->stack[++depth] = next;
+				}
+				continue;
+			}
+			index->rank[component] = counter++;
+			--depth;
+		}
+	}
+	assert(counter == count);
+	free(position);
+	// components are numbered in reverse topological order, so the ones an
+	// edge leads to are labeled first
+	for (int i = 0; i < count; ++i) {
+		index->labelLow[i] = index->treeLow[i];
+		for (int j = 0; j < index->out[i].count; ++j) {
+			int next = index->out[i].ids[j];
+			if (index->labelLow[next] < index->labelLow[i]) {
+				index->labelLow[i] = index->labelLow[next];
+			}
+		}
+	}
+	return true;
+}
+
+/** builds index of graph, returns false on allocation failure */
+static bool graphReachIndexBuild(ConstGraph graph, GraphReachIndex *index) {
+	graphReachIndexRelease(index);
+	index->bound = graph->idBound;
+	index->boundCapacity = index->bound + 1;
+	index->component = (int*)malloc(index->boundCapacity * sizeof(int));
+	if (index->component == NULL) {
+		return false;
+	}
+	int count = graphFindComponents(graph, index->component);
+	if (count < 0) {
+		graphReachIndexRelease(index);
+		return false;
+	}
+	index->componentsCount = count;
+	index->componentsCapacity = count + 1;
+	index->out = (GraphAdjacency*)calloc(count + 1, sizeof(GraphAdjacency));
+	index->in = (GraphAdjacency*)calloc(count + 1, sizeof(GraphAdjacency));
+	index->rank = (int*)malloc((count + 1) * sizeof(int));
+	index->treeLow = (int*)malloc((count + 1) * sizeof(int));
+	index->labelLow = (int*)malloc((count + 1) * sizeof(int));
+	index->seen = (bool*)calloc(count + 1, sizeof(bool));
+	index->stack = (int*)malloc((count + 1) * sizeof(int));
+	if (index->out == NULL || index->in == NULL || index->rank == NULL ||
+			index->treeLow == NULL || index->labelLow == NULL || index->seen == NULL ||
+			index->stack == NULL || !graphReachIndexBuildDAG(graph, index)) {
+		graphReachIndexRelease(index);
+		return false;
+	}
+	index->valid = true;
+	return true;
+}
+
+/**
+ * checks whether component to is reachable from component from, without
+ * changing the index. Search of the DAG uses seen, all false, and queue, both
+ * of size componentsCount; seen is all false again on return.
+ */
+static bool graphReachIndexSearch(const GraphReachIndex *index, bool *seen, int *queue,
+		int from, int to) {
+	int size = 0;
+	queue[size++] = from;
+	seen[from] = true;
+	bool found = false;
+	for (int head = 0; head < size && !found; ++head) {
+		const GraphAdjacency *out = &index->out[queue[head]];
+		for (int j = 0; j < out->count && !found; ++j) {
+			int next = out->ids[j];
+			if (seen[next] || !graphReachIndexLabelContains(index, next, to)) {
+				continue;
+			}
+			found = graphReachIndexTreeContains(index, next, to);
+			seen[next] = true;
+			queue[size++] = next;
+		}
+	}
+	for (int i = 0; i < size; ++i) {
+		seen[queue[i]] = false;
+	}
+	return found;
+}
+
+/**
+ * checks by the intervals whether component to is reachable from component
+ * from
+ * @return 1 if it is, 0 if it is not, -1 if the DAG has to be searched
+ */
+static int graphReachIndexCheckIntervals(const GraphReachIndex *index, int from, int to) {
+	if (from == to || graphReachIndexTreeContains(index, from, to)) {
+		return 1;
+	}
+	return graphReachIndexLabelContains(index, from, to) ? -1 : 0;
 }
 
 /**
- * Compares two edges
- * if first from-vertex less then second returns negative number
- * if first from-vertex greater then second returns positive number
- * if from-vertices are equal returns negative number if first to-vertex less
- * then second, positive if first greater then second and zero if edges are equal
+ * follows a new edge of graph. An edge within reachable components changes
+ * nothing, an edge to a component of lower rank lowers labels of components
+ * reaching its start; any other edge invalidates the index.
  */
-static int graphEdgeCompare(GraphEdge edge1, GraphEdge edge2) {
-	assert(edge1->graph == edge2->graph);
-	int fromDifference = edge1->graph->compareVertex(edge1->from, edge2->from);
-	if (0 == fromDifference) {
-		return edge1->graph->compareVertex(edge1->to, edge2->to);
+static void graphReachIndexAddEdge(Graph graph, int from, int to) {
+	GraphReachIndex *index = graph->reach;
+	if (index == NULL) {
+		return;
+	}
+	if (!index->valid) {
+		graphReachIndexInvalidate(graph);
+		return;
+	}
+	from = index->component[from];
+	to = index->component[to];
+	int reached = graphReachIndexCheckIntervals(index, from, to);
+	if (reached == 1 || (reached < 0 &&
+			graphReachIndexSearch(index, index->seen, index->stack, from, to))) {
+		return;
+	}
+	if (index->rank[to] > index->rank[from] ||
+			!graphAdjacencyInsert(&index->out[from], to)) {
+		graphReachIndexInvalidate(graph);
+		return;
+	}
+	if (!graphAdjacencyInsert(&index->in[to], from)) {
+		graphAdjacencyRemove(&index->out[from], to);
+		graphReachIndexInvalidate(graph);
+		return;
+	}
+	int size = 0;
+	if (index->labelLow[to] < index->labelLow[from]) {
+		index->labelLow[from] = index->labelLow[to];
+		index->stack[size++] = from;
+	}
+	while (size > 0) {
+		const GraphAdjacency *in = &index->in[index->stack[--size]];
+		for (int j = 0; j < in->count; ++j) {
+			if (index->labelLow[to] < index->labelLow[in->ids[j]]) {
+				index->labelLow[in->ids[j]] = index->labelLow[to];
+				index->stack[size++] = in->ids[j];
+			}
+		}
 	}
-	return fromDifference;
 }
 
 Graph graphCreate(copyGraphVertex copyVertex, compareGraphVertex compareVertex, freeGraphVertex freeVertex) {
@@ -98,12 +697,15 @@ Graph graphCreate(copyGraphVertex copyVertex, compareGraphVertex compareVertex,
 	graph->copyVertex = copyVertex;
 	graph->compareVertex = compareVertex;
 	graph->freeVertex = freeVertex;
-	graph->vertices = setCreate(copyVertex, freeVertex, compareVertex);
-	graph->edges = setCreate((copySetElements)graphEdgeCopy, (freeSetElements)graphEdgeFree, (compareSetElements)graphEdgeCompare);
-	if (!graph->vertices || !graph->edges) {
-		graphDestroy(graph);
-		return NULL;
-	}
+	graph->vertices = NULL;
+	graph->idBound = 0;
+	graph->order = NULL;
+	graph->verticesCount = 0;
+	graph->edgesCount = 0;
+	graph->freeIds = NULL;
+	graph->freeCount = 0;
+	graph->capacity = 0;
+	graph->reach = NULL;
 
 	return graph;
 }
@@ -112,8 +714,14 @@ void graphDestroy(Graph graph) {
 	if (graph == NULL) {
 		return;
 	}
-	setDestroy(graph->vertices);
-	setDestroy(graph->edges);
+	graphClear(graph);
+	if (graph->reach != NULL) {
+		graphReachIndexRelease(graph->reach);
+		free(graph->reach);
+	}
+	free(graph->vertices);
+	free(graph->order);
+	free(graph->freeIds);
 	free(graph);
 }
 
@@ -121,14 +729,26 @@ GraphResult graphAddVertex(Graph graph, GraphVertex vertex) {
 	if (graph == NULL || vertex == NULL) {
 		return GRAPH_NULL_ARGUMENT;
 	}
-	if (graphIsVertexExists(graph, vertex)) {
+	int position;
+	if (graphFindPosition(graph, vertex, &position)) {
 		return GRAPH_VERTEX_ALREADY_EXISTS;
 	}
-	SetResult setAddResult = setAdd(graph->vertices, vertex);
-	if (setAddResult == SET_OUT_OF_MEMORY) {
+	if (!graphReserveVertices(graph, 1)) {
+		return GRAPH_OUT_OF_MEMORY;
+	}
+	GraphVertex copy = graph->copyVertex(vertex);
+	if (copy == NULL) {
 		return GRAPH_OUT_OF_MEMORY;
 	}
-	assert(setAddResult == SET_SUCCESS);
+	int id = graph->freeCount > 0 ? graph->freeIds[--graph->freeCount] : graph->idBound++;
+	GraphVertexEntry *entry = graph->vertices + id;
+	entry->vertex = copy;
+	entry->out = entry->in = (GraphAdjacency){ NULL, 0, 0 };
+	memmove(graph->order + position + 1, graph->order + position,
+			(graph->verticesCount - position) * sizeof(*graph->order));
+	graph->order[position] = id;
+	++graph->verticesCount;
+	graphReachIndexAddVertex(graph, id);
 	return GRAPH_SUCCESS;
 }
 
@@ -136,25 +756,34 @@ GraphResult graphRemoveVertex(Graph graph, GraphVertex vertex){
 	if (graph == NULL || vertex == NULL) {
 		return GRAPH_NULL_ARGUMENT;
 	}
-	if (graphIsVertexExists(graph, vertex) == false) {
+	int position;
+	if (!graphFindPosition(graph, vertex, &position)) {
 		return GRAPH_VERTEX_DOES_NOT_EXISTS;
 	}
+	int id = graph->order[position];
+	GraphVertexEntry *entry = graph->vertices + id;
 
-	// remove vertex
-	setRemove(graph->vertices, vertex);
-
-	// remove all incident edges
-	for (bool found = true; found; ) {
-		found = false;
-		SET_FOREACH(GraphEdge, edge, graph->edges) {
-			if (graph->compareVertex(edge->from, vertex) == 0 ||
-					graph->compareVertex(edge->to, vertex) == 0 ) {
-				setRemove(graph->edges, edge);
-				found = true;
-				break;
-			}
-		}
+	// a loop is both an out-edge and an in-edge
+	int loopPosition;
+	graph->edgesCount -= entry->out.count + entry->in.count -
+			graphAdjacencyFind(&entry->out, id, &loopPosition);
+
+	// remove all incident edges from the other ends, a loop is removed from
+	// in-edges while out-edges are walked
+	for (int i = 0; i < entry->out.count; ++i) {
+		graphAdjacencyRemove(&graph->vertices[entry->out.ids[i]].in, id);
 	}
+	for (int i = 0; i < entry->in.count; ++i) {
+		graphAdjacencyRemove(&graph->vertices[entry->in.ids[i]].out, id);
+	}
+
+	// remove vertex
+	--graph->verticesCount;
+	memmove(graph->order + position, graph->order + position + 1,
+			(graph->verticesCount - position) * sizeof(*graph->order));
+	graphVertexEntryFree(graph, id);
+	graph->freeIds[graph->freeCount++] = id;
+	graphReachIndexInvalidate(graph);
 	return GRAPH_SUCCESS;
 }
 
@@ -163,67 +792,1217 @@ bool graphIsVertexExists(ConstGraph graph, GraphVertex vertex) {
 		return false;
 	}
 
-	return setIsIn(graph->vertices, vertex);
+	return graphFindId(graph, vertex) >= 0;
 }
 
-GraphResult graphAddDirectedEdge(Graph graph, GraphVertex from, GraphVertex to){
-	if (graph == NULL || from == NULL || to == NULL) {
+int graphGetVertexId(ConstGraph graph, GraphVertex vertex) {
+	if (graph == NULL || vertex == NULL) {
+		return -1;
+	}
+	return graphFindId(graph, vertex);
+}
+
+GraphVertex graphGetVertexById(ConstGraph graph, int id) {
+	if (graph == NULL || !graphIsIdUsed(graph, id)) {
+		return NULL;
+	}
+	return graph->vertices[id].vertex;
+}
+
+int graphGetVertexIdBound(ConstGraph graph) {
+	if (graph == NULL) {
+		return -1;
+	}
+	return graph->idBound;
+}
+
+GraphResult graphAddDirectedEdgeById(Graph graph, int from, int to) {
+	if (graph == NULL) {
 		return GRAPH_NULL_ARGUMENT;
 	}
-	if (!graphIsVertexExists(graph, from) || !graphIsVertexExists(graph, to)) {
+	if (!graphIsIdUsed(graph, from) || !graphIsIdUsed(graph, to)) {
 		return GRAPH_VERTEX_DOES_NOT_EXISTS;
 	}
-	if (graphIsDirectedEdgeExists(graph, from, to)) {
+	GraphAdjacency *out = &graph->vertices[from].out;
+	int position;
+	if (graphAdjacencyFind(out, to, &position)) {
 		return GRAPH_EDGE_ALREADY_EXISTS;
 	}
-	GraphEdge newEdge = graphEdgeCreate(graph, from, to);
-	if (newEdge == NULL){
+	if (!graphAdjacencyInsert(out, to)) {
 		return GRAPH_OUT_OF_MEMORY;
 	}
-	SetResult setAddResult = setAdd(graph->edges, newEdge);
-	if (setAddResult == SET_OUT_OF_MEMORY) {
-		graphEdgeFree(newEdge);
+	if (!graphAdjacencyInsert(&graph->vertices[to].in, from)) {
+		graphAdjacencyRemove(out, to);
 		return GRAPH_OUT_OF_MEMORY;
 	}
-	assert(setAddResult == SET_SUCCESS);
-	graphEdgeFree(newEdge);
+	++graph->edgesCount;
+	graphReachIndexAddEdge(graph, from, to);
 	return GRAPH_SUCCESS;
 }
 
-GraphResult graphRemoveDirectedEdge(Graph graph, GraphVertex from, GraphVertex to) {
-	if (graph == NULL || from == NULL || to == NULL) {
+GraphResult graphRemoveDirectedEdgeById(Graph graph, int from, int to) {
+	if (graph == NULL) {
 		return GRAPH_NULL_ARGUMENT;
 	}
-	if (!graphIsDirectedEdgeExists(graph, from, to)) {
+	if (!graphIsIdUsed(graph, from) || !graphIsIdUsed(graph, to) ||
+			!graphAdjacencyRemove(&graph->vertices[from].out, to)) {
 		return GRAPH_EDGE_DOES_NOT_EXISTS;
 	}
-	GraphEdge edge = graphEdgeCreate(graph, from, to);
-	if (edge == NULL) {
-		return GRAPH_OUT_OF_MEMORY;
-	}
-	setRemove(graph->edges, edge);
-	graphEdgeFree(edge);
+	bool removed = graphAdjacencyRemove(&graph->vertices[to].in, from);
+	assert(removed);
+	(void)removed;
+	--graph->edgesCount;
+	graphReachIndexInvalidate(graph);
 	return GRAPH_SUCCESS;
 }
 
-bool graphIsDirectedEdgeExists(Graph graph,  GraphVertex from, GraphVertex to){
-	if (graph == NULL || from == NULL || to == NULL) {
+bool graphIsDirectedEdgeExistsById(ConstGraph graph, int from, int to) {
+	if (graph == NULL || !graphIsIdUsed(graph, from) || !graphIsIdUsed(graph, to)) {
 		return false;
 	}
+	int position;
+	return graphAdjacencyFind(&graph->vertices[from].out, to, &position);
+}
 
-	GraphEdge edge = graphEdgeCreate(graph, from, to);
-	bool isIn = setIsIn(graph->edges, edge);
-	graphEdgeFree(edge);
-	return isIn;
+/** initializes cursor over adjacency of vertex with given id */
+static GraphResult graphNeighborCursorInit(ConstGraph graph, int id, bool out,
+		GraphNeighborCursor *cursor) {
+	if (graph == NULL || cursor == NULL) {
+		return GRAPH_NULL_ARGUMENT;
+	}
+	if (!graphIsIdUsed(graph, id)) {
+		return GRAPH_VERTEX_DOES_NOT_EXISTS;
+	}
+	const GraphAdjacency *adjacency = out ? &graph->vertices[id].out : &graph->vertices[id].in;
+	cursor->graph = graph;
+	cursor->ids = adjacency->ids;
+	cursor->count = adjacency->count;
+	cursor->position = 0;
+	return GRAPH_SUCCESS;
 }
 
-GraphResult graphClear(Graph graph) {
-	if (graph == NULL) {
+GraphResult graphGetOutNeighbors(ConstGraph graph, GraphVertex vertex,
+		GraphNeighborCursor *cursor) {
+	if (graph == NULL || vertex == NULL) {
 		return GRAPH_NULL_ARGUMENT;
 	}
+	return graphNeighborCursorInit(graph, graphFindId(graph, vertex), true, cursor);
+}
 
-	setClear(graph->edges);
-	setClear(graph->vertices);
+GraphResult graphGetInNeighbors(ConstGraph graph, GraphVertex vertex,
+		GraphNeighborCursor *cursor) {
+	if (graph == NULL || vertex == NULL) {
+		return GRAPH_NULL_ARGUMENT;
+	}
+	return graphNeighborCursorInit(graph, graphFindId(graph, vertex), false, cursor);
+}
 
-	return GRAPH_SUCCESS;
+GraphResult graphGetOutNeighborsById(ConstGraph graph, int id, GraphNeighborCursor *cursor) {
+	return graphNeighborCursorInit(graph, id, true, cursor);
+}
+
+GraphResult graphGetInNeighborsById(ConstGraph graph, int id, GraphNeighborCursor *cursor) {
+	return graphNeighborCursorInit(graph, id, false, cursor);
+}
+
+int graphNeighborCursorNextId(GraphNeighborCursor *cursor) {
+	if (cursor == NULL || cursor->position >= cursor->count) {
+		return -1;
+	}
+	return cursor->ids[cursor->position++];
+}
+
+GraphVertex graphNeighborCursorNext(GraphNeighborCursor *cursor) {
+	int id = graphNeighborCursorNextId(cursor);
+	return id < 0 ? NULL : cursor->graph->vertices[id].vertex;
+}
+
+int graphOutDegreeById(ConstGraph graph, int id) {
+	if (graph == NULL || !graphIsIdUsed(graph, id)) {
+		return -1;
+	}
+	return graph->vertices[id].out.count;
+}
+
+int graphInDegreeById(ConstGraph graph, int id) {
+	if (graph == NULL || !graphIsIdUsed(graph, id)) {
+		return -1;
+	}
+	return graph->vertices[id].in.count;
+}
+
+int graphOutDegree(ConstGraph graph, GraphVertex vertex) {
+	if (graph == NULL || vertex == NULL) {
+		return -1;
+	}
+	return graphOutDegreeById(graph, graphFindId(graph, vertex));
+}
+
+int graphInDegree(ConstGraph graph, GraphVertex vertex) {
+	if (graph == NULL || vertex == NULL) {
+		return -1;
+	}
+	return graphInDegreeById(graph, graphFindId(graph, vertex));
+}
+
+/** Memory of a breadth first traversal */
+typedef struct GraphTraversal_t {
+	uint64_t *visited;
+	/** frontier of bottom-up levels */
+	uint64_t *frontierBits;
+	int *frontier;
+	int *next;
+} GraphTraversal;
+
+static void graphTraversalFree(GraphTraversal *traversal) {
+	free(traversal->visited);
+	free(traversal->frontierBits);
+	free(traversal->frontier);
+	free(traversal->next);
+}
+
+/** allocates traversal of graph, returns false on allocation failure */
+static bool graphTraversalInit(ConstGraph graph, GraphTraversal *traversal) {
+	int words = GRAPH_BITSET_WORDS(graph->idBound);
+	traversal->visited = (uint64_t*)calloc(words, sizeof(uint64_t));
+	traversal->frontierBits = (uint64_t*)malloc(words * sizeof(uint64_t));
+	traversal->frontier = (int*)malloc(graph->idBound * sizeof(int));
+	traversal->next = (int*)malloc(graph->idBound * sizeof(int));
+	if (traversal->visited == NULL || traversal->frontierBits == NULL ||
+			traversal->frontier == NULL || traversal->next == NULL) {
+		graphTraversalFree(traversal);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * visits unvisited out-neighbors of the frontier, adding them to next level
+ * @return false if the visitor stopped the traversal
+ */
+static bool graphVisitTopDown(ConstGraph graph, GraphTraversal *traversal,
+		int frontierSize, int *nextSize, int depth, visitGraphVertex visit, void *context) {
+	for (int i = 0; i < frontierSize; ++i) {
+		const GraphAdjacency *out = &graph->vertices[traversal->frontier[i]].out;
+		for (int j = 0; j < out->count; ++j) {
+			int id = out->ids[j];
+			if (GRAPH_BIT_TEST(traversal->visited, id)) {
+				continue;
+			}
+			GRAPH_BIT_SET(traversal->visited, id);
+			traversal->next[(*nextSize)++] = id;
+			if (!visit(graph->vertices[id].vertex, id, depth, context)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * checks every unvisited vertex for an in-neighbor in the frontier, which
+ * is cheaper than walking out-edges of a frontier holding most of the graph
+ * @return false if the visitor stopped the traversal
+ */
+static bool graphVisitBottomUp(ConstGraph graph, GraphTraversal *traversal,
+		int frontierSize, int *nextSize, int depth, visitGraphVertex visit, void *context) {
+	memset(traversal->frontierBits, 0,
+			GRAPH_BITSET_WORDS(graph->idBound) * sizeof(uint64_t));
+	for (int i = 0; i < frontierSize; ++i) {
+		GRAPH_BIT_SET(traversal->frontierBits, traversal->frontier[i]);
+	}
+	for (int id = 0; id < graph->idBound; ++id) {
+		if (GRAPH_BIT_TEST(traversal->visited, id) || !graphIsIdUsed(graph, id)) {
+			continue;
+		}
+		const GraphAdjacency *in = &graph->vertices[id].in;
+		for (int j = 0; j < in->count; ++j) {
+			if (GRAPH_BIT_TEST(traversal->frontierBits, in->ids[j])) {
+				GRAPH_BIT_SET(traversal->visited, id);
+				traversal->next[(*nextSize)++] = id;
+				if (!visit(graph->vertices[id].vertex, id, depth, context)) {
+					return false;
+				}
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * breadth first traversal from source up to max_depth (unbounded if
+ * negative), switching between top-down and bottom-up levels
+ */
+static GraphResult graphTraverse(ConstGraph graph, int source, int max_depth,
+		visitGraphVertex visit, void *context) {
+	GraphTraversal traversal;
+	if (!graphTraversalInit(graph, &traversal)) {
+		return GRAPH_OUT_OF_MEMORY;
+	}
+	GRAPH_BIT_SET(traversal.visited, source);
+	traversal.frontier[0] = source;
+	int frontierSize = 1;
+	long unexplored = graph->edgesCount - graph->vertices[source].out.count;
+	bool proceed = visit(graph->vertices[source].vertex, source, 0, context);
+	bool bottomUp = false;
+	for (int depth = 1; proceed && frontierSize > 0 && (max_depth < 0 || depth <= max_depth);
+			++depth) {
+		long frontierEdges = 0;
+		for (int i = 0; i < frontierSize; ++i) {
+			frontierEdges += graph->vertices[traversal.frontier[i]].out.count;
+		}
+		if (!bottomUp && frontierEdges > unexplored / GRAPH_BFS_BOTTOM_UP_EDGES) {
+			bottomUp = true;
+		} else if (bottomUp &&
+				frontierSize < graph->verticesCount / GRAPH_BFS_TOP_DOWN_VERTICES) {
+			bottomUp = false;
+		}
+		int nextSize = 0;
+		proceed = bottomUp ?
+				graphVisitBottomUp(graph, &traversal, frontierSize, &nextSize, depth, visit, context) :
+				graphVisitTopDown(graph, &traversal, frontierSize, &nextSize, depth, visit, context);
+		for (int i = 0; i < nextSize; ++i) {
+			unexplored -= graph->vertices[traversal.next[i]].out.count;
+		}
+		int *swap = traversal.frontier;
+		traversal.frontier = traversal.next;
+		traversal.next = swap;
+		frontierSize = nextSize;
+	}
+	graphTraversalFree(&traversal);
+	return GRAPH_SUCCESS;
+}
+
+GraphResult graphBFS(ConstGraph graph, GraphVertex source, visitGraphVertex visit,
+		void *context) {
+	return graphBFSBounded(graph, source, INT_MAX, visit, context);
+}
+
+GraphResult graphBFSBounded(ConstGraph graph, GraphVertex source, int max_depth,
+		visitGraphVertex visit, void *context) {
+	if (graph == NULL || source == NULL || visit == NULL) {
+		return GRAPH_NULL_ARGUMENT;
+	}
+	if (max_depth < 0) {
+		return GRAPH_OUT_OF_RANGE;
+	}
+	int id = graphFindId(graph, source);
+	if (id < 0) {
+		return GRAPH_VERTEX_DOES_NOT_EXISTS;
+	}
+	return graphTraverse(graph, id, max_depth, visit, context);
+}
+
+#ifndef __GNUC__
+static uint64_t graphFetchOr(uint64_t *word, uint64_t bits) {
+	uint64_t old = *word;
+	*word |= bits;
+	return old;
+}
+#endif
+
+/**
+ * Level synchronous traversal shared by workers. Workers take chunks of the
+ * frontier (top-down) or of all ids (bottom-up) and claim vertices by setting
+ * their visited bits atomically. The last worker to finish a level prepares
+ * the next one while the others wait.
+ */
+typedef struct GraphParallelJob_t {
+	const struct Graph_t *graph;
+	int *levels;
+	GraphTraversal traversal;
+	int depth;
+	int frontierSize;
+	bool bottomUp;
+	bool done;
+	/** edges from unvisited vertices */
+	long unexplored;
+	pthread_mutex_t lock;
+	pthread_cond_t levelDone;
+	int threads;
+	int waiting;
+	int generation;
+	/** guarded by lock: next chunk to take and state of the next level */
+	int nextChunk;
+	int nextSize;
+	long nextEdges;
+} GraphParallelJob;
+
+/** Vertices a worker found, before they are moved to the next level */
+typedef struct GraphParallelBuffer_t {
+	int ids[GRAPH_PARALLEL_BUFFER];
+	int count;
+	long edges;
+} GraphParallelBuffer;
+
+/** moves found vertices to the next level */
+static void graphParallelFlush(GraphParallelJob *job, GraphParallelBuffer *buffer) {
+	if (buffer->count == 0) {
+		return;
+	}
+	pthread_mutex_lock(&job->lock);
+	int position = job->nextSize;
+	job->nextSize += buffer->count;
+	job->nextEdges += buffer->edges;
+	pthread_mutex_unlock(&job->lock);
+	memcpy(job->traversal.next + position, buffer->ids, buffer->count * sizeof(int));
+	buffer->count = 0;
+	buffer->edges = 0;
+}
+
+/** claims vertex for the next level, returns false if it was already visited */
+static bool graphParallelClaim(GraphParallelJob *job, GraphParallelBuffer *buffer, int id) {
+	uint64_t *word = job->traversal.visited + id / 64;
+	uint64_t bit = (uint64_t)1 << (id % 64);
+	if ((GRAPH_ATOMIC_LOAD(word) & bit) != 0 ||
+			(GRAPH_ATOMIC_FETCH_OR(word, bit) & bit) != 0) {
+		return false;
+	}
+	job->levels[id] = job->depth;
+	buffer->ids[buffer->count++] = id;
+	buffer->edges += job->graph->vertices[id].out.count;
+	if (buffer->count == GRAPH_PARALLEL_BUFFER) {
+		graphParallelFlush(job, buffer);
+	}
+	return true;
+}
+
+/** takes chunks of the current level until there are no more */
+static void graphParallelLevel(GraphParallelJob *job) {
+	ConstGraph graph = job->graph;
+	int limit = job->bottomUp ? graph->idBound : job->frontierSize;
+	GraphParallelBuffer buffer;
+	buffer.count = 0;
+	buffer.edges = 0;
+	while (true) {
+		pthread_mutex_lock(&job->lock);
+		int begin = job->nextChunk;
+		int end = limit - begin > GRAPH_PARALLEL_CHUNK ? begin + GRAPH_PARALLEL_CHUNK : limit;
+		job->nextChunk = end;
+		pthread_mutex_unlock(&job->lock);
+		if (begin >= end) {
+			break;
+		}
+		for (int i = begin; i < end; ++i) {
+			if (!job->bottomUp) {
+				const GraphAdjacency *out = &graph->vertices[job->traversal.frontier[i]].out;
+				for (int j = 0; j < out->count; ++j) {
+					graphParallelClaim(job, &buffer, out->ids[j]);
+				}
+				continue;
+			}
+			if ((GRAPH_ATOMIC_LOAD(job->traversal.visited + i / 64) >> (i % 64) & 1) != 0 ||
+					!graphIsIdUsed(graph, i)) {
+				continue;
+			}
+			const GraphAdjacency *in = &graph->vertices[i].in;
+			for (int j = 0; j < in->count; ++j) {
+				if (GRAPH_BIT_TEST(job->traversal.frontierBits, in->ids[j])) {
+					graphParallelClaim(job, &buffer, i);
+					break;
+				}
+			}
+		}
+	}
+	graphParallelFlush(job, &buffer);
+}
+
+/** makes the found vertices the frontier and chooses direction, under lock */
+static void graphParallelNextLevel(GraphParallelJob *job) {
+	ConstGraph graph = job->graph;
+	GraphTraversal *traversal = &job->traversal;
+	int *swap = traversal->frontier;
+	traversal->frontier = traversal->next;
+	traversal->next = swap;
+	job->frontierSize = job->nextSize;
+	long frontierEdges = job->nextEdges;
+	job->unexplored -= frontierEdges;
+	job->nextSize = 0;
+	job->nextEdges = 0;
+	job->nextChunk = 0;
+	++job->depth;
+	if (job->frontierSize == 0) {
+		job->done = true;
+		return;
+	}
+	if (!job->bottomUp && frontierEdges > job->unexplored / GRAPH_BFS_BOTTOM_UP_EDGES) {
+		job->bottomUp = true;
+	} else if (job->bottomUp &&
+			job->frontierSize < graph->verticesCount / GRAPH_BFS_TOP_DOWN_VERTICES) {
+		job->bottomUp = false;
+	}
+	if (job->bottomUp) {
+		memset(traversal->frontierBits, 0,
+				GRAPH_BITSET_WORDS(graph->idBound) * sizeof(uint64_t));
+		for (int i = 0; i < job->frontierSize; ++i) {
+			GRAPH_BIT_SET(traversal->frontierBits, traversal->frontier[i]);
+		}
+	}
+}
+
+/** waits for all workers to finish the level, the last one prepares the next */
+static void graphParallelSync(GraphParallelJob *job) {
+	pthread_mutex_lock(&job->lock);
+	int generation = job->generation;
+	if (++job->waiting == job->threads) {
+		graphParallelNextLevel(job);
+		job->waiting = 0;
+		++job->generation;
+		pthread_cond_broadcast(&job->levelDone);
+	} else {
+		while (generation == job->generation) {
+			pthread_cond_wait(&job->levelDone, &job->lock);
+		}
+	}
+	pthread_mutex_unlock(&job->lock);
+}
+
+static void *graphParallelWorkerMain(void *argument) {
+	GraphParallelJob *job = (GraphParallelJob*)argument;
+	// state of the level is stable between synchronizations
+	while (!job->done) {
+		graphParallelLevel(job);
+		graphParallelSync(job);
+	}
+	return NULL;
+}
+
+GraphResult graphParallelBFS(ConstGraph graph, GraphVertex source, int nthreads,
+		int *out_levels) {
+	if (graph == NULL || source == NULL || out_levels == NULL) {
+		return GRAPH_NULL_ARGUMENT;
+	}
+	if (nthreads <= 0) {
+		return GRAPH_OUT_OF_RANGE;
+	}
+	int sourceId = graphFindId(graph, source);
+	if (sourceId < 0) {
+		return GRAPH_VERTEX_DOES_NOT_EXISTS;
+	}
+	GraphParallelJob job;
+	if (!graphTraversalInit(graph, &job.traversal)) {
+		return GRAPH_OUT_OF_MEMORY;
+	}
+	int helpers = GRAPH_PARALLEL_THREADS(nthreads) - 1;
+	pthread_t *threads = (pthread_t*)malloc((helpers + 1) * sizeof(*threads));
+	if (threads == NULL || pthread_mutex_init(&job.lock, NULL) != 0) {
+		free(threads);
+		graphTraversalFree(&job.traversal);
+		return GRAPH_OUT_OF_MEMORY;
+	}
+	if (pthread_cond_init(&job.levelDone, NULL) != 0) {
+		pthread_mutex_destroy(&job.lock);
+		free(threads);
+		graphTraversalFree(&job.traversal);
+		return GRAPH_OUT_OF_MEMORY;
+	}
+	for (int id = 0; id < graph->idBound; ++id) {
+		out_levels[id] = -1;
+	}
+	out_levels[sourceId] = 0;
+	GRAPH_BIT_SET(job.traversal.visited, sourceId);
+	job.traversal.next[0] = sourceId;
+	job.graph = graph;
+	job.levels = out_levels;
+	job.depth = 0;
+	job.frontierSize = 0;
+	job.bottomUp = false;
+	job.done = false;
+	job.unexplored = graph->edgesCount;
+	job.waiting = 0;
+	job.generation = 0;
+	job.nextSize = 1;
+	job.nextEdges = graph->vertices[sourceId].out.count;
+	graphParallelNextLevel(&job);
+
+	// workers take no chunk before they are all counted, threads which could
+	// not be started leave their share to the others
+	pthread_mutex_lock(&job.lock);
+	int started = 0;
+	for (int i = 0; i < helpers; ++i) {
+		if (pthread_create(threads + started, NULL, graphParallelWorkerMain, &job) == 0) {
+			++started;
+		}
+	}
+	job.threads = started + 1;
+	pthread_mutex_unlock(&job.lock);
+	graphParallelWorkerMain(&job);
+	for (int i = 0; i < started; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_cond_destroy(&job.levelDone);
+	pthread_mutex_destroy(&job.lock);
+	free(threads);
+	graphTraversalFree(&job.traversal);
+	return GRAPH_SUCCESS;
+}
+
+/** Target of reachability query, and whether it was reached */
+typedef struct GraphReachQuery_t {
+	int target;
+	bool reached;
+} GraphReachQuery;
+
+static bool graphVisitReach(GraphVertex vertex, int id, int depth, void *context) {
+	(void)vertex;
+	(void)depth;
+	GraphReachQuery *query = context;
+	query->reached = id == query->target;
+	return !query->reached;
+}
+
+bool graphIsReachableById(ConstGraph graph, int from, int to) {
+	if (graph == NULL || !graphIsIdUsed(graph, from) || !graphIsIdUsed(graph, to)) {
+		return false;
+	}
+	if (from == to) {
+		return true;
+	}
+	if (graph->vertices[from].out.count == 0 || graph->vertices[to].in.count == 0) {
+		return false;
+	}
+	// without memory for the index or for the search of it the graph is
+	// traversed
+	const GraphReachIndex *index = graph->reach;
+	if (index != NULL && index->valid) {
+		int source = index->component[from];
+		int target = index->component[to];
+		int reached = graphReachIndexCheckIntervals(index, source, target);
+		if (reached >= 0) {
+			return reached;
+		}
+		bool *seen = (bool*)calloc(index->componentsCount, sizeof(bool));
+		int *queue = (int*)malloc(index->componentsCount * sizeof(int));
+		if (seen != NULL && queue != NULL) {
+			reached = graphReachIndexSearch(index, seen, queue, source, target);
+		}
+		free(seen);
+		free(queue);
+		if (reached >= 0) {
+			return reached;
+		}
+	}
+	GraphReachQuery query = { to, false };
+	return graphTraverse(graph, from, -1, graphVisitReach, &query) == GRAPH_SUCCESS &&
+			query.reached;
+}
+
+GraphResult graphSetReachabilityIndex(Graph graph, bool enabled) {
+	if (graph == NULL) {
+		return GRAPH_NULL_ARGUMENT;
+	}
+	if (!enabled && graph->reach != NULL) {
+		graphReachIndexRelease(graph->reach);
+		free(graph->reach);
+		graph->reach = NULL;
+	} else if (enabled && graph->reach == NULL) {
+		GRAPH_ALLOCATE(GraphReachIndex, graph->reach, GRAPH_OUT_OF_MEMORY);
+		*graph->reach = (GraphReachIndex){ .valid = false };
+	}
+	if (enabled && !graph->reach->valid && !graphReachIndexBuild(graph, graph->reach)) {
+		free(graph->reach);
+		graph->reach = NULL;
+		return GRAPH_OUT_OF_MEMORY;
+	}
+	return GRAPH_SUCCESS;
+}
+
+bool graphIsReachable(ConstGraph graph, GraphVertex from, GraphVertex to) {
+	if (graph == NULL || from == NULL || to == NULL) {
+		return false;
+	}
+	return graphIsReachableById(graph, graphFindId(graph, from), graphFindId(graph, to));
+}
+
+/** Edge given by ids of its ends */
+typedef struct GraphEdgePair_t {
+	int from;
+	int to;
+	/** position in a batch of edges, 0 elsewhere */
+	int item;
+} GraphEdgePair;
+
+/** orders edges by start, then by end */
+static int graphCompareEdgePairs(const void *edge1, const void *edge2) {
+	const GraphEdgePair *first = edge1, *second = edge2;
+	if (first->from != second->from) {
+		return (first->from > second->from) - (first->from < second->from);
+	}
+	return (first->to > second->to) - (first->to < second->to);
+}
+
+/**
+ * sorts edges by id of start, or of end, below bound into sorted, keeping
+ * order of edges with equal ids (counting sort)
+ * @return false on allocation failure
+ */
+static bool graphSortEdgePairs(const GraphEdgePair *edges, GraphEdgePair *sorted, int count,
+		int bound, bool byStart) {
+	int *offsets = (int*)calloc(bound + 1, sizeof(int));
+	if (offsets == NULL) {
+		return false;
+	}
+	for (int i = 0; i < count; ++i) {
+		++offsets[(byStart ? edges[i].from : edges[i].to) + 1];
+	}
+	for (int id = 0; id < bound; ++id) {
+		offsets[id + 1] += offsets[id];
+	}
+	for (int i = 0; i < count; ++i) {
+		sorted[offsets[byStart ? edges[i].from : edges[i].to]++] = edges[i];
+	}
+	free(offsets);
+	return true;
+}
+
+static GraphVertex graphCopyComponent(GraphVertex component) {
+	int *copy = (int*)malloc(sizeof(*copy));
+	if (copy != NULL) {
+		*copy = *(int*)component;
+	}
+	return copy;
+}
+
+static int graphCompareComponents(GraphVertex component1, GraphVertex component2) {
+	int first = *(int*)component1, second = *(int*)component2;
+	return (first > second) - (first < second);
+}
+
+/**
+ * creates graph of components with an edge wherever graph has one between
+ * them. Edges are added sorted, so every adjacency grows at its end.
+ */
+static Graph graphCondense(ConstGraph graph, const int *component, int count) {
+	Graph condensation = graphCreate(graphCopyComponent, graphCompareComponents, free);
+	GraphEdgePair *edges = (GraphEdgePair*)malloc((graph->edgesCount + 1) * sizeof(*edges));
+	if (condensation == NULL || edges == NULL) {
+		graphDestroy(condensation);
+		free(edges);
+		return NULL;
+	}
+	// ids of a new graph are given in order, so component i gets id i
+	for (int i = 0; i < count; ++i) {
+		if (graphAddVertex(condensation, &i) != GRAPH_SUCCESS) {
+			graphDestroy(condensation);
+			free(edges);
+			return NULL;
+		}
+	}
+	long edgesCount = 0;
+	for (int id = 0; id < graph->idBound; ++id) {
+		if (!graphIsIdUsed(graph, id)) {
+			continue;
+		}
+		const GraphAdjacency *out = &graph->vertices[id].out;
+		for (int j = 0; j < out->count; ++j) {
+			if (component[id] != component[out->ids[j]]) {
+				edges[edgesCount++] = (GraphEdgePair){ component[id], component[out->ids[j]], 0 };
+			}
+		}
+	}
+	qsort(edges, edgesCount, sizeof(*edges), graphCompareEdgePairs);
+	for (long i = 0; i < edgesCount; ++i) {
+		if (i > 0 && graphCompareEdgePairs(edges + i - 1, edges + i) == 0) {
+			continue;
+		}
+		if (graphAddDirectedEdgeById(condensation, edges[i].from, edges[i].to) !=
+				GRAPH_SUCCESS) {
+			graphDestroy(condensation);
+			free(edges);
+			return NULL;
+		}
+	}
+	free(edges);
+	return condensation;
+}
+
+GraphResult graphComputeSCC(ConstGraph graph, int *out_components, int *out_count,
+		Graph *out_condensation) {
+	if (graph == NULL || out_components == NULL || out_count == NULL) {
+		return GRAPH_NULL_ARGUMENT;
+	}
+	int count = graphFindComponents(graph, out_components);
+	if (count < 0) {
+		return GRAPH_OUT_OF_MEMORY;
+	}
+	if (out_condensation != NULL) {
+		*out_condensation = graphCondense(graph, out_components, count);
+		if (*out_condensation == NULL) {
+			return GRAPH_OUT_OF_MEMORY;
+		}
+	}
+	*out_count = count;
+	return GRAPH_SUCCESS;
+}
+
+/**
+ * sorts positions of vertices by compareVertex of graph, keeping positions of
+ * equal vertices in order (bottom-up merge sort, as qsort can not pass the
+ * graph to comparison)
+ */
+static void graphSortVertices(ConstGraph graph, GraphVertex *vertices, int *positions,
+		int *buffer, int count) {
+	int *source = positions, *target = buffer;
+	for (int width = 1; width < count; width *= 2) {
+		for (int begin = 0; begin < count; begin += 2 * width) {
+			int middle = begin + width < count ? begin + width : count;
+			int end = middle + width < count ? middle + width : count;
+			int left = begin, right = middle;
+			for (int k = begin; k < end; ++k) {
+				if (left < middle && (right == end || graph->compareVertex(
+						vertices[source[left]], vertices[source[right]]) <= 0)) {
+					target[k] = source[left++];
+				} else {
+					target[k] = source[right++];
+				}
+			}
+		}
+		int *swap = source;
+		source = target;
+		target = swap;
+	}
+	if (source != positions) {
+		memcpy(positions, source, count * sizeof(*positions));
+	}
+}
+
+GraphResult graphAddVerticesBatch(Graph graph, GraphVertex *vertices, int n,
+		GraphResult *results) {
+	if (graph == NULL || vertices == NULL || results == NULL) {
+		return GRAPH_NULL_ARGUMENT;
+	}
+	if (n < 0) {
+		return GRAPH_OUT_OF_RANGE;
+	}
+	int *positions = (int*)malloc((n + 1) * sizeof(int));
+	int *buffer = (int*)malloc((n + 1) * sizeof(int));
+	int *merged = (int*)malloc((graph->verticesCount + n + 1) * sizeof(int));
+	if (positions == NULL || buffer == NULL || merged == NULL ||
+			!graphReserveVertices(graph, n)) {
+		free(positions);
+		free(buffer);
+		free(merged);
+		return GRAPH_OUT_OF_MEMORY;
+	}
+	int count = 0;
+	for (int i = 0; i < n; ++i) {
+		if (vertices[i] == NULL) {
+			results[i] = GRAPH_NULL_ARGUMENT;
+		} else {
+			positions[count++] = i;
+		}
+	}
+	graphSortVertices(graph, vertices, positions, buffer, count);
+
+	// merge the sorted vertices into the sorted ids of graph, the first of
+	// equal vertices is added
+	int existing = 0, size = 0;
+	GraphVertex added = NULL;
+	for (int i = 0; i < count; ++i) {
+		GraphVertex vertex = vertices[positions[i]];
+		while (existing < graph->verticesCount && graph->compareVertex(
+				graph->vertices[graph->order[existing]].vertex, vertex) < 0) {
+			merged[size++] = graph->order[existing++];
+		}
+		if ((added != NULL && graph->compareVertex(added, vertex) == 0) ||
+				(existing < graph->verticesCount && graph->compareVertex(
+				graph->vertices[graph->order[existing]].vertex, vertex) == 0)) {
+			results[positions[i]] = GRAPH_VERTEX_ALREADY_EXISTS;
+			continue;
+		}
+		GraphVertex copy = graph->copyVertex(vertex);
+		if (copy == NULL) {
+			results[positions[i]] = GRAPH_OUT_OF_MEMORY;
+			continue;
+		}
+		int id = graph->freeCount > 0 ? graph->freeIds[--graph->freeCount] : graph->idBound++;
+		GraphVertexEntry *entry = graph->vertices + id;
+		entry->vertex = copy;
+		entry->out = entry->in = (GraphAdjacency){ NULL, 0, 0 };
+		graphReachIndexAddVertex(graph, id);
+		merged[size++] = id;
+		added = copy;
+		results[positions[i]] = GRAPH_SUCCESS;
+	}
+	while (existing < graph->verticesCount) {
+		merged[size++] = graph->order[existing++];
+	}
+	if (size > graph->verticesCount) {
+		memcpy(graph->order, merged, size * sizeof(*merged));
+		graph->verticesCount = size;
+	}
+	free(positions);
+	free(buffer);
+	free(merged);
+	return GRAPH_SUCCESS;
+}
+
+/**
+ * merges sorted ids of the other ends of edges into adjacency, which has
+ * room for them and none of them, from its end down
+ */
+static void graphAdjacencyMerge(GraphAdjacency *adjacency, const GraphEdgePair *edges,
+		int count, bool out) {
+	int old = adjacency->count - 1, position = adjacency->count + count - 1;
+	for (int k = count - 1; k >= 0;) {
+		int id = out ? edges[k].to : edges[k].from;
+		if (old >= 0 && adjacency->ids[old] > id) {
+			adjacency->ids[position--] = adjacency->ids[old--];
+		} else {
+			adjacency->ids[position--] = id;
+			--k;
+		}
+	}
+	adjacency->count += count;
+}
+
+/**
+ * reserves or merges adjacency of every vertex for edges, which are sorted
+ * by the vertex: by start for out-edges, by end for in-edges
+ * @return false on allocation failure
+ */
+static bool graphAddEdgeGroups(Graph graph, const GraphEdgePair *edges, int count,
+		bool out, bool merge) {
+	for (int begin = 0, end; begin < count; begin = end) {
+		int id = out ? edges[begin].from : edges[begin].to;
+		for (end = begin + 1;
+				end < count && (out ? edges[end].from : edges[end].to) == id; ++end) {
+		}
+		GraphAdjacency *adjacency = out ? &graph->vertices[id].out : &graph->vertices[id].in;
+		if (merge) {
+			graphAdjacencyMerge(adjacency, edges + begin, end - begin, out);
+		} else if (!graphAdjacencyReserve(adjacency, end - begin)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * finds ids of ends of edges by sorting them and walking them together with
+ * sorted vertices of graph, -1 for missing or NULL ones
+ * @return false on allocation failure
+ */
+static bool graphFindBatchIds(ConstGraph graph, GraphVertex *from, GraphVertex *to, int n,
+		GraphEdgePair *edges) {
+	GraphVertex *ends = (GraphVertex*)malloc((2 * (long)n + 1) * sizeof(*ends));
+	int *positions = (int*)malloc((2 * (long)n + 1) * sizeof(int));
+	int *buffer = (int*)malloc((2 * (long)n + 1) * sizeof(int));
+	if (ends == NULL || positions == NULL || buffer == NULL) {
+		free(ends);
+		free(positions);
+		free(buffer);
+		return false;
+	}
+	int count = 0;
+	for (int i = 0; i < n; ++i) {
+		edges[i] = (GraphEdgePair){ -1, -1, i };
+		ends[2 * i] = from[i];
+		ends[2 * i + 1] = to[i];
+		if (from[i] != NULL && to[i] != NULL) {
+			positions[count++] = 2 * i;
+			positions[count++] = 2 * i + 1;
+		}
+	}
+	graphSortVertices(graph, ends, positions, buffer, count);
+	int existing = 0, comparison = -1;
+	for (int i = 0; i < count; ++i) {
+		int position = positions[i];
+		// equal ends share the comparison with the vertex found for the first
+		if (i == 0 || graph->compareVertex(ends[positions[i - 1]], ends[position]) != 0) {
+			comparison = -1;
+			while (existing < graph->verticesCount && (comparison = graph->compareVertex(
+					graph->vertices[graph->order[existing]].vertex, ends[position])) < 0) {
+				++existing;
+			}
+		}
+		int id = comparison == 0 ? graph->order[existing] : -1;
+		if (position % 2 == 0) {
+			edges[position / 2].from = id;
+		} else {
+			edges[position / 2].to = id;
+		}
+	}
+	free(ends);
+	free(positions);
+	free(buffer);
+	return true;
+}
+
+GraphResult graphAddEdgesBatch(Graph graph, GraphVertex *from, GraphVertex *to, int n,
+		GraphResult *results) {
+	if (graph == NULL || from == NULL || to == NULL || results == NULL) {
+		return GRAPH_NULL_ARGUMENT;
+	}
+	if (n < 0) {
+		return GRAPH_OUT_OF_RANGE;
+	}
+	GraphEdgePair *edges = (GraphEdgePair*)malloc((n + 1) * sizeof(*edges));
+	GraphEdgePair *byEnd = (GraphEdgePair*)malloc((n + 1) * sizeof(*byEnd));
+	if (edges == NULL || byEnd == NULL) {
+		free(edges);
+		free(byEnd);
+		return GRAPH_OUT_OF_MEMORY;
+	}
+	if (!graphFindBatchIds(graph, from, to, n, edges)) {
+		free(edges);
+		free(byEnd);
+		return GRAPH_OUT_OF_MEMORY;
+	}
+	int count = 0;
+	for (int i = 0; i < n; ++i) {
+		if (from[i] == NULL || to[i] == NULL) {
+			results[i] = GRAPH_NULL_ARGUMENT;
+		} else if (edges[i].from < 0 || edges[i].to < 0) {
+			results[i] = GRAPH_VERTEX_DOES_NOT_EXISTS;
+		} else {
+			edges[count++] = edges[i];
+		}
+	}
+	// sorted by end and then by start, equal edges stay in order of the batch
+	if (!graphSortEdgePairs(edges, byEnd, count, graph->idBound, false) ||
+			!graphSortEdgePairs(byEnd, edges, count, graph->idBound, true)) {
+		free(edges);
+		free(byEnd);
+		return GRAPH_OUT_OF_MEMORY;
+	}
+
+	// the first of equal edges is added
+	int accepted = 0;
+	for (int i = 0; i < count; ++i) {
+		int position;
+		if ((accepted > 0 && edges[accepted - 1].from == edges[i].from &&
+				edges[accepted - 1].to == edges[i].to) ||
+				graphAdjacencyFind(&graph->vertices[edges[i].from].out, edges[i].to,
+				&position)) {
+			results[edges[i].item] = GRAPH_EDGE_ALREADY_EXISTS;
+			continue;
+		}
+		results[edges[i].item] = GRAPH_SUCCESS;
+		edges[accepted++] = edges[i];
+	}
+
+	// merging can not fail once every adjacency has room
+	GraphResult result = GRAPH_SUCCESS;
+	if (graphSortEdgePairs(edges, byEnd, accepted, graph->idBound, false) &&
+			graphAddEdgeGroups(graph, edges, accepted, true, false) &&
+			graphAddEdgeGroups(graph, byEnd, accepted, false, false)) {
+		graphAddEdgeGroups(graph, edges, accepted, true, true);
+		graphAddEdgeGroups(graph, byEnd, accepted, false, true);
+		graph->edgesCount += accepted;
+		if (accepted > 0) {
+			graphReachIndexInvalidate(graph);
+		}
+	} else {
+		for (int i = 0; i < accepted; ++i) {
+			results[edges[i].item] = GRAPH_OUT_OF_MEMORY;
+		}
+		result = GRAPH_OUT_OF_MEMORY;
+	}
+	free(edges);
+	free(byEnd);
+	return result;
+}
+
+GraphResult graphAddDirectedEdge(Graph graph, GraphVertex from, GraphVertex to){
+	if (graph == NULL || from == NULL || to == NULL) {
+		return GRAPH_NULL_ARGUMENT;
+	}
+	return graphAddDirectedEdgeById(graph, graphFindId(graph, from), graphFindId(graph, to));
+}
+
+GraphResult graphRemoveDirectedEdge(Graph graph, GraphVertex from, GraphVertex to) {
+	if (graph == NULL || from == NULL || to == NULL) {
+		return GRAPH_NULL_ARGUMENT;
+	}
+	int fromId = graphFindId(graph, from);
+	if (fromId < 0 || graph->vertices[fromId].out.count == 0) {
+		return GRAPH_EDGE_DOES_NOT_EXISTS;
+	}
+	return graphRemoveDirectedEdgeById(graph, fromId, graphFindId(graph, to));
+}
+
+bool graphIsDirectedEdgeExists(Graph graph,  GraphVertex from, GraphVertex to){
+	if (graph == NULL || from == NULL || to == NULL) {
+		return false;
+	}
+
+	// a vertex without out-edges needs no search for the other end
+	int fromId = graphFindId(graph, from);
+	if (fromId < 0 || graph->vertices[fromId].out.count == 0) {
+		return false;
+	}
+	return graphIsDirectedEdgeExistsById(graph, fromId, graphFindId(graph, to));
+}
+
+GraphResult graphClear(Graph graph) {
+	if (graph == NULL) {
+		return GRAPH_NULL_ARGUMENT;
+	}
+
+	for (int i = 0; i < graph->verticesCount; ++i) {
+		graphVertexEntryFree(graph, graph->order[i]);
+	}
+	graph->verticesCount = 0;
+	graph->edgesCount = 0;
+	graph->idBound = 0;
+	graph->freeCount = 0;
+	graphReachIndexInvalidate(graph);
+
+	return GRAPH_SUCCESS;
+}
+
+/**
+ * Compressed sparse row form of a graph: vertices sorted, so that the id of
+ * a vertex is its position, and out-neighbors of vertex i are
+ * neighbors[offsets[i]] to neighbors[offsets[i + 1] - 1], sorted
+ */
+typedef struct GraphSnapshot_t {
+	compareGraphVertex compareVertex;
+	freeGraphVertex freeVertex;
+	GraphVertex *vertices;
+	int verticesCount;
+	int *offsets;
+	int *neighbors;
+} GraphSnapshot_t;
+
+/** Neighbor ranges up to this length are searched linearly */
+#define GRAPH_SNAPSHOT_LINEAR_SEARCH (8)
+
+static int graphCompareIds(const void *id1, const void *id2) {
+	int first = *(const int*)id1, second = *(const int*)id2;
+	return (first > second) - (first < second);
+}
+
+GraphSnapshot graphFreeze(ConstGraph graph) {
+	if (graph == NULL) {
+		return NULL;
+	}
+	GraphSnapshot snapshot;
+	GRAPH_ALLOCATE(GraphSnapshot_t, snapshot, NULL);
+	int count = graph->verticesCount;
+	snapshot->compareVertex = graph->compareVertex;
+	snapshot->freeVertex = graph->freeVertex;
+	snapshot->verticesCount = 0;
+	snapshot->vertices = (GraphVertex*)malloc((count + 1) * sizeof(GraphVertex));
+	snapshot->offsets = (int*)malloc((count + 1) * sizeof(int));
+	snapshot->neighbors = (int*)malloc((graph->edgesCount + 1) * sizeof(int));
+	// graph id to snapshot id
+	int *renumber = (int*)malloc((graph->idBound + 1) * sizeof(int));
+	if (snapshot->vertices == NULL || snapshot->offsets == NULL ||
+			snapshot->neighbors == NULL || renumber == NULL) {
+		free(renumber);
+		graphSnapshotDestroy(snapshot);
+		return NULL;
+	}
+	for (int i = 0; i < count; ++i) {
+		renumber[graph->order[i]] = i;
+	}
+	int edges = 0;
+	for (int i = 0; i < count; ++i) {
+		const GraphVertexEntry *entry = graph->vertices + graph->order[i];
+		snapshot->vertices[i] = graph->copyVertex(entry->vertex);
+		if (snapshot->vertices[i] == NULL) {
+			free(renumber);
+			graphSnapshotDestroy(snapshot);
+			return NULL;
+		}
+		++snapshot->verticesCount;
+		snapshot->offsets[i] = edges;
+		for (int j = 0; j < entry->out.count; ++j) {
+			snapshot->neighbors[edges + j] = renumber[entry->out.ids[j]];
+		}
+		qsort(snapshot->neighbors + edges, entry->out.count, sizeof(int), graphCompareIds);
+		edges += entry->out.count;
+	}
+	snapshot->offsets[count] = edges;
+	free(renumber);
+	return snapshot;
+}
+
+void graphSnapshotDestroy(GraphSnapshot snapshot) {
+	if (snapshot == NULL) {
+		return;
+	}
+	for (int i = 0; i < snapshot->verticesCount; ++i) {
+		snapshot->freeVertex(snapshot->vertices[i]);
+	}
+	free(snapshot->vertices);
+	free(snapshot->offsets);
+	free(snapshot->neighbors);
+	free(snapshot);
+}
+
+int graphSnapshotGetVertexId(GraphSnapshot snapshot, GraphVertex vertex) {
+	if (snapshot == NULL || vertex == NULL) {
+		return -1;
+	}
+	int low = 0, high = snapshot->verticesCount;
+	while (low < high) {
+		int middle = low + (high - low) / 2;
+		int comparison = snapshot->compareVertex(snapshot->vertices[middle], vertex);
+		if (comparison == 0) {
+			return middle;
+		}
+		if (comparison < 0) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return -1;
+}
+
+GraphVertex graphSnapshotGetVertexById(GraphSnapshot snapshot, int id) {
+	if (snapshot == NULL || id < 0 || id >= snapshot->verticesCount) {
+		return NULL;
+	}
+	return snapshot->vertices[id];
+}
+
+int graphSnapshotGetVerticesCount(GraphSnapshot snapshot) {
+	return snapshot == NULL ? -1 : snapshot->verticesCount;
+}
+
+const int *graphSnapshotGetOutNeighbors(GraphSnapshot snapshot, int id, int *count) {
+	if (snapshot == NULL || count == NULL || id < 0 || id >= snapshot->verticesCount) {
+		return NULL;
+	}
+	*count = snapshot->offsets[id + 1] - snapshot->offsets[id];
+	return snapshot->neighbors + snapshot->offsets[id];
+}
+
+bool graphSnapshotIsDirectedEdgeExistsById(GraphSnapshot snapshot, int from, int to) {
+	if (snapshot == NULL || from < 0 || from >= snapshot->verticesCount ||
+			to < 0 || to >= snapshot->verticesCount) {
+		return false;
+	}
+	int low = snapshot->offsets[from], high = snapshot->offsets[from + 1];
+	while (high - low > GRAPH_SNAPSHOT_LINEAR_SEARCH) {
+		int middle = low + (high - low) / 2;
+		if (snapshot->neighbors[middle] == to) {
+			return true;
+		}
+		if (snapshot->neighbors[middle] < to) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	for (; low < high; ++low) {
+		if (snapshot->neighbors[low] >= to) {
+			return snapshot->neighbors[low] == to;
+		}
+	}
+	return false;
+}
+
+bool graphSnapshotIsDirectedEdgeExists(GraphSnapshot snapshot, GraphVertex from,
+		GraphVertex to) {
+	if (snapshot == NULL || from == NULL || to == NULL) {
+		return false;
+	}
+	return graphSnapshotIsDirectedEdgeExistsById(snapshot,
+			graphSnapshotGetVertexId(snapshot, from), graphSnapshotGetVertexId(snapshot, to));
 }
@@ -23,6 +23,43 @@
  * 										between two vertices exists
  * 		graphClear					- Clears the contents of the graph, frees
  * 										all the vertices and edges
+ * 		graphGetVertexId			- Returns the integer id of a vertex
+ * 		graphGetVertexById			- Returns the vertex with a given id
+ * 		graphGetVertexIdBound		- Returns a bound on ids of all vertices
+ * 		graphAddDirectedEdgeById	- Adds a directed edge between vertices
+ * 										given by ids
+ * 		graphRemoveDirectedEdgeById	- Removes a directed edge between vertices
+ * 										given by ids
+ * 		graphIsDirectedEdgeExistsById - Returns whether or not a directed edge
+ * 										between vertices given by ids exists
+ * 		graphAddVerticesBatch		- Adds many vertices to the graph at once
+ * 		graphAddEdgesBatch			- Adds many directed edges to the graph at
+ * 										once
+ * 		graphGetOutNeighbors		- Starts a cursor over vertices edges from
+ * 										a vertex lead to
+ * 		graphGetInNeighbors			- Starts a cursor over vertices edges to
+ * 										a vertex come from
+ * 		graphNeighborCursorNext		- Advances a neighbor cursor
+ * 		graphOutDegree				- Returns the number of edges from a vertex
+ * 		graphInDegree				- Returns the number of edges to a vertex
+ * 		graphBFS					- Visits vertices reachable from a vertex
+ * 										in breadth first order
+ * 		graphBFSBounded				- Visits vertices up to a given distance
+ * 										from a vertex
+ * 		graphIsReachable			- Returns whether or not there is a path
+ * 										between two vertices
+ * 		graphSetReachabilityIndex	- Turns on or off an index which answers
+ * 										graphIsReachable without traversal
+ * 		graphComputeSCC				- Finds strongly connected components and
+ * 										the graph between them
+ * 		graphParallelBFS			- Computes distances from a vertex with
+ * 										several threads
+ * 		graphFreeze					- Creates an immutable compact snapshot of
+ * 										the graph
+ *
+ * Every vertex is kept once and gets a small non negative integer id, which
+ * stays the same until the vertex is removed; ids of removed vertices are
+ * given to vertices added later. Edges are kept as pairs of ids.
  *
  */
 
@@ -33,6 +70,12 @@ typedef struct Graph_t *Graph;
 /** Type for defining the const graph */
 typedef const struct Graph_t * const ConstGraph;
 
+/**
+ * Type of an immutable snapshot of a graph, which any number of threads can
+ * query at once without locking
+ */
+typedef struct GraphSnapshot_t *GraphSnapshot;
+
 /** Type used for returning error codes from graph functions */
 typedef enum GraphResult_t {
 	GRAPH_SUCCESS,
@@ -41,7 +84,8 @@ typedef enum GraphResult_t {
 	GRAPH_VERTEX_ALREADY_EXISTS,
 	GRAPH_VERTEX_DOES_NOT_EXISTS,
 	GRAPH_EDGE_ALREADY_EXISTS,
-	GRAPH_EDGE_DOES_NOT_EXISTS
+	GRAPH_EDGE_DOES_NOT_EXISTS,
+	GRAPH_OUT_OF_RANGE
 } GraphResult;
 
 /** Vertex data type */
@@ -62,6 +106,25 @@ typedef int(*compareGraphVertex)(GraphVertex, GraphVertex);
 /** Type of function for deallocating a vertex */
 typedef void(*freeGraphVertex)(GraphVertex);
 
+/**
+ * Type of function called for every vertex a traversal reaches, with its id
+ * and distance from the source, and context given to the traversal. The
+ * traversal stops once it returns false.
+ */
+typedef bool(*visitGraphVertex)(GraphVertex vertex, int id, int depth, void *context);
+
+/**
+ * Cursor over out- or in-neighbors of a vertex. It stays valid until the
+ * graph is changed, and any number of cursors can walk the graph at once.
+ * Fields are internal to the graph implementation.
+ */
+typedef struct GraphNeighborCursor_t {
+	const struct Graph_t *graph;
+	const int *ids;
+	int count;
+	int position;
+} GraphNeighborCursor;
+
 /**
  * graphCreate: Allocates a new empty graph
  *
@@ -162,6 +225,342 @@ GraphResult graphRemoveDirectedEdge(Graph graph, GraphVertex from, GraphVertex t
  */
 bool graphIsDirectedEdgeExists(Graph graph,  GraphVertex from, GraphVertex to);
 
+/**
+ * graphGetVertexId: Returns the id of a vertex in the graph
+ *
+ * @param graph - The graph to search in
+ * @param vertex - The vertex to look for
+ * @return
+ * 		-1 if one of parameters is NULL or vertex was not found
+ * 		id of the vertex otherwise
+ */
+int graphGetVertexId(ConstGraph graph, GraphVertex vertex);
+
+/**
+ * graphGetVertexById: Returns the vertex with given id. The vertex belongs to
+ * the graph and must not be changed or freed.
+ *
+ * @param graph - The graph to search in
+ * @param id - The id of the vertex
+ * @return
+ * 		NULL if graph is NULL or no vertex has the id
+ * 		the vertex otherwise
+ */
+GraphVertex graphGetVertexById(ConstGraph graph, int id);
+
+/**
+ * graphGetVertexIdBound: Returns a number greater than every id of a vertex of
+ * the graph, for sizing arrays indexed by ids. It is at most the largest
+ * number of vertices the graph had since it was created or cleared.
+ *
+ * @param graph - The graph to examine
+ * @return
+ * 		-1 if graph is NULL
+ * 		the bound otherwise
+ */
+int graphGetVertexIdBound(ConstGraph graph);
+
+/**
+ * graphAddDirectedEdgeById: Adds a new directed edge between two vertices
+ * given by their ids, as graphAddDirectedEdge does
+ *
+ * @param graph - The graph to which to add a directed edge
+ * @param from - The id of vertex where directed edge begins
+ * @param to - The id of vertex where directed edge ends
+ * @return
+ * 		GRAPH_NULL_ARGUMENT if graph is NULL
+ * 		GRAPH_VERTEX_DOES_NOT_EXISTS if no vertex has one of the ids
+ * 		GRAPH_EDGE_ALREADY_EXISTS if the directed edge already exists
+ * 		GRAPH_OUT_OF_MEMORY if an allocation failed
+ * 		GRAPH_SUCCESS if a directed edge was successfully added
+ */
+GraphResult graphAddDirectedEdgeById(Graph graph, int from, int to);
+
+/**
+ * graphRemoveDirectedEdgeById: Removes a directed edge between two vertices
+ * given by their ids, if exists
+ *
+ * @param graph - The graph to remove edge from
+ * @param from - The id of vertex where directed edge to remove starts
+ * @param to - The id of vertex where directed edge to remove ends
+ * @return
+ * 		GRAPH_NULL_ARGUMENT if graph is NULL
+ * 		GRAPH_EDGE_DOES_NOT_EXISTS if there is no such edge
+ * 		GRAPH_SUCCESS if the edge was removed
+ */
+GraphResult graphRemoveDirectedEdgeById(Graph graph, int from, int to);
+
+/**
+ * graphIsDirectedEdgeExistsById: Checks if directed edge between two vertices
+ * given by their ids is present in graph
+ *
+ * @param graph - The graph to search in
+ * @param from - The id of the start of directed edge
+ * @param to - The id of the end of directed edge
+ * @return
+ * 		false if graph is NULL or edge was not found
+ * 		true if edge is present in graph
+ */
+bool graphIsDirectedEdgeExistsById(ConstGraph graph, int from, int to);
+
+/**
+ * graphAddVerticesBatch: Adds vertices to the graph as graphAddVertex does
+ * for each, in time of sorting them and one pass over vertices of graph. Of
+ * equal vertices in the batch only the first is added.
+ *
+ * @param graph - The graph to which to add vertices
+ * @param vertices - Array of n vertices to add
+ * @param n - Number of vertices
+ * @param results - Array of n results, filled with result of graphAddVertex
+ * 		for every vertex
+ * @return
+ * 		GRAPH_NULL_ARGUMENT if graph, vertices or results is NULL
+ * 		GRAPH_OUT_OF_RANGE if n is negative
+ * 		GRAPH_OUT_OF_MEMORY if an allocation failed before any vertex was
+ * 			added, results are not filled then
+ * 		GRAPH_SUCCESS otherwise
+ */
+GraphResult graphAddVerticesBatch(Graph graph, GraphVertex *vertices, int n,
+		GraphResult *results);
+
+/**
+ * graphAddEdgesBatch: Adds directed edges to the graph as
+ * graphAddDirectedEdge does for each, by sorting them and merging them into
+ * adjacency of every vertex once. Of equal edges in the batch only the first
+ * is added.
+ *
+ * @param graph - The graph to which to add edges
+ * @param from - Array of n vertices where edges begin
+ * @param to - Array of n vertices where edges end
+ * @param n - Number of edges
+ * @param results - Array of n results, filled with result of
+ * 		graphAddDirectedEdge for every edge
+ * @return
+ * 		GRAPH_NULL_ARGUMENT if graph, from, to or results is NULL
+ * 		GRAPH_OUT_OF_RANGE if n is negative
+ * 		GRAPH_OUT_OF_MEMORY if an allocation failed, then no edge is added
+ * 		GRAPH_SUCCESS otherwise
+ */
+GraphResult graphAddEdgesBatch(Graph graph, GraphVertex *from, GraphVertex *to, int n,
+		GraphResult *results);
+
+/**
+ * graphGetOutNeighbors: Initializes cursor over vertices which edges from a
+ * vertex lead to, in order of their ids
+ *
+ * @param graph - The graph to walk
+ * @param vertex - The vertex whose neighbors to walk
+ * @param cursor - The cursor to initialize
+ * @return
+ * 		GRAPH_NULL_ARGUMENT if one of parameters is NULL
+ * 		GRAPH_VERTEX_DOES_NOT_EXISTS if vertex is not in graph
+ * 		GRAPH_SUCCESS otherwise
+ */
+GraphResult graphGetOutNeighbors(ConstGraph graph, GraphVertex vertex,
+		GraphNeighborCursor *cursor);
+
+/**
+ * graphGetInNeighbors: Initializes cursor over vertices which edges to a
+ * vertex come from, in order of their ids
+ *
+ * @param graph - The graph to walk
+ * @param vertex - The vertex whose neighbors to walk
+ * @param cursor - The cursor to initialize
+ * @return
+ * 		GRAPH_NULL_ARGUMENT if one of parameters is NULL
+ * 		GRAPH_VERTEX_DOES_NOT_EXISTS if vertex is not in graph
+ * 		GRAPH_SUCCESS otherwise
+ */
+GraphResult graphGetInNeighbors(ConstGraph graph, GraphVertex vertex,
+		GraphNeighborCursor *cursor);
+
+/**
+ * graphGetOutNeighborsById: As graphGetOutNeighbors for a vertex given by id
+ */
+GraphResult graphGetOutNeighborsById(ConstGraph graph, int id, GraphNeighborCursor *cursor);
+
+/**
+ * graphGetInNeighborsById: As graphGetInNeighbors for a vertex given by id
+ */
+GraphResult graphGetInNeighborsById(ConstGraph graph, int id, GraphNeighborCursor *cursor);
+
+/**
+ * graphNeighborCursorNext: Advances cursor to the next neighbor
+ *
+ * @param cursor - The cursor to advance
+ * @return
+ * 		NULL if cursor is NULL or all neighbors were walked
+ * 		the next neighbor otherwise, which belongs to the graph
+ */
+GraphVertex graphNeighborCursorNext(GraphNeighborCursor *cursor);
+
+/**
+ * graphNeighborCursorNextId: Advances cursor to the next neighbor, as
+ * graphNeighborCursorNext does, returning its id
+ *
+ * @param cursor - The cursor to advance
+ * @return
+ * 		-1 if cursor is NULL or all neighbors were walked
+ * 		id of the next neighbor otherwise
+ */
+int graphNeighborCursorNextId(GraphNeighborCursor *cursor);
+
+/**
+ * graphOutDegree: Returns number of edges from a vertex, in constant time
+ * once the vertex is found
+ *
+ * @param graph - The graph to examine
+ * @param vertex - The vertex whose edges to count
+ * @return
+ * 		-1 if one of parameters is NULL or vertex is not in graph
+ * 		number of edges from vertex otherwise, a loop included
+ */
+int graphOutDegree(ConstGraph graph, GraphVertex vertex);
+
+/**
+ * graphInDegree: Returns number of edges to a vertex, in constant time once
+ * the vertex is found
+ *
+ * @param graph - The graph to examine
+ * @param vertex - The vertex whose edges to count
+ * @return
+ * 		-1 if one of parameters is NULL or vertex is not in graph
+ * 		number of edges to vertex otherwise, a loop included
+ */
+int graphInDegree(ConstGraph graph, GraphVertex vertex);
+
+/**
+ * graphOutDegreeById: As graphOutDegree for a vertex given by id
+ */
+int graphOutDegreeById(ConstGraph graph, int id);
+
+/**
+ * graphInDegreeById: As graphInDegree for a vertex given by id
+ */
+int graphInDegreeById(ConstGraph graph, int id);
+
+/**
+ * graphBFS: Visits every vertex reachable from source, the source first, in
+ * order of distance from it. Order of vertices at the same distance is not
+ * specified. The graph must not be changed during traversal.
+ *
+ * Levels far from the source are usually found by checking unvisited
+ * vertices for a visited in-neighbor, rather than by walking out-edges of
+ * the previous level, whichever touches fewer edges.
+ *
+ * @param graph - The graph to traverse
+ * @param source - The vertex to start from
+ * @param visit - Function called for every reached vertex
+ * @param context - Argument passed to visit
+ * @return
+ * 		GRAPH_NULL_ARGUMENT if one of parameters except context is NULL
+ * 		GRAPH_VERTEX_DOES_NOT_EXISTS if source is not in graph
+ * 		GRAPH_OUT_OF_MEMORY if an allocation failed
+ * 		GRAPH_SUCCESS if traversal ended or was stopped by visit
+ */
+GraphResult graphBFS(ConstGraph graph, GraphVertex source, visitGraphVertex visit,
+		void *context);
+
+/**
+ * graphBFSBounded: As graphBFS, visiting only vertices at distance of at most
+ * max_depth from source
+ *
+ * @param graph - The graph to traverse
+ * @param source - The vertex to start from
+ * @param max_depth - The largest distance to visit, 0 visits source alone
+ * @param visit - Function called for every reached vertex
+ * @param context - Argument passed to visit
+ * @return
+ * 		GRAPH_OUT_OF_RANGE if max_depth is negative
+ * 		Same results as graphBFS otherwise
+ */
+GraphResult graphBFSBounded(ConstGraph graph, GraphVertex source, int max_depth,
+		visitGraphVertex visit, void *context);
+
+/**
+ * graphIsReachable: Checks if there is a directed path from one vertex to
+ * another. Every vertex reaches itself.
+ *
+ * @param graph - The graph to search in
+ * @param from - The vertex where the path starts
+ * @param to - The vertex where the path ends
+ * @return
+ * 		false if one of parameters is NULL, a vertex is not in graph, an
+ * 			allocation failed or there is no path
+ * 		true if there is a path
+ */
+bool graphIsReachable(ConstGraph graph, GraphVertex from, GraphVertex to);
+
+/**
+ * graphIsReachableById: As graphIsReachable for vertices given by ids
+ */
+bool graphIsReachableById(ConstGraph graph, int from, int to);
+
+/**
+ * graphSetReachabilityIndex: Turns on or off the reachability index of graph.
+ * The index is built when it is turned on, in time linear in size of graph,
+ * and answers most queries in constant time by intervals of labels of
+ * strongly connected components. Adding a vertex, or an edge which keeps the
+ * order of the labels, updates the index. Other changes make it stale:
+ * queries traverse the graph until it is rebuilt, which happens once there
+ * was one such change per 16 vertices and edges, or when it is turned on
+ * again. Queries only read the index, so they may run in several threads at
+ * once while the graph does not change.
+ *
+ * @param graph - The graph to index
+ * @param enabled - Whether the index should be kept
+ * @return
+ * 		GRAPH_NULL_ARGUMENT if graph is NULL
+ * 		GRAPH_OUT_OF_MEMORY if an allocation failed
+ * 		GRAPH_SUCCESS otherwise
+ */
+GraphResult graphSetReachabilityIndex(Graph graph, bool enabled);
+
+/**
+ * graphComputeSCC: Finds strongly connected components of graph, the largest
+ * sets of vertices where every vertex has a path to every other one, in time
+ * linear in size of graph. The search keeps its own stack, so long paths do
+ * not exhaust the call stack. Components are numbered from 0 in reverse
+ * topological order: every edge between different components leads to the
+ * lower number.
+ *
+ * @param graph - The graph to search in
+ * @param out_components - Array of graphGetVertexIdBound(graph) entries,
+ * 		filled with component of the vertex of every id, -1 for free ids
+ * @param out_count - Set to number of components
+ * @param out_condensation - If not NULL, set to a new graph, which the caller
+ * 		destroys, with a vertex of type int for every component, whose id is
+ * 		its number, and an edge between components wherever graph has one
+ * @return
+ * 		GRAPH_NULL_ARGUMENT if graph, out_components or out_count is NULL
+ * 		GRAPH_OUT_OF_MEMORY if an allocation failed
+ * 		GRAPH_SUCCESS otherwise
+ */
+GraphResult graphComputeSCC(ConstGraph graph, int *out_components, int *out_count,
+		Graph *out_condensation);
+
+/**
+ * graphParallelBFS: Computes distance from source to every vertex, by a
+ * breadth first traversal where threads share each level. Like graphBFS, a
+ * level is walked through out-edges of the previous one or through in-edges
+ * of unvisited vertices. The graph must not be changed during traversal.
+ *
+ * @param graph - The graph to traverse
+ * @param source - The vertex to start from
+ * @param nthreads - Number of threads to use, the calling one included
+ * @param out_levels - Array of graphGetVertexIdBound(graph) entries, filled
+ * 		with distance from source of the vertex of every id, -1 for ids of
+ * 		unreachable vertices and free ids
+ * @return
+ * 		GRAPH_NULL_ARGUMENT if one of parameters is NULL
+ * 		GRAPH_OUT_OF_RANGE if nthreads is not positive
+ * 		GRAPH_VERTEX_DOES_NOT_EXISTS if source is not in graph
+ * 		GRAPH_OUT_OF_MEMORY if an allocation failed
+ * 		GRAPH_SUCCESS otherwise
+ */
+GraphResult graphParallelBFS(ConstGraph graph, GraphVertex source, int nthreads,
+		int *out_levels);
+
 /**
  * graphClear: Removes all vertices and edges from target graph
  *
@@ -172,5 +571,108 @@ bool graphIsDirectedEdgeExists(Graph graph,  GraphVertex from, GraphVertex to);
  */
 GraphResult graphClear(Graph graph);
 
+/**
+ * Macro for iterating over neighbors of a vertex with a cursor initialized by
+ * one of graphGet*Neighbors functions
+ *
+ * @param type - type of the vertices
+ * @param iterator - name of variable to hold each neighbor
+ * @param cursor - pointer to the cursor
+ */
+#define GRAPH_NEIGHBORS_FOREACH(type, iterator, cursor) \
+	for(type iterator = graphNeighborCursorNext(cursor) ; \
+		iterator ;\
+		iterator = graphNeighborCursorNext(cursor))
+
+/**
+ * graphFreeze: Creates a snapshot of the graph in compressed sparse row form:
+ * an array of vertices in order of the comparison function, where the id of
+ * a vertex in the snapshot is its position, and one array of sorted
+ * out-neighbor ids of all vertices. The snapshot has its own copies of the
+ * vertices and does not change with the graph. It keeps no in-edges, and
+ * takes a fraction of memory of the graph.
+ *
+ * @param graph - The graph to take snapshot of
+ * @return
+ * 		NULL if graph is NULL or an allocation failed
+ * 		A new snapshot otherwise
+ */
+GraphSnapshot graphFreeze(ConstGraph graph);
+
+/**
+ * graphSnapshotDestroy: Deallocates a snapshot with its copies of vertices
+ *
+ * @param snapshot - Target snapshot, if it is NULL nothing will be done
+ */
+void graphSnapshotDestroy(GraphSnapshot snapshot);
+
+/**
+ * graphSnapshotGetVerticesCount: Returns number of vertices of a snapshot,
+ * which are given ids from 0 to this number minus one
+ *
+ * @param snapshot - The snapshot to examine
+ * @return
+ * 		-1 if snapshot is NULL
+ * 		number of vertices otherwise
+ */
+int graphSnapshotGetVerticesCount(GraphSnapshot snapshot);
+
+/**
+ * graphSnapshotGetVertexId: Returns the id of a vertex in snapshot, which is
+ * unrelated to its id in the graph
+ *
+ * @param snapshot - The snapshot to search in
+ * @param vertex - The vertex to look for
+ * @return
+ * 		-1 if one of parameters is NULL or vertex was not found
+ * 		id of the vertex otherwise
+ */
+int graphSnapshotGetVertexId(GraphSnapshot snapshot, GraphVertex vertex);
+
+/**
+ * graphSnapshotGetVertexById: Returns the vertex of snapshot with given id,
+ * which belongs to the snapshot
+ *
+ * @param snapshot - The snapshot to search in
+ * @param id - The id of the vertex
+ * @return
+ * 		NULL if snapshot is NULL or id is out of range
+ * 		the vertex otherwise
+ */
+GraphVertex graphSnapshotGetVertexById(GraphSnapshot snapshot, int id);
+
+/**
+ * graphSnapshotGetOutNeighbors: Returns ids of vertices which edges from a
+ * vertex lead to, in increasing order
+ *
+ * @param snapshot - The snapshot to search in
+ * @param id - The id of the vertex
+ * @param count - Set to number of the neighbors
+ * @return
+ * 		NULL if snapshot or count is NULL or id is out of range
+ * 		array of count ids, which belongs to the snapshot, otherwise
+ */
+const int *graphSnapshotGetOutNeighbors(GraphSnapshot snapshot, int id, int *count);
+
+/**
+ * graphSnapshotIsDirectedEdgeExists: Checks if directed edge was present in
+ * graph when snapshot was taken, by binary search among neighbors of from
+ *
+ * @param snapshot - The snapshot to search in
+ * @param from - The start of directed edge to look for
+ * @param to - The end of directed edge to look for
+ * @return
+ * 		false if one of parameters if NULL or edge was not found
+ * 		true if edge is present in snapshot
+ */
+bool graphSnapshotIsDirectedEdgeExists(GraphSnapshot snapshot, GraphVertex from,
+		GraphVertex to);
+
+/**
+ * graphSnapshotIsDirectedEdgeExistsById: As graphSnapshotIsDirectedEdgeExists
+ * for vertices given by snapshot ids
+ */
+bool graphSnapshotIsDirectedEdgeExistsById(GraphSnapshot snapshot, int from, int to);
+
 #endif /* GRAPH_H_ */
 
@@ -1,5 +1,6 @@
 #include "test_utilities.h"
 #include "../graph.h"
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -424,6 +425,678 @@ static bool graphClearTest(){
 	return true;
 }
 
+static bool graphManyEdgesTest() {
+	const int VERTICES = 200;
+	char names[VERTICES][8];
+	Graph graph = graphCreate((copyGraphVertex)stringCopy, (compareGraphVertex)strcmp, free);
+	ASSERT_TEST(graph != NULL);
+	for (int i = 0; i < VERTICES; ++i) {
+		sprintf(names[i], "v%d", i);
+		ASSERT_TEST(graphAddVertex(graph, names[i]) == GRAPH_SUCCESS);
+	}
+
+	// vertex 0 points to all, every other vertex to itself and to the next one
+	for (int i = 0; i < VERTICES; ++i) {
+		ASSERT_TEST(graphAddDirectedEdge(graph, names[0], names[i]) == GRAPH_SUCCESS);
+		if (i > 0) {
+			ASSERT_TEST(graphAddDirectedEdge(graph, names[i], names[i]) == GRAPH_SUCCESS);
+		}
+		if (i > 0 && i + 1 < VERTICES) {
+			ASSERT_TEST(graphAddDirectedEdge(graph, names[i], names[i + 1]) == GRAPH_SUCCESS);
+		}
+	}
+	ASSERT_TEST(graphAddDirectedEdge(graph, names[0], names[1]) == GRAPH_EDGE_ALREADY_EXISTS);
+	for (int i = 0; i < VERTICES; ++i) {
+		ASSERT_TEST(graphIsDirectedEdgeExists(graph, names[0], names[i]));
+		ASSERT_TEST(graphIsDirectedEdgeExists(graph, names[i], names[i]));
+		ASSERT_TEST(i < 2 || !graphIsDirectedEdgeExists(graph, names[i], names[0]));
+	}
+
+	// removing a vertex takes its edges in both directions
+	ASSERT_TEST(graphRemoveVertex(graph, names[100]) == GRAPH_SUCCESS);
+	ASSERT_TEST(!graphIsDirectedEdgeExists(graph, names[0], names[100]));
+	ASSERT_TEST(!graphIsDirectedEdgeExists(graph, names[99], names[100]));
+	ASSERT_TEST(!graphIsDirectedEdgeExists(graph, names[100], names[101]));
+	ASSERT_TEST(graphIsDirectedEdgeExists(graph, names[98], names[99]));
+	ASSERT_TEST(graphAddVertex(graph, names[100]) == GRAPH_SUCCESS);
+	ASSERT_TEST(!graphIsDirectedEdgeExists(graph, names[100], names[100]));
+	ASSERT_TEST(graphRemoveVertex(graph, names[0]) == GRAPH_SUCCESS);
+	ASSERT_TEST(!graphIsDirectedEdgeExists(graph, names[0], names[1]));
+	ASSERT_TEST(graphIsDirectedEdgeExists(graph, names[1], names[2]));
+	ASSERT_TEST(graphRemoveDirectedEdge(graph, names[1], names[2]) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphRemoveDirectedEdge(graph, names[1], names[2]) == GRAPH_EDGE_DOES_NOT_EXISTS);
+	ASSERT_TEST(graphIsDirectedEdgeExists(graph, names[1], names[1]));
+
+	graphDestroy(graph);
+	return true;
+}
+
+static bool graphVertexIdTest() {
+	char * vertex1 = "Cherkasy";
+	char * vertex2 = "Lviv";
+	char * vertex3 = "Kiev";
+	char * vertexNotInGraph = "Haifa";
+
+	Graph graph = graphCreate((copyGraphVertex)stringCopy, (compareGraphVertex)strcmp, free);
+	ASSERT_TEST(graph != NULL);
+	ASSERT_TEST(graphGetVertexIdBound(NULL) == -1);
+	ASSERT_TEST(graphGetVertexIdBound(graph) == 0);
+	ASSERT_TEST(graphAddVertex(graph, vertex1) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphAddVertex(graph, vertex2) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphAddVertex(graph, vertex3) == GRAPH_SUCCESS);
+
+	int id1 = graphGetVertexId(graph, vertex1);
+	int id2 = graphGetVertexId(graph, vertex2);
+	int id3 = graphGetVertexId(graph, vertex3);
+	ASSERT_TEST(id1 >= 0 && id2 >= 0 && id3 >= 0);
+	ASSERT_TEST(id1 != id2 && id2 != id3 && id1 != id3);
+	ASSERT_TEST(graphGetVertexIdBound(graph) == 3);
+	ASSERT_TEST(graphGetVertexId(graph, vertexNotInGraph) == -1);
+	ASSERT_TEST(graphGetVertexId(NULL, vertex1) == -1);
+	ASSERT_TEST(graphGetVertexId(graph, NULL) == -1);
+	ASSERT_TEST(strcmp(graphGetVertexById(graph, id2), vertex2) == 0);
+	ASSERT_TEST(graphGetVertexById(graph, -1) == NULL);
+	ASSERT_TEST(graphGetVertexById(graph, 3) == NULL);
+
+	// edges added by ids and by vertices are the same
+	ASSERT_TEST(graphAddDirectedEdgeById(NULL, id1, id2) == GRAPH_NULL_ARGUMENT);
+	ASSERT_TEST(graphAddDirectedEdgeById(graph, id1, 3) == GRAPH_VERTEX_DOES_NOT_EXISTS);
+	ASSERT_TEST(graphAddDirectedEdgeById(graph, id1, id2) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphIsDirectedEdgeExists(graph, vertex1, vertex2));
+	ASSERT_TEST(graphAddDirectedEdge(graph, vertex1, vertex2) == GRAPH_EDGE_ALREADY_EXISTS);
+	ASSERT_TEST(graphAddDirectedEdge(graph, vertex2, vertex3) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphIsDirectedEdgeExistsById(graph, id2, id3));
+	ASSERT_TEST(!graphIsDirectedEdgeExistsById(graph, id3, id2));
+	ASSERT_TEST(!graphIsDirectedEdgeExistsById(graph, id2, -1));
+	ASSERT_TEST(graphRemoveDirectedEdgeById(graph, id2, id3) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphRemoveDirectedEdgeById(graph, id2, id3) == GRAPH_EDGE_DOES_NOT_EXISTS);
+	ASSERT_TEST(!graphIsDirectedEdgeExists(graph, vertex2, vertex3));
+
+	// id of a removed vertex is reused, without its old edges
+	ASSERT_TEST(graphRemoveVertex(graph, vertex2) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphGetVertexById(graph, id2) == NULL);
+	ASSERT_TEST(graphAddDirectedEdgeById(graph, id1, id2) == GRAPH_VERTEX_DOES_NOT_EXISTS);
+	ASSERT_TEST(graphAddVertex(graph, vertexNotInGraph) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphGetVertexId(graph, vertexNotInGraph) == id2);
+	ASSERT_TEST(!graphIsDirectedEdgeExistsById(graph, id1, id2));
+	ASSERT_TEST(graphGetVertexIdBound(graph) == 3);
+
+	ASSERT_TEST(graphClear(graph) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphGetVertexIdBound(graph) == 0);
+	ASSERT_TEST(graphGetVertexId(graph, vertex1) == -1);
+	graphDestroy(graph);
+	return true;
+}
+
+static bool graphNeighborsTest() {
+	char * vertex1 = "Cherkasy";
+	char * vertex2 = "Lviv";
+	char * vertex3 = "Kiev";
+	char * vertexNotInGraph = "Haifa";
+
+	Graph graph = graphCreate((copyGraphVertex)stringCopy, (compareGraphVertex)strcmp, free);
+	ASSERT_TEST(graph != NULL);
+	ASSERT_TEST(graphAddVertex(graph, vertex1) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphAddVertex(graph, vertex2) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphAddVertex(graph, vertex3) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphAddDirectedEdge(graph, vertex1, vertex2) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphAddDirectedEdge(graph, vertex1, vertex3) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphAddDirectedEdge(graph, vertex1, vertex1) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphAddDirectedEdge(graph, vertex3, vertex2) == GRAPH_SUCCESS);
+
+	GraphNeighborCursor cursor;
+	ASSERT_TEST(graphGetOutNeighbors(NULL, vertex1, &cursor) == GRAPH_NULL_ARGUMENT);
+	ASSERT_TEST(graphGetOutNeighbors(graph, vertex1, NULL) == GRAPH_NULL_ARGUMENT);
+	ASSERT_TEST(graphGetInNeighbors(graph, vertexNotInGraph, &cursor) ==
+			GRAPH_VERTEX_DOES_NOT_EXISTS);
+	ASSERT_TEST(graphGetOutNeighbors(graph, vertex1, &cursor) == GRAPH_SUCCESS);
+	int count = 0;
+	GRAPH_NEIGHBORS_FOREACH(char*, neighbor, &cursor) {
+		ASSERT_TEST(graphIsDirectedEdgeExists(graph, vertex1, neighbor));
+		++count;
+	}
+	ASSERT_TEST(count == 3);
+	ASSERT_TEST(graphNeighborCursorNext(&cursor) == NULL);
+	ASSERT_TEST(graphNeighborCursorNextId(&cursor) == -1);
+	ASSERT_TEST(graphNeighborCursorNext(NULL) == NULL);
+
+	ASSERT_TEST(graphGetInNeighborsById(graph, graphGetVertexId(graph, vertex2), &cursor) ==
+			GRAPH_SUCCESS);
+	int id1 = graphNeighborCursorNextId(&cursor);
+	int id2 = graphNeighborCursorNextId(&cursor);
+	ASSERT_TEST(id1 >= 0 && id1 < id2 && graphNeighborCursorNextId(&cursor) == -1);
+	ASSERT_TEST(graphIsDirectedEdgeExistsById(graph, id1, graphGetVertexId(graph, vertex2)));
+	ASSERT_TEST(graphGetOutNeighborsById(graph, -1, &cursor) == GRAPH_VERTEX_DOES_NOT_EXISTS);
+	ASSERT_TEST(graphGetInNeighbors(graph, vertex3, &cursor) == GRAPH_SUCCESS);
+	ASSERT_TEST(strcmp(graphNeighborCursorNext(&cursor), vertex1) == 0);
+	ASSERT_TEST(graphNeighborCursorNext(&cursor) == NULL);
+
+	ASSERT_TEST(graphOutDegree(graph, vertex1) == 3);
+	ASSERT_TEST(graphInDegree(graph, vertex1) == 1);
+	ASSERT_TEST(graphOutDegree(graph, vertex2) == 0);
+	ASSERT_TEST(graphInDegree(graph, vertex2) == 2);
+	ASSERT_TEST(graphOutDegree(graph, vertexNotInGraph) == -1);
+	ASSERT_TEST(graphInDegree(NULL, vertex1) == -1);
+	ASSERT_TEST(graphOutDegreeById(graph, graphGetVertexId(graph, vertex3)) == 1);
+	ASSERT_TEST(graphInDegreeById(graph, -1) == -1);
+	ASSERT_TEST(graphRemoveVertex(graph, vertex1) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphInDegree(graph, vertex2) == 1);
+	ASSERT_TEST(graphInDegree(graph, vertex3) == 0);
+
+	graphDestroy(graph);
+	return true;
+}
+
+/** Records depth of every visited vertex by id, stops at vertex "stop" */
+typedef struct VisitRecord_t {
+	int depths[512];
+	int visited;
+} VisitRecord;
+
+static bool recordVisit(GraphVertex vertex, int id, int depth, void *context) {
+	VisitRecord *record = context;
+	record->depths[id] = depth;
+	++record->visited;
+	return strcmp(vertex, "stop") != 0;
+}
+
+static bool graphTraversalTest() {
+	const int LAYERS = 5, LAYER_SIZE = 50;
+	char names[LAYERS * LAYER_SIZE][8];
+	Graph graph = graphCreate((copyGraphVertex)stringCopy, (compareGraphVertex)strcmp, free);
+	ASSERT_TEST(graph != NULL);
+	for (int i = 0; i < LAYERS * LAYER_SIZE; ++i) {
+		sprintf(names[i], "v%d", i);
+		ASSERT_TEST(graphAddVertex(graph, names[i]) == GRAPH_SUCCESS);
+	}
+	// the first vertex of layer 0 points to layer 1, every vertex of a layer to
+	// every vertex of the next one and back to the source, so that dense
+	// levels are visited bottom-up
+	for (int layer = 0; layer + 1 < LAYERS; ++layer) {
+		for (int i = 0; i < LAYER_SIZE; ++i) {
+			for (int j = 0; j < LAYER_SIZE; ++j) {
+				if (layer > 0 || i == 0) {
+					ASSERT_TEST(graphAddDirectedEdge(graph, names[layer * LAYER_SIZE + i],
+							names[(layer + 1) * LAYER_SIZE + j]) == GRAPH_SUCCESS);
+				}
+			}
+			ASSERT_TEST(graphAddDirectedEdge(graph, names[(layer + 1) * LAYER_SIZE + i],
+					names[0]) == GRAPH_SUCCESS);
+		}
+	}
+
+	VisitRecord record = { { 0 }, 0 };
+	ASSERT_TEST(graphBFS(NULL, names[0], recordVisit, &record) == GRAPH_NULL_ARGUMENT);
+	ASSERT_TEST(graphBFS(graph, names[0], NULL, &record) == GRAPH_NULL_ARGUMENT);
+	ASSERT_TEST(graphBFS(graph, "stop", recordVisit, &record) == GRAPH_VERTEX_DOES_NOT_EXISTS);
+	ASSERT_TEST(graphBFS(graph, names[0], recordVisit, &record) == GRAPH_SUCCESS);
+	// other vertices of layer 0 are not reachable
+	ASSERT_TEST(record.visited == 1 + (LAYERS - 1) * LAYER_SIZE);
+	for (int i = LAYER_SIZE; i < LAYERS * LAYER_SIZE; ++i) {
+		ASSERT_TEST(record.depths[graphGetVertexId(graph, names[i])] == i / LAYER_SIZE);
+	}
+
+	record.visited = 0;
+	ASSERT_TEST(graphBFSBounded(graph, names[0], -1, recordVisit, &record) == GRAPH_OUT_OF_RANGE);
+	ASSERT_TEST(graphBFSBounded(graph, names[0], 0, recordVisit, &record) == GRAPH_SUCCESS);
+	ASSERT_TEST(record.visited == 1);
+	record.visited = 0;
+	ASSERT_TEST(graphBFSBounded(graph, names[0], 2, recordVisit, &record) == GRAPH_SUCCESS);
+	ASSERT_TEST(record.visited == 1 + 2 * LAYER_SIZE);
+
+	ASSERT_TEST(graphIsReachable(graph, names[0], names[LAYERS * LAYER_SIZE - 1]));
+	ASSERT_TEST(graphIsReachable(graph, names[LAYER_SIZE], names[2 * LAYER_SIZE + 3]));
+	ASSERT_TEST(!graphIsReachable(graph, names[0], names[1]));
+	ASSERT_TEST(graphIsReachable(graph, names[1], names[1]));
+	ASSERT_TEST(!graphIsReachable(graph, names[1], names[0]));
+	ASSERT_TEST(!graphIsReachable(graph, names[0], "stop"));
+	ASSERT_TEST(!graphIsReachable(NULL, names[0], names[1]));
+	ASSERT_TEST(graphIsReachableById(graph, graphGetVertexId(graph, names[LAYER_SIZE]),
+			graphGetVertexId(graph, names[LAYER_SIZE + 1])));
+
+	// the visitor stops traversal
+	ASSERT_TEST(graphAddVertex(graph, "stop") == GRAPH_SUCCESS);
+	ASSERT_TEST(graphAddDirectedEdge(graph, names[0], "stop") == GRAPH_SUCCESS);
+	record.visited = 0;
+	ASSERT_TEST(graphBFS(graph, names[0], recordVisit, &record) == GRAPH_SUCCESS);
+	ASSERT_TEST(record.visited <= 1 + LAYER_SIZE + 1);
+	ASSERT_TEST(graphRemoveVertex(graph, names[LAYER_SIZE]) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphIsReachable(graph, names[0], names[LAYERS * LAYER_SIZE - 1]));
+
+	graphDestroy(graph);
+	return true;
+}
+
+static bool graphParallelBFSTest() {
+	const int VERTICES = 500;
+	char names[VERTICES][8];
+	Graph graph = graphCreate((copyGraphVertex)stringCopy, (compareGraphVertex)strcmp, free);
+	ASSERT_TEST(graph != NULL);
+	for (int i = 0; i < VERTICES; ++i) {
+		sprintf(names[i], "v%d", i);
+		ASSERT_TEST(graphAddVertex(graph, names[i]) == GRAPH_SUCCESS);
+	}
+	// a binary tree with extra edges between vertices of the same depth and
+	// back to the root, vertex VERTICES - 1 is left unreachable
+	for (int i = 1; i < VERTICES - 1; ++i) {
+		ASSERT_TEST(graphAddDirectedEdge(graph, names[(i - 1) / 2], names[i]) == GRAPH_SUCCESS);
+		ASSERT_TEST(graphAddDirectedEdge(graph, names[i], names[0]) == GRAPH_SUCCESS);
+		if (i % 3 == 0 && i + 1 < VERTICES - 1) {
+			ASSERT_TEST(graphAddDirectedEdge(graph, names[i], names[i + 1]) == GRAPH_SUCCESS);
+		}
+	}
+
+	int bound = graphGetVertexIdBound(graph);
+	int levels[VERTICES], serial[VERTICES];
+	ASSERT_TEST(graphParallelBFS(NULL, names[0], 2, levels) == GRAPH_NULL_ARGUMENT);
+	ASSERT_TEST(graphParallelBFS(graph, names[0], 2, NULL) == GRAPH_NULL_ARGUMENT);
+	ASSERT_TEST(graphParallelBFS(graph, names[0], 0, levels) == GRAPH_OUT_OF_RANGE);
+	ASSERT_TEST(graphParallelBFS(graph, "v-1", 2, levels) == GRAPH_VERTEX_DOES_NOT_EXISTS);
+
+	VisitRecord record = { { 0 }, 0 };
+	ASSERT_TEST(graphBFS(graph, names[0], recordVisit, &record) == GRAPH_SUCCESS);
+	for (int i = 0; i < bound; ++i) {
+		serial[i] = -1;
+	}
+	for (int i = 0; i < VERTICES - 1; ++i) {
+		int id = graphGetVertexId(graph, names[i]);
+		serial[id] = record.depths[id];
+	}
+	for (int threads = 1; threads <= 4; ++threads) {
+		ASSERT_TEST(graphParallelBFS(graph, names[0], threads, levels) == GRAPH_SUCCESS);
+		for (int i = 0; i < bound; ++i) {
+			ASSERT_TEST(levels[i] == serial[i]);
+		}
+	}
+	ASSERT_TEST(levels[graphGetVertexId(graph, names[VERTICES - 1])] == -1);
+	ASSERT_TEST(levels[graphGetVertexId(graph, names[2])] == 1);
+	ASSERT_TEST(levels[graphGetVertexId(graph, names[4])] == 2);
+
+	graphDestroy(graph);
+	return true;
+}
+
+static bool graphFreezeTest() {
+	const int VERTICES = 100;
+	char names[VERTICES][8];
+	ASSERT_TEST(graphFreeze(NULL) == NULL);
+	Graph graph = graphCreate((copyGraphVertex)stringCopy, (compareGraphVertex)strcmp, free);
+	ASSERT_TEST(graph != NULL);
+	for (int i = 0; i < VERTICES; ++i) {
+		sprintf(names[i], "v%02d", i);
+	}
+	for (int i = VERTICES - 1; i >= 0; --i) {
+		ASSERT_TEST(graphAddVertex(graph, names[i]) == GRAPH_SUCCESS);
+	}
+	// vertex 0 points to every vertex, the others to multiples of themselves
+	for (int i = 0; i < VERTICES; ++i) {
+		for (int j = i == 0 ? 0 : 2 * i; j < VERTICES; j += i == 0 ? 1 : i) {
+			ASSERT_TEST(graphAddDirectedEdge(graph, names[i], names[j]) == GRAPH_SUCCESS);
+		}
+	}
+
+	GraphSnapshot snapshot = graphFreeze(graph);
+	ASSERT_TEST(snapshot != NULL);
+	// the snapshot does not change with the graph
+	ASSERT_TEST(graphRemoveDirectedEdge(graph, names[0], names[1]) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphRemoveVertex(graph, names[2]) == GRAPH_SUCCESS);
+	graphDestroy(graph);
+
+	ASSERT_TEST(graphSnapshotGetVerticesCount(snapshot) == VERTICES);
+	ASSERT_TEST(graphSnapshotGetVerticesCount(NULL) == -1);
+	for (int i = 0; i < VERTICES; ++i) {
+		ASSERT_TEST(graphSnapshotGetVertexId(snapshot, names[i]) == i);
+		ASSERT_TEST(strcmp(graphSnapshotGetVertexById(snapshot, i), names[i]) == 0);
+	}
+	ASSERT_TEST(graphSnapshotGetVertexId(snapshot, "v") == -1);
+	ASSERT_TEST(graphSnapshotGetVertexId(NULL, names[0]) == -1);
+	ASSERT_TEST(graphSnapshotGetVertexById(snapshot, VERTICES) == NULL);
+	ASSERT_TEST(graphSnapshotGetVertexById(snapshot, -1) == NULL);
+
+	int count = 0;
+	const int *neighbors = graphSnapshotGetOutNeighbors(snapshot, 0, &count);
+	ASSERT_TEST(neighbors != NULL && count == VERTICES);
+	for (int i = 0; i < count; ++i) {
+		ASSERT_TEST(neighbors[i] == i);
+	}
+	neighbors = graphSnapshotGetOutNeighbors(snapshot, 7, &count);
+	ASSERT_TEST(neighbors != NULL && count == (VERTICES - 1) / 7 - 1);
+	ASSERT_TEST(graphSnapshotGetOutNeighbors(snapshot, VERTICES, &count) == NULL);
+	ASSERT_TEST(graphSnapshotGetOutNeighbors(snapshot, 0, NULL) == NULL);
+
+	for (int i = 0; i < VERTICES; ++i) {
+		for (int j = 0; j < VERTICES; ++j) {
+			bool expected = i == 0 || (j >= 2 * i && j % i == 0);
+			ASSERT_TEST(graphSnapshotIsDirectedEdgeExistsById(snapshot, i, j) == expected);
+		}
+	}
+	ASSERT_TEST(graphSnapshotIsDirectedEdgeExists(snapshot, names[0], names[1]));
+	ASSERT_TEST(graphSnapshotIsDirectedEdgeExists(snapshot, names[3], names[99]));
+	ASSERT_TEST(!graphSnapshotIsDirectedEdgeExists(snapshot, names[99], names[3]));
+	ASSERT_TEST(!graphSnapshotIsDirectedEdgeExists(snapshot, names[1], "v"));
+	ASSERT_TEST(!graphSnapshotIsDirectedEdgeExistsById(snapshot, -1, 0));
+	ASSERT_TEST(!graphSnapshotIsDirectedEdgeExistsById(NULL, 0, 0));
+
+	graphSnapshotDestroy(snapshot);
+	graphSnapshotDestroy(NULL);
+	return true;
+}
+
+/** checks that indexed answers reachability queries as plain does */
+static bool graphSameReachability(Graph plain, Graph indexed, char names[][8], int count) {
+	for (int i = 0; i < count; ++i) {
+		for (int j = 0; j < count; ++j) {
+			ASSERT_TEST(graphIsReachable(indexed, names[i], names[j]) ==
+					graphIsReachable(plain, names[i], names[j]));
+		}
+	}
+	return true;
+}
+
+#define REACH_QUERY_THREADS (4)
+
+typedef struct ReachQueries_t {
+	Graph plain;
+	Graph indexed;
+	char (*names)[8];
+	int count;
+	bool same;
+} ReachQueries;
+
+static void *graphReachQueriesMain(void *argument) {
+	ReachQueries *queries = argument;
+	queries->same = graphSameReachability(queries->plain, queries->indexed,
+			queries->names, queries->count);
+	return NULL;
+}
+
+/** queries indexed from several threads at once */
+static bool graphSameReachabilityInThreads(Graph plain, Graph indexed, char names[][8],
+		int count) {
+	pthread_t threads[REACH_QUERY_THREADS];
+	ReachQueries queries[REACH_QUERY_THREADS];
+	for (int i = 0; i < REACH_QUERY_THREADS; ++i) {
+		queries[i] = (ReachQueries){ plain, indexed, names, count, false };
+		ASSERT_TEST(pthread_create(threads + i, NULL, graphReachQueriesMain,
+				queries + i) == 0);
+	}
+	for (int i = 0; i < REACH_QUERY_THREADS; ++i) {
+		ASSERT_TEST(pthread_join(threads[i], NULL) == 0);
+		ASSERT_TEST(queries[i].same);
+	}
+	return true;
+}
+
+static bool graphReachabilityIndexTest() {
+	const int VERTICES = 60, EDGES = 70;
+	char names[VERTICES][8];
+	ASSERT_TEST(graphSetReachabilityIndex(NULL, true) == GRAPH_NULL_ARGUMENT);
+	Graph plain = graphCreate((copyGraphVertex)stringCopy, (compareGraphVertex)strcmp, free);
+	Graph indexed = graphCreate((copyGraphVertex)stringCopy, (compareGraphVertex)strcmp, free);
+	ASSERT_TEST(plain != NULL && indexed != NULL);
+	ASSERT_TEST(graphSetReachabilityIndex(indexed, true) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphSetReachabilityIndex(indexed, true) == GRAPH_SUCCESS);
+	for (int i = 0; i < VERTICES; ++i) {
+		sprintf(names[i], "r%d", i);
+		ASSERT_TEST(graphAddVertex(plain, names[i]) == GRAPH_SUCCESS);
+		ASSERT_TEST(graphAddVertex(indexed, names[i]) == GRAPH_SUCCESS);
+	}
+	// sparse random edges make chains, cycles and vertices left alone
+	unsigned state = 2015;
+	for (int round = 0; round < 4; ++round) {
+		for (int i = 0; i < EDGES; ++i) {
+			state = state * 1103515245 + 12345;
+			int from = (state >> 8) % VERTICES;
+			state = state * 1103515245 + 12345;
+			int to = (state >> 8) % VERTICES;
+			GraphResult result = graphAddDirectedEdge(plain, names[from], names[to]);
+			ASSERT_TEST(graphAddDirectedEdge(indexed, names[from], names[to]) == result);
+			if (i % 10 == 0) {
+				ASSERT_TEST(graphSameReachability(plain, indexed, names, VERTICES));
+			}
+		}
+		state = state * 1103515245 + 12345;
+		int from = (state >> 8) % VERTICES;
+		GraphNeighborCursor cursor;
+		ASSERT_TEST(graphGetOutNeighbors(plain, names[from], &cursor) == GRAPH_SUCCESS);
+		GraphVertex to = graphNeighborCursorNext(&cursor);
+		if (to != NULL) {
+			ASSERT_TEST(graphRemoveDirectedEdge(indexed, names[from], to) == GRAPH_SUCCESS);
+			ASSERT_TEST(graphRemoveDirectedEdge(plain, names[from], to) == GRAPH_SUCCESS);
+		}
+		ASSERT_TEST(graphSameReachability(plain, indexed, names, VERTICES));
+		// queries only read the index
+		ASSERT_TEST(graphSameReachabilityInThreads(plain, indexed, names, VERTICES));
+	}
+	ASSERT_TEST(graphRemoveVertex(plain, names[0]) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphRemoveVertex(indexed, names[0]) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphSameReachability(plain, indexed, names, VERTICES));
+	ASSERT_TEST(graphAddVertex(indexed, names[0]) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphIsReachable(indexed, names[0], names[0]));
+	ASSERT_TEST(!graphIsReachable(indexed, names[0], names[1]));
+	ASSERT_TEST(graphAddVertex(plain, names[0]) == GRAPH_SUCCESS);
+
+	// a stale index is rebuilt when turned on again, and new vertices join
+	// it as components of their own
+	ASSERT_TEST(graphSetReachabilityIndex(indexed, true) == GRAPH_SUCCESS);
+	char sources[VERTICES][8];
+	for (int i = 0; i < VERTICES; ++i) {
+		sprintf(sources[i], "s%d", i);
+		ASSERT_TEST(graphAddVertex(plain, sources[i]) == GRAPH_SUCCESS);
+		ASSERT_TEST(graphAddVertex(indexed, sources[i]) == GRAPH_SUCCESS);
+		ASSERT_TEST(graphAddDirectedEdge(plain, sources[i], names[i]) == GRAPH_SUCCESS);
+		ASSERT_TEST(graphAddDirectedEdge(indexed, sources[i], names[i]) == GRAPH_SUCCESS);
+		ASSERT_TEST(graphIsReachable(indexed, sources[i], names[i]));
+		ASSERT_TEST(!graphIsReachable(indexed, names[i], sources[i]));
+	}
+	ASSERT_TEST(graphSameReachability(plain, indexed, names, VERTICES));
+	ASSERT_TEST(graphSameReachabilityInThreads(plain, indexed, sources, VERTICES));
+	for (int i = 0; i < VERTICES; ++i) {
+		for (int j = 0; j < VERTICES; ++j) {
+			ASSERT_TEST(graphIsReachable(indexed, sources[i], names[j]) ==
+					graphIsReachable(plain, sources[i], names[j]));
+		}
+	}
+	ASSERT_TEST(graphRemoveVertex(plain, names[0]) == GRAPH_SUCCESS);
+
+	ASSERT_TEST(graphSetReachabilityIndex(indexed, false) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphSetReachabilityIndex(indexed, false) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphSameReachability(plain, indexed, names + 1, VERTICES - 1));
+	ASSERT_TEST(graphSetReachabilityIndex(indexed, true) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphClear(indexed) == GRAPH_SUCCESS);
+	ASSERT_TEST(!graphIsReachable(indexed, names[1], names[2]));
+	graphDestroy(plain);
+	graphDestroy(indexed);
+	return true;
+}
+
+static bool graphComputeSCCTest() {
+	const int CYCLE = 100000;
+	char *names[] = { "a", "b", "c", "d", "e", "f", "g" };
+	// a -> b -> c -> a, c -> d <-> e, e -> f, and g alone
+	char *edges[][2] = { { "a", "b" }, { "b", "c" }, { "c", "a" }, { "c", "d" },
+			{ "d", "e" }, { "e", "d" }, { "e", "f" }, { "b", "d" } };
+	Graph graph = graphCreate((copyGraphVertex)stringCopy, (compareGraphVertex)strcmp, free);
+	ASSERT_TEST(graph != NULL);
+	for (int i = 0; i < 7; ++i) {
+		ASSERT_TEST(graphAddVertex(graph, names[i]) == GRAPH_SUCCESS);
+	}
+	for (int i = 0; i < 8; ++i) {
+		ASSERT_TEST(graphAddDirectedEdge(graph, edges[i][0], edges[i][1]) == GRAPH_SUCCESS);
+	}
+	ASSERT_TEST(graphRemoveVertex(graph, "g") == GRAPH_SUCCESS);
+	ASSERT_TEST(graphAddVertex(graph, "g") == GRAPH_SUCCESS);
+
+	int components[8], count;
+	Graph condensation;
+	ASSERT_TEST(graphComputeSCC(NULL, components, &count, NULL) == GRAPH_NULL_ARGUMENT);
+	ASSERT_TEST(graphComputeSCC(graph, NULL, &count, NULL) == GRAPH_NULL_ARGUMENT);
+	ASSERT_TEST(graphComputeSCC(graph, components, NULL, NULL) == GRAPH_NULL_ARGUMENT);
+	ASSERT_TEST(graphComputeSCC(graph, components, &count, &condensation) == GRAPH_SUCCESS);
+	ASSERT_TEST(count == 4);
+	int a = components[graphGetVertexId(graph, "a")];
+	int d = components[graphGetVertexId(graph, "d")];
+	int f = components[graphGetVertexId(graph, "f")];
+	int g = components[graphGetVertexId(graph, "g")];
+	ASSERT_TEST(components[graphGetVertexId(graph, "b")] == a);
+	ASSERT_TEST(components[graphGetVertexId(graph, "c")] == a);
+	ASSERT_TEST(components[graphGetVertexId(graph, "e")] == d);
+	ASSERT_TEST(a != d && d != f && a != g && d != g && f != g);
+	// reverse topological order
+	ASSERT_TEST(f < d && d < a);
+
+	ASSERT_TEST(graphGetVertexIdBound(condensation) == count);
+	for (int i = 0; i < count; ++i) {
+		ASSERT_TEST(*(int*)graphGetVertexById(condensation, i) == i);
+	}
+	ASSERT_TEST(graphIsDirectedEdgeExistsById(condensation, a, d));
+	ASSERT_TEST(graphIsDirectedEdgeExistsById(condensation, d, f));
+	ASSERT_TEST(graphOutDegreeById(condensation, a) == 1);
+	ASSERT_TEST(graphOutDegreeById(condensation, d) == 1);
+	ASSERT_TEST(graphOutDegreeById(condensation, f) == 0);
+	ASSERT_TEST(graphInDegreeById(condensation, g) == 0);
+	ASSERT_TEST(graphOutDegreeById(condensation, g) == 0);
+	graphDestroy(condensation);
+	graphDestroy(graph);
+
+	// a removed vertex leaves a free id, and its edges with it
+	graph = graphCreate((copyGraphVertex)stringCopy, (compareGraphVertex)strcmp, free);
+	ASSERT_TEST(graph != NULL);
+	for (int i = 0; i < 4; ++i) {
+		ASSERT_TEST(graphAddVertex(graph, names[i]) == GRAPH_SUCCESS);
+	}
+	ASSERT_TEST(graphAddDirectedEdge(graph, "b", "c") == GRAPH_SUCCESS);
+	ASSERT_TEST(graphAddDirectedEdge(graph, "b", "d") == GRAPH_SUCCESS);
+	ASSERT_TEST(graphRemoveVertex(graph, "b") == GRAPH_SUCCESS);
+	ASSERT_TEST(graphComputeSCC(graph, components, &count, &condensation) == GRAPH_SUCCESS);
+	ASSERT_TEST(count == 3);
+	ASSERT_TEST(graphGetVertexIdBound(condensation) == 3);
+	for (int i = 0; i < count; ++i) {
+		ASSERT_TEST(graphOutDegreeById(condensation, i) == 0);
+	}
+	graphDestroy(condensation);
+	graphDestroy(graph);
+
+	// a cycle too long for a recursive search
+	graph = graphCreate((copyGraphVertex)stringCopy, (compareGraphVertex)strcmp, free);
+	ASSERT_TEST(graph != NULL);
+	char name[16], next[16];
+	for (int i = 0; i < CYCLE; ++i) {
+		sprintf(name, "%06d", i);
+		ASSERT_TEST(graphAddVertex(graph, name) == GRAPH_SUCCESS);
+	}
+	for (int i = 0; i < CYCLE; ++i) {
+		sprintf(name, "%06d", i);
+		sprintf(next, "%06d", (i + 1) % CYCLE);
+		ASSERT_TEST(graphAddDirectedEdge(graph, name, next) == GRAPH_SUCCESS);
+	}
+	int *cycleComponents = (int*)malloc(CYCLE * sizeof(int));
+	ASSERT_TEST(cycleComponents != NULL);
+	ASSERT_TEST(graphComputeSCC(graph, cycleComponents, &count, &condensation) ==
+			GRAPH_SUCCESS);
+	ASSERT_TEST(count == 1);
+	for (int i = 0; i < CYCLE; ++i) {
+		ASSERT_TEST(cycleComponents[i] == 0);
+	}
+	ASSERT_TEST(graphOutDegreeById(condensation, 0) == 0);
+	free(cycleComponents);
+	graphDestroy(condensation);
+	graphDestroy(graph);
+	return true;
+}
+
+static bool graphBatchTest() {
+	const int VERTICES = 40, EDGES = 300;
+	char names[VERTICES][8];
+	GraphVertex vertices[VERTICES + 3];
+	GraphResult results[EDGES];
+	for (int i = 0; i < VERTICES; ++i) {
+		sprintf(names[i], "b%d", i);
+		vertices[i] = names[i];
+	}
+	vertices[VERTICES] = names[3];
+	vertices[VERTICES + 1] = NULL;
+	vertices[VERTICES + 2] = "a";
+
+	Graph single = graphCreate((copyGraphVertex)stringCopy, (compareGraphVertex)strcmp, free);
+	Graph batch = graphCreate((copyGraphVertex)stringCopy, (compareGraphVertex)strcmp, free);
+	ASSERT_TEST(single != NULL && batch != NULL);
+	ASSERT_TEST(graphAddVerticesBatch(NULL, vertices, 1, results) == GRAPH_NULL_ARGUMENT);
+	ASSERT_TEST(graphAddVerticesBatch(batch, vertices, 1, NULL) == GRAPH_NULL_ARGUMENT);
+	ASSERT_TEST(graphAddVerticesBatch(batch, vertices, -1, results) == GRAPH_OUT_OF_RANGE);
+	ASSERT_TEST(graphAddVerticesBatch(batch, vertices, 0, results) == GRAPH_SUCCESS);
+	// some vertices are there before the batch
+	for (int i = 0; i < VERTICES; i += 7) {
+		ASSERT_TEST(graphAddVertex(batch, names[i]) == GRAPH_SUCCESS);
+	}
+	ASSERT_TEST(graphAddVerticesBatch(batch, vertices, VERTICES + 3, results) == GRAPH_SUCCESS);
+	for (int i = 0; i < VERTICES; ++i) {
+		ASSERT_TEST(results[i] == (i % 7 == 0 ? GRAPH_VERTEX_ALREADY_EXISTS : GRAPH_SUCCESS));
+		ASSERT_TEST(graphAddVertex(single, names[i]) == GRAPH_SUCCESS);
+		ASSERT_TEST(graphIsVertexExists(batch, names[i]));
+	}
+	ASSERT_TEST(results[VERTICES] == GRAPH_VERTEX_ALREADY_EXISTS);
+	ASSERT_TEST(results[VERTICES + 1] == GRAPH_NULL_ARGUMENT);
+	ASSERT_TEST(results[VERTICES + 2] == GRAPH_SUCCESS);
+	ASSERT_TEST(graphAddVertex(single, "a") == GRAPH_SUCCESS);
+	ASSERT_TEST(graphAddVertex(batch, "a") == GRAPH_VERTEX_ALREADY_EXISTS);
+
+	// random edges with repeats, some added before the batch
+	GraphVertex from[EDGES], to[EDGES];
+	unsigned state = 1205;
+	for (int i = 0; i < EDGES; ++i) {
+		state = state * 1103515245 + 12345;
+		from[i] = names[(state >> 8) % VERTICES];
+		state = state * 1103515245 + 12345;
+		to[i] = names[(state >> 8) % (VERTICES / 4)];
+	}
+	from[1] = "missing";
+	to[2] = NULL;
+	for (int i = 0; i < EDGES; i += 10) {
+		if (graphAddDirectedEdge(batch, from[i], to[i]) == GRAPH_SUCCESS) {
+			ASSERT_TEST(graphAddDirectedEdge(single, from[i], to[i]) == GRAPH_SUCCESS);
+		}
+	}
+	ASSERT_TEST(graphAddEdgesBatch(batch, from, NULL, EDGES, results) == GRAPH_NULL_ARGUMENT);
+	ASSERT_TEST(graphAddEdgesBatch(batch, from, to, -1, results) == GRAPH_OUT_OF_RANGE);
+	ASSERT_TEST(graphAddEdgesBatch(batch, from, to, EDGES, results) == GRAPH_SUCCESS);
+	for (int i = 0; i < EDGES; ++i) {
+		ASSERT_TEST(results[i] == graphAddDirectedEdge(single, from[i], to[i]));
+	}
+	ASSERT_TEST(results[1] == GRAPH_VERTEX_DOES_NOT_EXISTS);
+	ASSERT_TEST(results[2] == GRAPH_NULL_ARGUMENT);
+
+	// both graphs have the same edges, neighbors are sorted by id
+	for (int i = 0; i < VERTICES; ++i) {
+		for (int direction = 0; direction < 2; ++direction) {
+			GraphNeighborCursor cursor;
+			ASSERT_TEST((direction == 0 ? graphGetOutNeighbors(batch, names[i], &cursor) :
+					graphGetInNeighbors(batch, names[i], &cursor)) == GRAPH_SUCCESS);
+			int count = 0, previous = -1, id;
+			while ((id = graphNeighborCursorNextId(&cursor)) >= 0) {
+				GraphVertex neighbor = graphGetVertexById(batch, id);
+				ASSERT_TEST(direction == 0 ?
+						graphIsDirectedEdgeExists(single, names[i], neighbor) :
+						graphIsDirectedEdgeExists(single, neighbor, names[i]));
+				ASSERT_TEST(id > previous);
+				previous = id;
+				++count;
+			}
+			ASSERT_TEST(count == (direction == 0 ? graphOutDegree(single, names[i]) :
+					graphInDegree(single, names[i])));
+		}
+	}
+	ASSERT_TEST(graphRemoveVertex(batch, names[0]) == GRAPH_SUCCESS);
+	ASSERT_TEST(graphRemoveVertex(single, names[0]) == GRAPH_SUCCESS);
+	for (int i = 1; i < VERTICES; ++i) {
+		ASSERT_TEST(graphOutDegree(batch, names[i]) == graphOutDegree(single, names[i]));
+		ASSERT_TEST(graphInDegree(batch, names[i]) == graphInDegree(single, names[i]));
+	}
+	graphDestroy(single);
+	graphDestroy(batch);
+	return true;
+}
+
 int main() {
 	RUN_TEST(graphDestroyTest);
 	RUN_TEST(graphAddDirectedEdgeTest);
@@ -435,6 +1108,15 @@ int main() {
 	RUN_TEST(graphIsVertexExistsTest);
 	RUN_TEST(graphRemoveDirectedEdgeTest);
 	RUN_TEST(graphClearTest);
+	RUN_TEST(graphManyEdgesTest);
+	RUN_TEST(graphVertexIdTest);
+	RUN_TEST(graphNeighborsTest);
+	RUN_TEST(graphTraversalTest);
+	RUN_TEST(graphParallelBFSTest);
+	RUN_TEST(graphFreezeTest);
+	RUN_TEST(graphReachabilityIndexTest);
+	RUN_TEST(graphComputeSCCTest);
+	RUN_TEST(graphBatchTest);
 
 	return 0;
 }
@@ -4,4 +4,6 @@ cp -f graph/graph.* result/
 cp -f graph/tests/* result/tests/
 cp -f memcache/memcache.* result/
 cp -f memcache/tests/* result/tests/
+cp -f tiered_cache/tiered_cache.* result/
+cp -f tiered_cache/tests/* result/tests/
 cp -f my_set/my_set* result/
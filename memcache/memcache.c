@@ -199,7 +199,8 @@ MemCache memCacheCreate() {
 	MemCache memcache;
 	MEMCACHE_ALLOCATE(MemCache_t, memcache, NULL);
 
-	memcache->freeBlocks = cacheCreate(
+	// free blocks of a size are interchangeable, the last freed is reused
+	memcache->freeBlocks = cacheCreatePool(
 			MEMCACHE_FREE_BLOCK_MAX_SIZE,
 			// we should not deallocate block while clearing, we might need it
 			memcacheDoNothing,
@@ -0,0 +1,200 @@
+#include "test_utilities.h"
+#include <stdlib.h>
+#include <string.h>
+#include "../tiered_cache.h"
+
+#define TEST_CACHE_SIZE (256)
+#define TEST_LONG_STRING (1000)
+
+static CacheElement copyString(CacheElement str) {
+	char* copy = malloc(strlen(str) + 1);
+	return copy == NULL ? NULL : strcpy(copy, str);
+}
+
+/** while set, copies of elements fail as if memory ran out */
+static bool failCopies = false;
+
+static CacheElement copyStringUnlessFailing(CacheElement str) {
+	return failCopies ? NULL : copyString(str);
+}
+
+static void freeString(CacheElement str) {
+	free(str);
+}
+
+static int compareStrings(CacheElement element1, CacheElement element2) {
+	return strcmp(element1, element2);
+}
+
+static int getFirstLetter(CacheElement element) {
+	return *(unsigned char*)element;
+}
+
+static int encodeString(CacheElement element, unsigned char *buffer, int size) {
+	int length = strlen(element);
+	if (length <= size) {
+		memcpy(buffer, element, length);
+	}
+	return length;
+}
+
+static CacheElement decodeString(const unsigned char *buffer, int length) {
+	char *string = malloc(length + 1);
+	if (string != NULL) {
+		memcpy(string, buffer, length);
+		string[length] = '\0';
+	}
+	return string;
+}
+
+static TieredCache createCache(int hot_capacity, long cold_budget) {
+	return tieredCacheCreate(TEST_CACHE_SIZE, freeString, copyString, compareStrings,
+			getFirstLetter, encodeString, decodeString, hot_capacity, cold_budget);
+}
+
+static bool testTieredCacheCreate(void) {
+	ASSERT_TEST(tieredCacheCreate(0, freeString, copyString, compareStrings,
+			getFirstLetter, encodeString, decodeString, 1, 0) == NULL);
+	ASSERT_TEST(tieredCacheCreate(TEST_CACHE_SIZE, freeString, copyString, compareStrings,
+			getFirstLetter, NULL, decodeString, 1, 0) == NULL);
+	ASSERT_TEST(createCache(0, 0) == NULL);
+	ASSERT_TEST(createCache(1, -1) == NULL);
+	TieredCache cache = createCache(1, 0);
+	ASSERT_TEST(cache != NULL);
+	ASSERT_TEST(tieredCacheGetColdCount(cache) == 0);
+	ASSERT_TEST(tieredCacheGetColdSize(cache) == 0);
+	ASSERT_TEST(tieredCacheGetColdCount(NULL) == -1);
+	tieredCacheDestroy(cache);
+	tieredCacheDestroy(NULL);
+	return true;
+}
+
+static bool testTieredCachePromotion(void) {
+	TieredCache cache = createCache(2, 1000);
+	ASSERT_TEST(cache != NULL);
+	ASSERT_TEST(tieredCachePush(NULL, "apple") == CACHE_NULL_ARGUMENT);
+	ASSERT_TEST(tieredCachePush(cache, "apple") == CACHE_SUCCESS);
+	ASSERT_TEST(tieredCachePush(cache, "banana") == CACHE_SUCCESS);
+	ASSERT_TEST(tieredCacheGetColdCount(cache) == 0);
+	ASSERT_TEST(tieredCachePush(cache, "cherry") == CACHE_SUCCESS);
+	ASSERT_TEST(tieredCacheGetColdCount(cache) == 1);
+	ASSERT_TEST(tieredCacheGetColdSize(cache) > 0);
+
+	// every access promotes one element and demotes another
+	ASSERT_TEST(tieredCacheIsIn(cache, "apple"));
+	ASSERT_TEST(tieredCacheIsIn(cache, "banana"));
+	ASSERT_TEST(tieredCacheIsIn(cache, "cherry"));
+	ASSERT_TEST(!tieredCacheIsIn(cache, "date"));
+	ASSERT_TEST(tieredCacheGetColdCount(cache) == 1);
+
+	ASSERT_TEST(tieredCacheFreeElement(cache, "date") == CACHE_ITEM_DOES_NOT_EXIST);
+	ASSERT_TEST(tieredCacheFreeElement(cache, "apple") == CACHE_SUCCESS);
+	ASSERT_TEST(tieredCacheFreeElement(cache, "banana") == CACHE_SUCCESS);
+	ASSERT_TEST(tieredCacheFreeElement(cache, "cherry") == CACHE_SUCCESS);
+	ASSERT_TEST(tieredCacheGetColdCount(cache) == 0);
+	ASSERT_TEST(tieredCacheGetColdSize(cache) == 0);
+	tieredCacheDestroy(cache);
+	return true;
+}
+
+static bool testTieredCacheFailedPromotion(void) {
+	TieredCache cache = tieredCacheCreate(TEST_CACHE_SIZE, freeString,
+			copyStringUnlessFailing, compareStrings, getFirstLetter, encodeString,
+			decodeString, 1, 1000);
+	ASSERT_TEST(cache != NULL);
+	ASSERT_TEST(tieredCachePush(cache, "apple") == CACHE_SUCCESS);
+	ASSERT_TEST(tieredCachePush(cache, "banana") == CACHE_SUCCESS);
+	ASSERT_TEST(tieredCacheGetColdCount(cache) == 1);
+
+	// an element which can not be promoted stays cold
+	failCopies = true;
+	ASSERT_TEST(tieredCacheIsIn(cache, "apple"));
+	ASSERT_TEST(tieredCacheIsIn(cache, "apple"));
+	failCopies = false;
+	ASSERT_TEST(tieredCacheIsIn(cache, "apple"));
+	ASSERT_TEST(tieredCacheIsIn(cache, "banana"));
+	ASSERT_TEST(tieredCacheGetColdCount(cache) == 1);
+	tieredCacheDestroy(cache);
+	return true;
+}
+
+static bool testTieredCacheCompression(void) {
+	char repetitive[TEST_LONG_STRING + 1];
+	char random[TEST_LONG_STRING + 1];
+	unsigned state = 12345;
+	for (int i = 0; i < TEST_LONG_STRING; ++i) {
+		repetitive[i] = "abc"[i % 3];
+		state = state * 1103515245 + 12345;
+		random[i] = 'A' + (state >> 16) % 26;
+	}
+	repetitive[TEST_LONG_STRING] = random[TEST_LONG_STRING] = '\0';
+	random[0] = 'b';
+
+	TieredCache cache = createCache(1, 10 * TEST_LONG_STRING);
+	ASSERT_TEST(cache != NULL);
+	ASSERT_TEST(tieredCachePush(cache, repetitive) == CACHE_SUCCESS);
+	ASSERT_TEST(tieredCachePush(cache, random) == CACHE_SUCCESS);
+	ASSERT_TEST(tieredCacheGetColdCount(cache) == 1);
+	ASSERT_TEST(tieredCacheGetColdSize(cache) < TEST_LONG_STRING / 10);
+	ASSERT_TEST(tieredCachePush(cache, "zebra") == CACHE_SUCCESS);
+	ASSERT_TEST(tieredCacheGetColdCount(cache) == 2);
+
+	// cold elements are decoded back when extracted
+	char *extracted = tieredCacheExtractElementByKey(cache, 'a');
+	ASSERT_TEST(extracted != NULL && strcmp(extracted, repetitive) == 0);
+	freeString(extracted);
+	extracted = tieredCacheExtractElementByKey(cache, 'b');
+	ASSERT_TEST(extracted != NULL && strcmp(extracted, random) == 0);
+	freeString(extracted);
+	ASSERT_TEST(tieredCacheExtractElementByKey(cache, 'b') == NULL);
+	extracted = tieredCacheExtractElementByKey(cache, 'z');
+	ASSERT_TEST(extracted != NULL && strcmp(extracted, "zebra") == 0);
+	freeString(extracted);
+	ASSERT_TEST(tieredCacheGetColdSize(cache) == 0);
+	tieredCacheDestroy(cache);
+	return true;
+}
+
+static bool testTieredCacheBudget(void) {
+	char *elements[] = { "alpha", "bravo", "charlie", "delta", "echo", "foxtrot" };
+	const int ELEMENTS_SIZE = sizeof(elements) / sizeof(*elements);
+	const long BUDGET = 64;
+	TieredCache cache = createCache(1, BUDGET);
+	ASSERT_TEST(cache != NULL);
+	for (int i = 0; i < ELEMENTS_SIZE; ++i) {
+		ASSERT_TEST(tieredCachePush(cache, elements[i]) == CACHE_SUCCESS);
+		ASSERT_TEST(tieredCacheGetColdSize(cache) <= BUDGET);
+	}
+	ASSERT_TEST(tieredCacheGetColdCount(cache) > 0);
+	ASSERT_TEST(tieredCacheGetColdCount(cache) < ELEMENTS_SIZE - 1);
+	ASSERT_TEST(tieredCacheIsIn(cache, elements[ELEMENTS_SIZE - 1]));
+	ASSERT_TEST(!tieredCacheIsIn(cache, elements[0]));
+
+	ASSERT_TEST(tieredCacheClear(cache) == CACHE_SUCCESS);
+	ASSERT_TEST(tieredCacheGetColdCount(cache) == 0);
+	ASSERT_TEST(!tieredCacheIsIn(cache, elements[ELEMENTS_SIZE - 1]));
+	tieredCacheDestroy(cache);
+
+	// no budget, evicted elements are dropped
+	cache = createCache(1, 0);
+	ASSERT_TEST(cache != NULL);
+	ASSERT_TEST(tieredCachePush(cache, elements[0]) == CACHE_SUCCESS);
+	ASSERT_TEST(tieredCachePush(cache, elements[1]) == CACHE_SUCCESS);
+	ASSERT_TEST(tieredCacheGetColdCount(cache) == 0);
+	ASSERT_TEST(!tieredCacheIsIn(cache, elements[0]));
+	tieredCacheDestroy(cache);
+	return true;
+}
+
+int main() {
+	setvbuf(stdout, NULL, _IONBF, 0);
+	setvbuf(stderr, NULL, _IONBF, 0);
+
+	RUN_TEST(testTieredCacheCreate);
+	RUN_TEST(testTieredCachePromotion);
+	RUN_TEST(testTieredCacheFailedPromotion);
+	RUN_TEST(testTieredCacheCompression);
+	RUN_TEST(testTieredCacheBudget);
+
+	return 0;
+}
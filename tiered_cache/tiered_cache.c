@@ -0,0 +1,449 @@
+/*
+ * tiered_cache.c
+ *
+ * Two-tier cache: bounded hot cache of live elements, and cold cache of
+ * compressed encodings of elements the hot one evicts.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tiered_cache.h"
+#include "cache.h"
+#include "set.h"
+
+/** Initial size of encoding buffer */
+#define TIERED_CACHE_BUFFER_SIZE (256)
+
+/**
+ * Compressed format is a sequence of tokens. Token byte below 128 is followed
+ * by token + 1 literal bytes. Token byte 128 and above is a match of
+ * (token - 128 + MIN_MATCH) bytes, followed by 2 bytes (little endian) of
+ * distance back in the output to copy from.
+ */
+#define TIERED_CACHE_MATCH_FLAG (0x80)
+#define TIERED_CACHE_MAX_LITERALS (128)
+/** Shorter matches do not pay for their token, so output never grows much */
+#define TIERED_CACHE_MIN_MATCH (4)
+#define TIERED_CACHE_MAX_MATCH (TIERED_CACHE_MIN_MATCH + 127)
+#define TIERED_CACHE_MAX_DISTANCE (0xffff)
+/** Compressor remembers last position of 2^HASH_BITS different prefixes */
+#define TIERED_CACHE_HASH_BITS (12)
+
+#define TIERED_CACHE_ALLOCATE(type, var, error) \
+	do { \
+		if (NULL == (var = (type*)malloc(sizeof(type)))) { \
+			return error; \
+		} \
+	} while(false)
+
+/** Compressed encoding of element in cold tier */
+typedef struct TieredColdEntry_t {
+	int key;
+	/** length of encoding before compression */
+	int rawLength;
+	int length;
+	unsigned char data[];
+} TieredColdEntry;
+
+typedef struct tiered_cache_t {
+	Cache hot;
+	Cache cold;
+	ComputeCacheKey computeKey;
+	EncodeCacheElement encode;
+	DecodeCacheElement decode;
+	int size;
+	long coldBudget;
+	long coldSize;
+	int coldCount;
+	/** cell cold tier drops elements from when it is over budget */
+	int dropKey;
+	/** encoding of element being processed */
+	unsigned char *buffer;
+	int bufferSize;
+	/** compressed encoding of element being processed */
+	TieredColdEntry *probe;
+	int probeCapacity;
+} tiered_cache_t;
+
+/** returns maximal length of compressed data of given length */
+static int tieredCacheCompressBound(int length) {
+	return length + length / TIERED_CACHE_MAX_LITERALS + 1;
+}
+
+/** writes literal tokens for bytes, returns number of bytes written */
+static int tieredCacheWriteLiterals(const unsigned char *literals, int count,
+		unsigned char *output) {
+	int written = 0;
+	while (count > 0) {
+		int run = count < TIERED_CACHE_MAX_LITERALS ? count : TIERED_CACHE_MAX_LITERALS;
+		output[written++] = (unsigned char)(run - 1);
+		memcpy(output + written, literals, run);
+		written += run;
+		literals += run;
+		count -= run;
+	}
+	return written;
+}
+
+/** returns hash slot of 4 bytes at input */
+static inline int tieredCacheHashPrefix(const unsigned char *input) {
+	uint32_t prefix = (uint32_t)input[0] | (uint32_t)input[1] << 8 |
+			(uint32_t)input[2] << 16 | (uint32_t)input[3] << 24;
+	return (int)((prefix * 2654435761u) >> (32 - TIERED_CACHE_HASH_BITS));
+}
+
+/**
+ * compresses input (LZ77 with greedy matching against the last occurrence of
+ * each prefix). Output is deterministic for the same input.
+ * @param output - buffer of at least tieredCacheCompressBound(length) bytes
+ * @return length of compressed data
+ */
+static int tieredCacheCompress(const unsigned char *input, int length,
+		unsigned char *output) {
+	int lastPosition[1 << TIERED_CACHE_HASH_BITS];
+	for (int i = 0; i < (1 << TIERED_CACHE_HASH_BITS); ++i) {
+		lastPosition[i] = -1;
+	}
+	int written = 0;
+	int literalsStart = 0;
+	int position = 0;
+	while (position + TIERED_CACHE_MIN_MATCH <= length) {
+		int slot = tieredCacheHashPrefix(input + position);
+		int candidate = lastPosition[slot];
+		lastPosition[slot] = position;
+		if (candidate < 0 || position - candidate > TIERED_CACHE_MAX_DISTANCE ||
+				memcmp(input + candidate, input + position, TIERED_CACHE_MIN_MATCH) != 0) {
+			++position;
+			continue;
+		}
+		int matchLength = TIERED_CACHE_MIN_MATCH;
+		while (position + matchLength < length && matchLength < TIERED_CACHE_MAX_MATCH &&
+				input[candidate + matchLength] == input[position + matchLength]) {
+			++matchLength;
+		}
+		written += tieredCacheWriteLiterals(input + literalsStart,
+				position - literalsStart, output + written);
+		int distance = position - candidate;
+		output[written++] = (unsigned char)(TIERED_CACHE_MATCH_FLAG |
+				(matchLength - TIERED_CACHE_MIN_MATCH));
+		output[written++] = (unsigned char)(distance & 0xff);
+		output[written++] = (unsigned char)(distance >> 8);
+		position += matchLength;
+		literalsStart = position;
+	}
+	written += tieredCacheWriteLiterals(input + literalsStart, length - literalsStart,
+			output + written);
+	assert(written <= tieredCacheCompressBound(length));
+	return written;
+}
+
+/**
+ * decompresses data produced by tieredCacheCompress
+ * @return false if data is malformed or does not decompress to rawLength bytes
+ */
+static bool tieredCacheDecompress(const unsigned char *input, int length,
+		unsigned char *output, int rawLength) {
+	int read = 0;
+	int written = 0;
+	while (read < length) {
+		int token = input[read++];
+		if (token < TIERED_CACHE_MATCH_FLAG) {
+			int run = token + 1;
+			if (run > length - read || run > rawLength - written) {
+				return false;
+			}
+			memcpy(output + written, input + read, run);
+			read += run;
+			written += run;
+			continue;
+		}
+		int matchLength = (token & ~TIERED_CACHE_MATCH_FLAG) + TIERED_CACHE_MIN_MATCH;
+		if (length - read < 2) {
+			return false;
+		}
+		int distance = input[read] | input[read + 1] << 8;
+		read += 2;
+		if (distance == 0 || distance > written || matchLength > rawLength - written) {
+			return false;
+		}
+		// byte by byte, match may overlap its own output
+		for (int i = 0; i < matchLength; ++i, ++written) {
+			output[written] = output[written - distance];
+		}
+	}
+	return written == rawLength;
+}
+
+/** returns number of bytes cold entry takes */
+static long tieredColdEntrySize(const TieredColdEntry *entry) {
+	return (long)sizeof(*entry) + entry->length;
+}
+
+static CacheElement tieredColdEntryCopy(CacheElement element) {
+	TieredColdEntry *entry = element;
+	TieredColdEntry *copy = malloc(tieredColdEntrySize(entry));
+	if (copy == NULL) {
+		return NULL;
+	}
+	return memcpy(copy, entry, tieredColdEntrySize(entry));
+}
+
+static void tieredColdEntryFree(CacheElement element) {
+	free(element);
+}
+
+/** compressed encodings are equal if and only if elements are */
+static int tieredColdEntryCompare(CacheElement element1, CacheElement element2) {
+	TieredColdEntry *entry1 = element1;
+	TieredColdEntry *entry2 = element2;
+	if (entry1->rawLength != entry2->rawLength) {
+		return entry1->rawLength < entry2->rawLength ? -1 : 1;
+	}
+	if (entry1->length != entry2->length) {
+		return entry1->length < entry2->length ? -1 : 1;
+	}
+	return memcmp(entry1->data, entry2->data, entry1->length);
+}
+
+static int tieredColdEntryComputeKey(CacheElement element) {
+	return ((TieredColdEntry*)element)->key;
+}
+
+/** makes sure encoding buffer has at least size bytes */
+static bool tieredCacheReserveBuffer(TieredCache cache, int size) {
+	if (size <= cache->bufferSize) {
+		return true;
+	}
+	unsigned char *buffer = realloc(cache->buffer, size);
+	if (buffer == NULL) {
+		return false;
+	}
+	cache->buffer = buffer;
+	cache->bufferSize = size;
+	return true;
+}
+
+/**
+ * encodes and compresses element into probe entry of cache
+ * @return NULL if encoding failed or memory is lacking
+ */
+static TieredColdEntry *tieredCacheMakeProbe(TieredCache cache, CacheElement element) {
+	int length = cache->encode(element, cache->buffer, cache->bufferSize);
+	if (length > cache->bufferSize) {
+		if (!tieredCacheReserveBuffer(cache, length)) {
+			return NULL;
+		}
+		length = cache->encode(element, cache->buffer, cache->bufferSize);
+	}
+	if (length < 0 || length > cache->bufferSize) {
+		return NULL;
+	}
+	int bound = tieredCacheCompressBound(length);
+	if (bound > cache->probeCapacity) {
+		TieredColdEntry *probe = realloc(cache->probe, sizeof(*probe) + bound);
+		if (probe == NULL) {
+			return NULL;
+		}
+		cache->probe = probe;
+		cache->probeCapacity = bound;
+	}
+	cache->probe->key = cache->computeKey(element);
+	cache->probe->rawLength = length;
+	cache->probe->length = tieredCacheCompress(cache->buffer, length, cache->probe->data);
+	return cache->probe;
+}
+
+/** drops cold elements, cell after cell, until cold tier fits its budget */
+static void tieredCacheEnforceBudget(TieredCache cache) {
+	while (cache->coldSize > cache->coldBudget && cache->coldCount > 0) {
+		TieredColdEntry *entry = cacheExtractElementByKey(cache->cold, cache->dropKey);
+		if (entry == NULL) {
+			cache->dropKey = (cache->dropKey + 1) % cache->size;
+			continue;
+		}
+		cache->coldSize -= tieredColdEntrySize(entry);
+		--cache->coldCount;
+		tieredColdEntryFree(entry);
+	}
+}
+
+/** eviction listener of hot tier: moves evicted element to cold tier */
+static void tieredCacheDemote(CacheElement element, void *context) {
+	TieredCache cache = context;
+	TieredColdEntry *probe = tieredCacheMakeProbe(cache, element);
+	// element which cannot be kept is just evicted
+	if (probe == NULL || tieredColdEntrySize(probe) > cache->coldBudget ||
+			cachePush(cache->cold, probe) != CACHE_SUCCESS) {
+		return;
+	}
+	cache->coldSize += tieredColdEntrySize(probe);
+	++cache->coldCount;
+	tieredCacheEnforceBudget(cache);
+}
+
+/** checks whether element has a cold copy */
+static bool tieredCacheIsCold(TieredCache cache, CacheElement element) {
+	if (cache->coldCount == 0) {
+		return false;
+	}
+	TieredColdEntry *probe = tieredCacheMakeProbe(cache, element);
+	return probe != NULL && cacheIsIn(cache->cold, probe);
+}
+
+/**
+ * removes cold copy of element
+ * @return true if there was one
+ */
+static bool tieredCacheRemoveCold(TieredCache cache, CacheElement element) {
+	if (cache->coldCount == 0) {
+		return false;
+	}
+	TieredColdEntry *probe = tieredCacheMakeProbe(cache, element);
+	if (probe == NULL || cacheFreeElement(cache->cold, probe) != CACHE_SUCCESS) {
+		return false;
+	}
+	cache->coldSize -= tieredColdEntrySize(probe);
+	--cache->coldCount;
+	return true;
+}
+
+TieredCache tieredCacheCreate(
+    int size,
+    FreeCacheElement free_element,
+    CopyCacheElement copy_element,
+    CompareCacheElements compare_elements,
+    ComputeCacheKey compute_key,
+    EncodeCacheElement encode,
+    DecodeCacheElement decode,
+    int hot_capacity,
+    long cold_budget) {
+	if (!encode || !decode || hot_capacity <= 0 || cold_budget < 0) {
+		return NULL;
+	}
+	TieredCache cache;
+	TIERED_CACHE_ALLOCATE(tiered_cache_t, cache, NULL);
+	cache->computeKey = compute_key;
+	cache->encode = encode;
+	cache->decode = decode;
+	cache->size = size;
+	cache->coldBudget = cold_budget;
+	cache->coldSize = 0;
+	cache->coldCount = 0;
+	cache->dropKey = 0;
+	cache->bufferSize = TIERED_CACHE_BUFFER_SIZE;
+	cache->buffer = malloc(cache->bufferSize);
+	cache->probeCapacity = tieredCacheCompressBound(cache->bufferSize);
+	cache->probe = malloc(sizeof(*cache->probe) + cache->probeCapacity);
+	cache->hot = cacheCreate(size, free_element, copy_element, compare_elements, compute_key);
+	cache->cold = cacheCreate(size, tieredColdEntryFree, tieredColdEntryCopy,
+			tieredColdEntryCompare, tieredColdEntryComputeKey);
+	if (cache->buffer == NULL || cache->probe == NULL ||
+			cache->hot == NULL || cache->cold == NULL ||
+			cacheSetCapacity(cache->hot, hot_capacity) != CACHE_SUCCESS ||
+			cacheSetEvictionListener(cache->hot, tieredCacheDemote, cache) != CACHE_SUCCESS) {
+		tieredCacheDestroy(cache);
+		return NULL;
+	}
+	return cache;
+}
+
+CacheResult tieredCachePush(TieredCache cache, CacheElement element) {
+	if (cache == NULL || element == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	CacheResult result = cachePush(cache->hot, element);
+	if (result == CACHE_SUCCESS) {
+		tieredCacheRemoveCold(cache, element);
+	}
+	return result;
+}
+
+bool tieredCacheIsIn(TieredCache cache, CacheElement element) {
+	if (cache == NULL || element == NULL) {
+		return false;
+	}
+	if (cacheIsIn(cache->hot, element)) {
+		return true;
+	}
+	if (!tieredCacheIsCold(cache, element)) {
+		return false;
+	}
+	// promotion may demote another element; an element which can not be
+	// promoted stays cold
+	if (cachePush(cache->hot, element) == CACHE_SUCCESS) {
+		tieredCacheRemoveCold(cache, element);
+	}
+	return true;
+}
+
+CacheResult tieredCacheFreeElement(TieredCache cache, CacheElement element) {
+	if (cache == NULL || element == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	CacheResult result = cacheFreeElement(cache->hot, element);
+	if (result != CACHE_ITEM_DOES_NOT_EXIST) {
+		return result;
+	}
+	return tieredCacheRemoveCold(cache, element) ? CACHE_SUCCESS : CACHE_ITEM_DOES_NOT_EXIST;
+}
+
+CacheElement tieredCacheExtractElementByKey(TieredCache cache, int key) {
+	if (cache == NULL) {
+		return NULL;
+	}
+	CacheElement element = cacheExtractElementByKey(cache->hot, key);
+	if (element != NULL || cache->coldCount == 0) {
+		return element;
+	}
+	TieredColdEntry *entry = cacheExtractElementByKey(cache->cold, key);
+	if (entry == NULL) {
+		return NULL;
+	}
+	cache->coldSize -= tieredColdEntrySize(entry);
+	--cache->coldCount;
+	if (tieredCacheReserveBuffer(cache, entry->rawLength) &&
+			tieredCacheDecompress(entry->data, entry->length, cache->buffer,
+					entry->rawLength)) {
+		element = cache->decode(cache->buffer, entry->rawLength);
+	}
+	tieredColdEntryFree(entry);
+	return element;
+}
+
+int tieredCacheGetColdCount(TieredCache cache) {
+	if (cache == NULL) {
+		return -1;
+	}
+	return cache->coldCount;
+}
+
+long tieredCacheGetColdSize(TieredCache cache) {
+	if (cache == NULL) {
+		return -1;
+	}
+	return cache->coldSize;
+}
+
+CacheResult tieredCacheClear(TieredCache cache) {
+	if (cache == NULL) {
+		return CACHE_NULL_ARGUMENT;
+	}
+	cacheClear(cache->hot);
+	cacheClear(cache->cold);
+	cache->coldSize = 0;
+	cache->coldCount = 0;
+	return CACHE_SUCCESS;
+}
+
+void tieredCacheDestroy(TieredCache cache) {
+	if (cache == NULL) {
+		return;
+	}
+	cacheDestroy(cache->hot);
+	cacheDestroy(cache->cold);
+	free(cache->buffer);
+	free(cache->probe);
+	free(cache);
+}
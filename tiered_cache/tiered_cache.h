@@ -0,0 +1,135 @@
+/*
+ * tiered_cache.h
+ *
+ * Header for two-tier cache: hot tier of live elements and cold tier of
+ * compressed encodings of elements demoted from it.
+ */
+
+#ifndef TIERED_CACHE_H_
+#define TIERED_CACHE_H_
+
+#include "cache.h"
+#include <stdbool.h>
+
+/**
+ * Type of two-tier cache.
+ *
+ * Both tiers are caches with the same key range and key function, so an
+ * element stays in the same cell index in either tier. The hot tier is a
+ * bounded cache, elements it evicts are encoded, compressed and kept in the
+ * cold tier until its byte budget is exceeded. Accessing a cold element
+ * promotes it back to the hot tier.
+ */
+typedef struct tiered_cache_t* TieredCache;
+
+/**
+ * Creates a new two-tier cache.
+ *
+ * @param size - number of cells in container of each tier.
+ * @param free_element - callback to be called for destroying an element.
+ * @param copy_element - callback to be called for copying an element.
+ * @param compare_elements - callback to be called for comparing between elements.
+ * @param compute_key - callback to be called for computing the key for an
+ * element.
+ * @param encode - callback encoding an element, as for cacheSnapshot. The
+ * encoding must be deterministic: equal elements have equal encodings.
+ * @param decode - callback creating element from its encoding.
+ * @param hot_capacity - maximal number of elements in hot tier, positive.
+ * @param cold_budget - maximal number of bytes of compressed elements in cold
+ * tier, 0 drops evicted elements right away.
+ *
+ * @return A new allocated cache, or NULL in case of error.
+ */
+TieredCache tieredCacheCreate(
+    int size,
+    FreeCacheElement free_element,
+    CopyCacheElement copy_element,
+    CompareCacheElements compare_elements,
+    ComputeCacheKey compute_key,
+    EncodeCacheElement encode,
+    DecodeCacheElement decode,
+    int hot_capacity,
+    long cold_budget);
+
+/**
+ * Adds an element to the hot tier, possibly demoting another element to the
+ * cold tier. A cold copy of the element is dropped.
+ *
+ * @param cache - cache to add the element to.
+ * @param element - element to be added.
+ *
+ * @return Result code, CACHE_ITEM_ALREADY_EXISTS if the element is in the hot
+ * tier.
+ */
+CacheResult tieredCachePush(TieredCache cache, CacheElement element);
+
+/**
+ * Checks whether an element is in either tier. An element found in the cold
+ * tier is promoted to the hot one, or stays cold if it can not be pushed to
+ * the hot tier.
+ *
+ * @param cache - cache to search.
+ * @param element - element to find.
+ *
+ * @return true if the element was found, false otherwise or if NULL passed.
+ */
+bool tieredCacheIsIn(TieredCache cache, CacheElement element);
+
+/**
+ * Removes an element from the cache (either tier) and destroys it.
+ *
+ * @param cache - cache to remove the element from.
+ * @param element - element to remove.
+ *
+ * @return Result code.
+ */
+CacheResult tieredCacheFreeElement(TieredCache cache, CacheElement element);
+
+/**
+ * Removes an element with the specified key and returns it to the user. The
+ * hot tier is searched first, a cold element is decoded.
+ *
+ * @param cache - cache to remove the element from.
+ * @param key - key associated with the element.
+ *
+ * @return NULL if NULL was passed, the key is out of range, there is no
+ * element with it or decoding failed. The removed element otherwise.
+ */
+CacheElement tieredCacheExtractElementByKey(TieredCache cache, int key);
+
+/**
+ * Returns number of elements in the cold tier.
+ *
+ * @param cache - cache to examine.
+ *
+ * @return -1 if NULL was passed, number of cold elements otherwise.
+ */
+int tieredCacheGetColdCount(TieredCache cache);
+
+/**
+ * Returns number of bytes taken by compressed elements of the cold tier,
+ * which is bounded by cold_budget.
+ *
+ * @param cache - cache to examine.
+ *
+ * @return -1 if NULL was passed, size of cold tier otherwise.
+ */
+long tieredCacheGetColdSize(TieredCache cache);
+
+/**
+ * Clears both tiers.
+ *
+ * @param cache - cache to clear.
+ *
+ * @return Result code.
+ */
+CacheResult tieredCacheClear(TieredCache cache);
+
+/**
+ * Destroys a cache - frees its memory.
+ *
+ * @param cache - cache to destroy.
+ */
+void tieredCacheDestroy(TieredCache cache);
+
+#endif /* TIERED_CACHE_H_ */